@@ -0,0 +1,116 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+// Run-wide control block: the shutdown flag, emergency corridor state,
+// vehicle id allocation and completion count. Each field sits on its own
+// cache line so a vehicle counting its completion never invalidates the line
+// every waiter polls for shutdown. Counters are sharded per thread and only
+// summed when read. Everything goes through a SimulationContext reference, so
+// nothing here assumes there is only one simulation in the process.
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+const int CACHE_LINE_BYTES = 64;
+const int COUNTER_SHARDS = 16;
+
+const uint8_t EMERGENCY_NONE = 0;
+const uint8_t EMERGENCY_EASTBOUND = 1;
+const uint8_t EMERGENCY_WESTBOUND = 2;
+const string EMERGENCY_NAMES[] = {"none", "EASTBOUND", "WESTBOUND"};
+
+template <typename T>
+struct alignas(CACHE_LINE_BYTES) PaddedAtomic {
+    atomic<T> value;
+};
+
+struct ShardedCounter {
+    PaddedAtomic<long> shards[COUNTER_SHARDS];
+};
+
+struct SimulationContext {
+    PaddedAtomic<bool> shutdown;
+    PaddedAtomic<int> emergency;            // EMERGENCY_NONE, _EASTBOUND or _WESTBOUND
+    PaddedAtomic<int> next_vehicle_id;
+    PaddedAtomic<int> total_vehicles;       // target, lowered to the real count once spawning stops
+    ShardedCounter vehicles_completed;
+};
+
+// Threads take shards round-robin the first time they count anything
+inline int counterShard() {
+    static atomic<int> next_shard(0);
+    static thread_local int shard = next_shard.fetch_add(1, memory_order_relaxed) % COUNTER_SHARDS;
+    return shard;
+}
+
+inline void resetCounter(ShardedCounter& counter) {
+    for (int s = 0; s < COUNTER_SHARDS; s++) counter.shards[s].value.store(0, memory_order_relaxed);
+}
+
+inline void addToCounter(ShardedCounter& counter, long n) {
+    counter.shards[counterShard()].value.fetch_add(n, memory_order_relaxed);
+}
+
+inline long readCounter(const ShardedCounter& counter) {
+    long total = 0;
+    for (int s = 0; s < COUNTER_SHARDS; s++) total += counter.shards[s].value.load(memory_order_relaxed);
+    return total;
+}
+
+inline void initSimulationContext(SimulationContext& ctx, int total_vehicles) {
+    ctx.shutdown.value.store(false, memory_order_relaxed);
+    ctx.emergency.value.store(EMERGENCY_NONE, memory_order_relaxed);
+    ctx.next_vehicle_id.value.store(1, memory_order_relaxed);
+    ctx.total_vehicles.value.store(total_vehicles, memory_order_relaxed);
+    resetCounter(ctx.vehicles_completed);
+}
+
+// Release/acquire, so whatever the raising thread did first (e.g. setting a
+// latch) is visible to a thread that sees the flag
+inline bool shuttingDown(const SimulationContext& ctx) {
+    return ctx.shutdown.value.load(memory_order_acquire);
+}
+
+// True for the caller that actually raised it
+inline bool raiseShutdown(SimulationContext& ctx) {
+    return !ctx.shutdown.value.exchange(true, memory_order_acq_rel);
+}
+
+inline int emergencyState(const SimulationContext& ctx) {
+    return ctx.emergency.value.load(memory_order_acquire);
+}
+
+inline bool emergencyActive(const SimulationContext& ctx) {
+    return emergencyState(ctx) != EMERGENCY_NONE;
+}
+
+// Written with the corridor's intersection mutexes held, so waiters that test
+// it under those mutexes never miss the change
+inline void setEmergency(SimulationContext& ctx, int state) {
+    ctx.emergency.value.store(state, memory_order_release);
+}
+
+inline int allocateVehicleId(SimulationContext& ctx) {
+    return ctx.next_vehicle_id.value.fetch_add(1, memory_order_relaxed);
+}
+
+inline void countVehicleCompleted(SimulationContext& ctx) {
+    addToCounter(ctx.vehicles_completed, 1);
+}
+
+inline long vehiclesCompleted(const SimulationContext& ctx) {
+    return readCounter(ctx.vehicles_completed);
+}
+
+inline int totalVehicles(const SimulationContext& ctx) {
+    return ctx.total_vehicles.value.load(memory_order_acquire);
+}
+
+inline void setTotalVehicles(SimulationContext& ctx, int total) {
+    ctx.total_vehicles.value.store(total, memory_order_release);
+}
+
+#endif // CONTEXT_H
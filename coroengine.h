@@ -0,0 +1,340 @@
+#ifndef COROENGINE_H
+#define COROENGINE_H
+
+// Coroutine vehicle execution engine. Each vehicle is a stackless C++20
+// coroutine suspended on awaitables (timer elapsed, light turned green,
+// parking spot granted) and resumed by a small pool of scheduler threads.
+// Requires -std=c++20; under C++17 only the thread-per-vehicle engine exists.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <atomic>
+#include <pthread.h>
+#include <time.h>
+#include "simulation.h"
+#include "perfcounters.h"
+
+using namespace std;
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#define CORO_ENGINE_AVAILABLE 1
+#include <coroutine>
+#else
+#define CORO_ENGINE_AVAILABLE 0
+#endif
+
+// Light-wait lists are indexed [intersection][axis]
+const int AXIS_NORTH_SOUTH = 0;
+const int AXIS_EAST_WEST = 1;
+
+#if CORO_ENGINE_AVAILABLE
+
+struct VehicleTask {
+    struct promise_type {
+        VehicleTask get_return_object() {
+            return VehicleTask{coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+
+        // Frame sizes are tracked for the memory report
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr, size_t size);
+    };
+
+    coroutine_handle<promise_type> handle;
+};
+
+struct TimerEntry {
+    long long deadline_ns;
+    coroutine_handle<> handle;
+
+    bool operator>(const TimerEntry& other) const { return deadline_ns > other.deadline_ns; }
+};
+
+struct CoroScheduler {
+    deque<coroutine_handle<>> ready;
+    pthread_mutex_t ready_lock;
+    pthread_cond_t ready_cond;
+
+    priority_queue<TimerEntry, vector<TimerEntry>, greater<TimerEntry>> timers;
+    pthread_mutex_t timer_lock;
+    pthread_cond_t timer_cond;
+
+    // Guarded by the matching intersection mutex (f10_mutex / f11_mutex)
+    vector<coroutine_handle<>> green_waiters[2][2];
+    // Guarded by parking_lock
+    deque<coroutine_handle<>> parking_waiters[2];
+    pthread_mutex_t parking_lock;
+
+    vector<pthread_t> workers;
+    int worker_count;
+    pthread_t timer_tid;
+    bool stopping;
+
+    atomic<long> frames_live;
+    atomic<long> frames_peak;
+    atomic<long> frame_bytes_peak;
+    atomic<long> resumes;
+};
+
+extern CoroScheduler coro_scheduler;
+
+inline void* VehicleTask::promise_type::operator new(size_t size) {
+    long live = ++coro_scheduler.frames_live;
+    long peak = coro_scheduler.frames_peak.load();
+    while (live > peak && !coro_scheduler.frames_peak.compare_exchange_weak(peak, live)) {
+    }
+    long bytes = coro_scheduler.frame_bytes_peak.load();
+    while ((long)size > bytes && !coro_scheduler.frame_bytes_peak.compare_exchange_weak(bytes, (long)size)) {
+    }
+    return ::operator new(size);
+}
+
+inline void VehicleTask::promise_type::operator delete(void* ptr, size_t size) {
+    coro_scheduler.frames_live--;
+    ::operator delete(ptr);
+}
+
+inline void scheduleCoroutine(coroutine_handle<> h) {
+    pthread_mutex_lock(&coro_scheduler.ready_lock);
+    coro_scheduler.ready.push_back(h);
+    pthread_cond_signal(&coro_scheduler.ready_cond);
+    pthread_mutex_unlock(&coro_scheduler.ready_lock);
+}
+
+inline void scheduleAll(vector<coroutine_handle<>>& handles) {
+    if (handles.empty()) return;
+    pthread_mutex_lock(&coro_scheduler.ready_lock);
+    for (size_t i = 0; i < handles.size(); i++) {
+        coro_scheduler.ready.push_back(handles[i]);
+    }
+    pthread_cond_broadcast(&coro_scheduler.ready_cond);
+    pthread_mutex_unlock(&coro_scheduler.ready_lock);
+    handles.clear();
+}
+
+// co_await SleepFor{usec}: resumed by the timer thread once the delay elapses
+struct SleepFor {
+    long usec;
+
+    bool await_ready() const noexcept { return usec <= 0 || shuttingDown(sim_context); }
+    void await_suspend(coroutine_handle<> h) {
+        TimerEntry entry = {monotonicNowNs() + usec * 1000LL, h};
+        pthread_mutex_lock(&coro_scheduler.timer_lock);
+        bool earliest = coro_scheduler.timers.empty() || entry.deadline_ns < coro_scheduler.timers.top().deadline_ns;
+        coro_scheduler.timers.push(entry);
+        if (earliest) pthread_cond_signal(&coro_scheduler.timer_cond);
+        pthread_mutex_unlock(&coro_scheduler.timer_lock);
+    }
+    void await_resume() const noexcept {}
+};
+
+// co_await LightTurnsGreen{...}: parks the coroutine on its approach's wait list
+// until the listener publishes a green for that axis. The caller holds `mutex`
+// on entry and re-checks its condition after resuming, like pthread_cond_wait.
+struct LightTurnsGreen {
+    int intersection;
+    int axis;
+    pthread_mutex_t* mutex;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(coroutine_handle<> h) {
+        pthread_mutex_t* m = mutex;
+        coro_scheduler.green_waiters[intersection][axis].push_back(h);
+        pthread_mutex_unlock(m);
+    }
+    void await_resume() { pthread_mutex_lock(mutex); }
+};
+
+// Called by the light-state listener with the intersection mutex held
+inline void notifyGreenWaiters(int intersection, int axis) {
+    scheduleAll(coro_scheduler.green_waiters[intersection][axis]);
+}
+
+// co_await ParkingSpotGranted{...}: returns true once a departing vehicle
+// hands its spot over, false if the simulation shuts down first
+struct ParkingSpotGranted {
+    int lot;
+    sem_t* spots;
+    bool granted;
+
+    bool await_ready() {
+        granted = (sem_trywait(spots) == 0);
+        return granted || shuttingDown(sim_context);
+    }
+    bool await_suspend(coroutine_handle<> h) {
+        pthread_mutex_lock(&coro_scheduler.parking_lock);
+        if (sem_trywait(spots) == 0) {
+            granted = true;
+            pthread_mutex_unlock(&coro_scheduler.parking_lock);
+            return false;
+        }
+        granted = true;     // a resume from releaseParkingSpot carries the spot
+        coro_scheduler.parking_waiters[lot].push_back(h);
+        pthread_mutex_unlock(&coro_scheduler.parking_lock);
+        return true;
+    }
+    bool await_resume() const { return granted && !shuttingDown(sim_context); }
+};
+
+// Hands a freed spot straight to the next waiting coroutine, if any
+inline void releaseParkingSpot(int lot, sem_t* spots) {
+    pthread_mutex_lock(&coro_scheduler.parking_lock);
+    if (!coro_scheduler.parking_waiters[lot].empty()) {
+        coroutine_handle<> h = coro_scheduler.parking_waiters[lot].front();
+        coro_scheduler.parking_waiters[lot].pop_front();
+        pthread_mutex_unlock(&coro_scheduler.parking_lock);
+        scheduleCoroutine(h);
+        return;
+    }
+    sem_post(spots);
+    pthread_mutex_unlock(&coro_scheduler.parking_lock);
+}
+
+inline void* coroWorkerThread(void* arg) {
+    perfSetThreadRole(PERF_ROLE_SCHEDULER);
+    while (true) {
+        pthread_mutex_lock(&coro_scheduler.ready_lock);
+        while (coro_scheduler.ready.empty() && !coro_scheduler.stopping) {
+            pthread_cond_wait(&coro_scheduler.ready_cond, &coro_scheduler.ready_lock);
+        }
+        if (coro_scheduler.ready.empty()) {
+            pthread_mutex_unlock(&coro_scheduler.ready_lock);
+            break;
+        }
+        coroutine_handle<> h = coro_scheduler.ready.front();
+        coro_scheduler.ready.pop_front();
+        pthread_mutex_unlock(&coro_scheduler.ready_lock);
+
+        coro_scheduler.resumes++;
+        h.resume();
+    }
+    return NULL;
+}
+
+inline void* coroTimerThread(void* arg) {
+    vector<coroutine_handle<>> due;
+
+    pthread_mutex_lock(&coro_scheduler.timer_lock);
+    while (!coro_scheduler.stopping) {
+        if (coro_scheduler.timers.empty()) {
+            pthread_cond_wait(&coro_scheduler.timer_cond, &coro_scheduler.timer_lock);
+            continue;
+        }
+
+        long long now = monotonicNowNs();
+        while (!coro_scheduler.timers.empty() && coro_scheduler.timers.top().deadline_ns <= now) {
+            due.push_back(coro_scheduler.timers.top().handle);
+            coro_scheduler.timers.pop();
+        }
+
+        if (!due.empty()) {
+            pthread_mutex_unlock(&coro_scheduler.timer_lock);
+            scheduleAll(due);
+            pthread_mutex_lock(&coro_scheduler.timer_lock);
+            continue;
+        }
+
+        long long wait_ns = coro_scheduler.timers.top().deadline_ns - now;
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += wait_ns / 1000000000LL;
+        deadline.tv_nsec += wait_ns % 1000000000LL;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&coro_scheduler.timer_cond, &coro_scheduler.timer_lock, &deadline);
+    }
+    pthread_mutex_unlock(&coro_scheduler.timer_lock);
+    return NULL;
+}
+
+inline void startCoroScheduler(int threads) {
+    pthread_mutex_init(&coro_scheduler.ready_lock, NULL);
+    pthread_cond_init(&coro_scheduler.ready_cond, NULL);
+    pthread_mutex_init(&coro_scheduler.timer_lock, NULL);
+    pthread_cond_init(&coro_scheduler.timer_cond, NULL);
+    pthread_mutex_init(&coro_scheduler.parking_lock, NULL);
+    coro_scheduler.stopping = false;
+
+    pthread_create(&coro_scheduler.timer_tid, NULL, coroTimerThread, NULL);
+    for (int i = 0; i < threads; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, coroWorkerThread, NULL) == 0) {
+            coro_scheduler.workers.push_back(tid);
+        }
+    }
+    coro_scheduler.worker_count = (int)coro_scheduler.workers.size();
+}
+
+inline void startVehicleTask(VehicleTask task) {
+    scheduleCoroutine(task.handle);
+}
+
+// Shutdown: every suspended vehicle is made runnable so it can observe
+// the shutdown flag, finish its bookkeeping and release its pool slot
+inline void wakeAllCoroutines(pthread_mutex_t* intersection_mutexes[2]) {
+    for (int i = 0; i < 2; i++) {
+        pthread_mutex_lock(intersection_mutexes[i]);
+        notifyGreenWaiters(i, AXIS_NORTH_SOUTH);
+        notifyGreenWaiters(i, AXIS_EAST_WEST);
+        pthread_mutex_unlock(intersection_mutexes[i]);
+    }
+
+    vector<coroutine_handle<>> waiters;
+    pthread_mutex_lock(&coro_scheduler.parking_lock);
+    for (int i = 0; i < 2; i++) {
+        waiters.insert(waiters.end(), coro_scheduler.parking_waiters[i].begin(), coro_scheduler.parking_waiters[i].end());
+        coro_scheduler.parking_waiters[i].clear();
+    }
+    pthread_mutex_unlock(&coro_scheduler.parking_lock);
+    scheduleAll(waiters);
+
+    pthread_mutex_lock(&coro_scheduler.timer_lock);
+    while (!coro_scheduler.timers.empty()) {
+        waiters.push_back(coro_scheduler.timers.top().handle);
+        coro_scheduler.timers.pop();
+    }
+    pthread_mutex_unlock(&coro_scheduler.timer_lock);
+    scheduleAll(waiters);
+}
+
+inline void stopCoroScheduler() {
+    pthread_mutex_lock(&coro_scheduler.ready_lock);
+    coro_scheduler.stopping = true;
+    pthread_cond_broadcast(&coro_scheduler.ready_cond);
+    pthread_mutex_unlock(&coro_scheduler.ready_lock);
+
+    pthread_mutex_lock(&coro_scheduler.timer_lock);
+    pthread_cond_signal(&coro_scheduler.timer_cond);
+    pthread_mutex_unlock(&coro_scheduler.timer_lock);
+
+    for (size_t i = 0; i < coro_scheduler.workers.size(); i++) {
+        pthread_join(coro_scheduler.workers[i], NULL);
+    }
+    pthread_join(coro_scheduler.timer_tid, NULL);
+    coro_scheduler.workers.clear();
+}
+
+inline void printCoroEngineReport() {
+    cout << ("Coroutine Engine:\n");
+    cout << ("  Scheduler threads: " + to_string(coro_scheduler.worker_count) + " + 1 timer\n");
+    cout << ("  Peak live frames: " + to_string(coro_scheduler.frames_peak.load()) + ", "
+         + to_string(coro_scheduler.frame_bytes_peak.load()) + " B per frame\n");
+    cout << ("  Resumes: " + to_string(coro_scheduler.resumes.load()) + "\n");
+}
+
+#else
+
+inline void notifyGreenWaiters(int intersection, int axis) {}
+
+#endif // CORO_ENGINE_AVAILABLE
+
+#endif // COROENGINE_H
@@ -0,0 +1,146 @@
+#ifndef CORRIDOR_H
+#define CORRIDOR_H
+
+// F10 <-> F11 corridor coordination. Eastbound through traffic enters F10
+// from the WEST approach and reaches F11's WEST approach one crossing plus
+// one link later; westbound traffic mirrors that on the EAST approaches.
+// A green wave picks F11's offset so both directions find green on arrival.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "simulation.h"
+#include "signalplan.h"
+#include "workload.h"
+
+using namespace std;
+
+const int CORRIDOR_SAMPLE_US = 50000;
+const int CORRIDOR_OFFSET_STEP_US = 100000;
+const int CORRIDOR_RANDOM_TRIALS = 20;
+
+// Free-flow time from entering the upstream box to reaching the downstream stop line
+inline int corridorTravelUs() {
+    return CROSSING_TIME + LINK_TRAVEL_TIME;
+}
+
+// Two-way bandwidth: time per cycle during which a vehicle released upstream
+// arrives downstream on green, summed over both directions
+inline long long corridorBandwidthUs(const CompiledSignalPlan& f10, const CompiledSignalPlan& f11, int travel_us) {
+    int east = sideIndex("WEST");
+    int west = sideIndex("EAST");
+    int cycle = f10.cycle_us;
+    long long bandwidth = 0;
+
+    for (long long t = 0; t < cycle; t += CORRIDOR_SAMPLE_US) {
+        if (isGreenAt(f10, east, t) && isGreenAt(f11, east, t + travel_us)) bandwidth += CORRIDOR_SAMPLE_US;
+        if (isGreenAt(f11, west, t) && isGreenAt(f10, west, t + travel_us)) bandwidth += CORRIDOR_SAMPLE_US;
+    }
+    return bandwidth;
+}
+
+// Keeps F10's offset and searches F11's for the widest two-way band. Both
+// plans must share a cycle length for the band to repeat every cycle.
+inline int optimizeGreenWaveOffset(const CompiledSignalPlan& f10, CompiledSignalPlan f11, int travel_us) {
+    int best_offset = f11.offset_us;
+    long long best_bandwidth = -1;
+
+    for (int offset = 0; offset < f11.cycle_us; offset += CORRIDOR_OFFSET_STEP_US) {
+        f11.offset_us = offset;
+        long long bandwidth = corridorBandwidthUs(f10, f11, travel_us);
+        if (bandwidth > best_bandwidth) {
+            best_bandwidth = bandwidth;
+            best_offset = offset;
+        }
+    }
+    return best_offset;
+}
+
+struct CorridorTrip {
+    long long arrive_us;
+    bool eastbound;
+};
+
+struct CorridorResult {
+    double mean_travel_s;
+    double stops_per_vehicle;
+    long long bandwidth_us;
+};
+
+// Replays every trip through both signals in virtual time. Crossings are not
+// capacity-limited, matching the vehicle engines, so trips are independent.
+inline CorridorResult evaluateCorridor(const vector<CorridorTrip>& trips, const CompiledSignalPlan& f10,
+                                       const CompiledSignalPlan& f11) {
+    int travel_us = corridorTravelUs();
+    long long total_travel = 0;
+    long stops = 0;
+
+    for (size_t i = 0; i < trips.size(); i++) {
+        const CompiledSignalPlan& first = trips[i].eastbound ? f10 : f11;
+        const CompiledSignalPlan& second = trips[i].eastbound ? f11 : f10;
+        int side = sideIndex(trips[i].eastbound ? "WEST" : "EAST");
+
+        long long t = trips[i].arrive_us;
+        long long go = nextGreenUs(first, side, t);
+        if (go > t) stops++;
+
+        t = go + travel_us;
+        go = nextGreenUs(second, side, t);
+        if (go > t) stops++;
+
+        total_travel += go + CROSSING_TIME - trips[i].arrive_us;
+    }
+
+    CorridorResult r;
+    r.mean_travel_s = trips.empty() ? 0.0 : total_travel / 1e6 / trips.size();
+    r.stops_per_vehicle = trips.empty() ? 0.0 : (double)stops / trips.size();
+    r.bandwidth_us = corridorBandwidthUs(f10, f11, travel_us);
+    return r;
+}
+
+inline void printCorridorResult(const string& label, const CorridorResult& r) {
+    cout << ("[BENCH] " + label + ": mean corridor travel " + to_string(r.mean_travel_s) + " s, "
+         + to_string(r.stops_per_vehicle) + " stops/vehicle, two-way bandwidth "
+         + to_string(r.bandwidth_us / 1000) + " ms/cycle\n");
+}
+
+// --bench corridor: the same seeded through-traffic demand under free-running
+// (random relative offset), simultaneous and green-wave timing
+inline int runCorridorBenchmark(int vehicles, unsigned int seed) {
+    srand(seed);
+    vector<CorridorTrip> trips;
+    long long t = 0;
+    for (int i = 0; i < vehicles; i++) {
+        t += SPAWN_MIN_DELAY + rand() % (SPAWN_MAX_DELAY - SPAWN_MIN_DELAY);
+        CorridorTrip trip = {t, rand() % 2 == 0};
+        trips.push_back(trip);
+    }
+
+    CompiledSignalPlan f10, f11;
+    if (!compileSignalPlan(defaultSignalPlan(0), f10) || !compileSignalPlan(defaultSignalPlan(1), f11)) return 1;
+
+    cout << ("[BENCH] Corridor: " + to_string(vehicles) + " through vehicles, seed " + to_string(seed)
+         + ", cycle " + to_string(f10.cycle_us / 1000) + " ms, F10->F11 travel "
+         + to_string(corridorTravelUs() / 1000) + " ms\n");
+
+    CorridorResult free_running = {0.0, 0.0, 0};
+    for (int trial = 0; trial < CORRIDOR_RANDOM_TRIALS; trial++) {
+        f11.offset_us = (int)(((long long)rand() * CORRIDOR_OFFSET_STEP_US) % f11.cycle_us);
+        CorridorResult r = evaluateCorridor(trips, f10, f11);
+        free_running.mean_travel_s += r.mean_travel_s / CORRIDOR_RANDOM_TRIALS;
+        free_running.stops_per_vehicle += r.stops_per_vehicle / CORRIDOR_RANDOM_TRIALS;
+        free_running.bandwidth_us += r.bandwidth_us / CORRIDOR_RANDOM_TRIALS;
+    }
+    printCorridorResult("uncoordinated (mean of " + to_string(CORRIDOR_RANDOM_TRIALS) + " random offsets)", free_running);
+
+    f11.offset_us = 0;
+    printCorridorResult("simultaneous (offsets 0,0)", evaluateCorridor(trips, f10, f11));
+
+    f11.offset_us = optimizeGreenWaveOffset(f10, f11, corridorTravelUs());
+    printCorridorResult("green wave (offsets 0," + to_string(f11.offset_us / 1000) + ")",
+                        evaluateCorridor(trips, f10, f11));
+    return 0;
+}
+
+#endif // CORRIDOR_H
@@ -0,0 +1,213 @@
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+// Live terminal dashboard. A thread wakes at a fixed frame rate, takes a
+// StateSnapshot through a capture callback, renders it into the back half of
+// a double buffer and hands the whole frame to the terminal in one write().
+// Rendering and output only ever read the snapshot.
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "simulation.h"
+#include "signalplan.h"
+#include "snapshot.h"
+#include "lifecycle.h"
+
+using namespace std;
+
+const int DASHBOARD_FRAME_BYTES = 4096;
+const int DASHBOARD_RATE_WINDOW_S = 10;
+
+typedef void (*SnapshotCaptureFn)(StateSnapshot& out);
+
+struct DashboardFrame {
+    char data[DASHBOARD_FRAME_BYTES];
+    int len;
+};
+
+struct Dashboard {
+    int hz;
+    SnapshotCaptureFn capture;
+    DashboardFrame frames[2];
+    int front;                      // frame currently on screen
+    long frames_rendered;
+    long frames_written;
+    long long start_ns;
+    vector<uint32_t> completed_history;     // one entry per frame, DASHBOARD_RATE_WINDOW_S long
+    size_t history_next;
+    string status_line;             // optional last line, e.g. the monitor's attach state
+    bool ansi;                      // false: plain text, one frame after another
+    atomic<bool> stopping;
+    pthread_t tid;
+};
+
+inline void appendFrame(DashboardFrame& frame, const char* format, ...) {
+    int room = DASHBOARD_FRAME_BYTES - frame.len;
+    if (room <= 1) return;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(frame.data + frame.len, room, format, args);
+    va_end(args);
+    if (n > 0) frame.len += (n < room) ? n : room - 1;
+}
+
+// Each line clears its own tail, so a frame overwrites the previous one in
+// place; only the first frame clears the screen
+inline void appendFrameLine(DashboardFrame& frame, bool ansi) {
+    appendFrame(frame, ansi ? "\033[K\n" : "\n");
+}
+
+inline const char* lightCell(uint8_t light, bool ansi) {
+    if (light == LIGHT_GREEN) return ansi ? "\033[32mGREEN \033[0m" : "GREEN ";
+    if (light == LIGHT_YELLOW) return ansi ? "\033[33mYELLOW\033[0m" : "YELLOW";
+    return ansi ? "\033[31mRED   \033[0m" : "RED   ";
+}
+
+inline void renderDashboard(Dashboard& dash, const StateSnapshot& s, DashboardFrame& frame) {
+    frame.len = 0;
+    double elapsed_s = (s.taken_ns - dash.start_ns) / 1e9;
+
+    // Completions over the last DASHBOARD_RATE_WINDOW_S seconds
+    vector<uint32_t>& history = dash.completed_history;
+    bool full = dash.frames_rendered >= (long)history.size();
+    uint32_t window_start = full ? history[dash.history_next] : history[0];
+    double window_s = (full ? (double)history.size() : (double)dash.frames_rendered) / dash.hz;
+    history[dash.history_next] = s.completed;
+    dash.history_next = (dash.history_next + 1) % history.size();
+    double recent_rate = (window_s > 0) ? (s.completed - window_start) * 60.0 / window_s : 0.0;
+    double overall_rate = (elapsed_s > 0) ? s.completed * 60.0 / elapsed_s : 0.0;
+
+    if (dash.ansi) appendFrame(frame, (dash.frames_rendered == 0) ? "\033[2J\033[H" : "\033[H");
+    appendFrame(frame, "TRAFFIC SIMULATION DASHBOARD   t=%ld s   %d Hz", (long)elapsed_s, dash.hz);
+    appendFrameLine(frame, dash.ansi);
+    appendFrame(frame, "--------------------------------------------------------------------------");
+    appendFrameLine(frame, dash.ansi);
+    appendFrame(frame, "       ");
+    for (int side = 0; side < NUM_SIDES; side++) appendFrame(frame, "%-14s", SPAWN_SIDES[side].c_str());
+    appendFrame(frame, "EMERGENCY");
+    appendFrameLine(frame, dash.ansi);
+
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        const IntersectionSnapshot& in = s.intersections[i];
+        appendFrame(frame, "%-7s", INTERSECTION_IDS[i].c_str());
+        for (int side = 0; side < NUM_SIDES; side++) {
+            appendFrame(frame, "%s q%-5u ", lightCell(in.lights[side], dash.ansi), in.queued[side]);
+        }
+        appendFrame(frame, "%s", in.emergency_mode ? "ACTIVE" : "-");
+        appendFrameLine(frame, dash.ansi);
+    }
+    appendFrameLine(frame, dash.ansi);
+
+    appendFrame(frame, "Parking ");
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        appendFrame(frame, "  %s: %2u/%d parked, %u/%d waiting", INTERSECTION_IDS[i].c_str(), s.parking[i].parked,
+                    MAX_PARKING_SPOTS, s.parking[i].waiting, MAX_WAITING_QUEUE);
+    }
+    appendFrameLine(frame, dash.ansi);
+
+    appendFrame(frame, "Links   ");
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        appendFrame(frame, "  %s->%s: %u/%u", INTERSECTION_IDS[i].c_str(),
+                    INTERSECTION_IDS[(i + 1) % NUM_INTERSECTIONS].c_str(), s.link_occupancy[i], s.link_capacity[i]);
+    }
+    appendFrameLine(frame, dash.ansi);
+
+    appendFrame(frame, "Emergency corridor: %s", EMERGENCY_NAMES[s.emergency].c_str());
+    appendFrameLine(frame, dash.ansi);
+    appendFrameLine(frame, dash.ansi);
+
+    appendFrame(frame, "Vehicles  spawned %u   in flight %u   completed %u   aborted %u", s.spawned, s.in_flight,
+                s.completed, s.aborted);
+    appendFrameLine(frame, dash.ansi);
+    appendFrame(frame, "Throughput  %.1f veh/min (last %d s)   %.1f veh/min overall", recent_rate,
+                DASHBOARD_RATE_WINDOW_S, overall_rate);
+    appendFrameLine(frame, dash.ansi);
+    if (!dash.status_line.empty()) {
+        appendFrame(frame, "%s", dash.status_line.c_str());
+        appendFrameLine(frame, dash.ansi);
+    }
+    if (dash.ansi) appendFrame(frame, "\033[J");
+
+    dash.frames_rendered++;
+}
+
+// One write() per frame. The clock only shows whole seconds, so while the
+// state holds still a repeat of the frame already on screen is skipped.
+inline void presentDashboardFrame(Dashboard& dash) {
+    DashboardFrame& back = dash.frames[1 - dash.front];
+    DashboardFrame& shown = dash.frames[dash.front];
+    if (back.len == shown.len && memcmp(back.data, shown.data, back.len) == 0) return;
+
+    pthread_mutex_lock(&console_mutex);
+    const char* p = back.data;
+    int remaining = back.len;
+    while (remaining > 0) {
+        ssize_t n = write(STDOUT_FILENO, p, remaining);
+        if (n <= 0) break;
+        p += n;
+        remaining -= (int)n;
+    }
+    pthread_mutex_unlock(&console_mutex);
+
+    dash.front = 1 - dash.front;
+    dash.frames_written++;
+}
+
+inline void drawDashboard(Dashboard& dash) {
+    StateSnapshot snapshot;
+    dash.capture(snapshot);
+    renderDashboard(dash, snapshot, dash.frames[1 - dash.front]);
+    presentDashboardFrame(dash);
+}
+
+inline void* dashboardThread(void* arg) {
+    Dashboard& dash = *(Dashboard*)arg;
+    long long period_us = 1000000 / dash.hz;
+
+    struct timespec next_frame;
+    clock_gettime(CLOCK_MONOTONIC, &next_frame);
+
+    while (!dash.stopping.load()) {
+        drawDashboard(dash);
+        addUsToTimespec(next_frame, period_us);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_frame, NULL);
+    }
+    return NULL;
+}
+
+inline void initDashboard(Dashboard& dash, int hz, SnapshotCaptureFn capture) {
+    dash.hz = hz;
+    dash.capture = capture;
+    dash.frames[0].len = 0;
+    dash.frames[1].len = 0;
+    dash.front = 0;
+    dash.frames_rendered = 0;
+    dash.frames_written = 0;
+    dash.start_ns = monotonicNowNs();
+    dash.completed_history.assign((size_t)hz * DASHBOARD_RATE_WINDOW_S, 0);
+    dash.history_next = 0;
+    dash.ansi = true;
+    dash.stopping = false;
+}
+
+inline void startDashboard(Dashboard& dash, int hz, SnapshotCaptureFn capture) {
+    initDashboard(dash, hz, capture);
+    fflush(stdout);
+    pthread_create(&dash.tid, NULL, dashboardThread, &dash);
+}
+
+// Joins the thread and leaves the final state on screen
+inline void stopDashboard(Dashboard& dash) {
+    dash.stopping.store(true);
+    pthread_join(dash.tid, NULL);
+    drawDashboard(dash);
+}
+
+#endif // DASHBOARD_H
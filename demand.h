@@ -0,0 +1,341 @@
+#ifndef DEMAND_H
+#define DEMAND_H
+
+// Bulk arrival schedules from demand profiles (--demand). A profile gives a
+// base volume per approach and a demand curve, a periodic piecewise-linear
+// multiplier. All approaches share the curve, so the arrivals are one
+// non-homogeneous Poisson process at curve(t) times the total volume. Each
+// gap is one exponential draw mapped through the integrated curve, so no
+// candidate is ever thrown away. The approach, and a joint (type, direction,
+// parking) class, each come from one alias table draw. The generator fills
+// DEMAND_BATCH records at a time ahead of the spawner.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include "simulation.h"
+#include "workload.h"
+
+using namespace std;
+
+const int DEMAND_BATCH = 4096;
+const int DEMAND_CURVE_POINTS = 8;
+const int DEMAND_ENTRIES = NUM_INTERSECTIONS * NUM_SIDES;
+const int DEMAND_CLASSES = NUM_VEHICLE_TYPES * NUM_DIRECTIONS * 2;    // type, direction, parking intent
+const long DEMAND_BENCH_ARRIVALS = 10000000;
+
+struct DemandPoint {
+    double at_s;
+    double factor;
+};
+
+struct DemandProfile {
+    string name;
+    double vehicles_per_min[NUM_INTERSECTIONS][NUM_SIDES];     // base volume, in SPAWN_SIDES order
+    double period_s;
+    int points;
+    DemandPoint curve[DEMAND_CURVE_POINTS];     // from 0 to period_s
+};
+
+// flat matches the random spawner's mean rate (one vehicle per 1.25 s);
+// rush-hour peaks at 2.5x with the corridor entries loaded; corridor favours
+// the east-west mainline over the side streets
+const DemandProfile DEMAND_PROFILES[] = {
+    {"flat", {{6, 6, 6, 6}, {6, 6, 6, 6}}, 60.0, 2, {{0, 1.0}, {60, 1.0}}},
+    {"rush-hour", {{5, 5, 5, 12}, {5, 5, 12, 5}}, 60.0, 6,
+     {{0, 0.4}, {10, 0.4}, {20, 2.5}, {30, 2.5}, {40, 0.4}, {60, 0.4}}},
+    {"corridor", {{3, 3, 10, 10}, {3, 3, 10, 10}}, 60.0, 2, {{0, 1.0}, {60, 1.0}}},
+};
+const int NUM_DEMAND_PROFILES = 3;
+
+inline const DemandProfile* findDemandProfile(const string& name) {
+    for (int p = 0; p < NUM_DEMAND_PROFILES; p++) {
+        if (DEMAND_PROFILES[p].name == name) return &DEMAND_PROFILES[p];
+    }
+    return NULL;
+}
+
+// Vose's alias method: a column and a coin from one 64-bit draw
+template <int N>
+struct AliasTable {
+    uint32_t threshold[N];      // keep the column if the coin is below this
+    uint8_t alias[N];
+};
+
+template <int N>
+inline void buildAliasTable(AliasTable<N>& table, const double* weights) {
+    double total = 0;
+    for (int i = 0; i < N; i++) total += weights[i];
+    double scaled[N];
+    int small[N], large[N];
+    int small_count = 0, large_count = 0;
+    for (int i = 0; i < N; i++) {
+        scaled[i] = weights[i] * N / total;
+        if (scaled[i] < 1.0) small[small_count++] = i;
+        else large[large_count++] = i;
+    }
+    while (small_count > 0 && large_count > 0) {
+        int s = small[--small_count];
+        int l = large[--large_count];
+        table.threshold[s] = (uint32_t)(scaled[s] * 4294967295.0);
+        table.alias[s] = (uint8_t)l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) small[small_count++] = l;
+        else large[large_count++] = l;
+    }
+    // Leftovers are 1 up to rounding
+    while (large_count > 0) {
+        int l = large[--large_count];
+        table.threshold[l] = UINT32_MAX;
+        table.alias[l] = (uint8_t)l;
+    }
+    while (small_count > 0) {
+        int s = small[--small_count];
+        table.threshold[s] = UINT32_MAX;
+        table.alias[s] = (uint8_t)s;
+    }
+}
+
+template <int N>
+inline int sampleAliasTable(const AliasTable<N>& table, uint64_t draw) {
+    int column = (int)(((draw >> 32) * N) >> 32);
+    return ((uint32_t)draw < table.threshold[column]) ? column : table.alias[column];
+}
+
+struct DemandClass {
+    uint8_t type;
+    uint8_t direction;
+    uint8_t wants_parking;
+    uint8_t emergency;
+};
+
+struct DemandStats {
+    long generated;
+    long batches;
+};
+
+// Plain data: a copy continues the same schedule
+struct DemandGenerator {
+    const DemandProfile* profile;
+    uint64_t rng;
+    double t_s;
+    double base_rate;           // vehicles/s at a curve factor of 1
+    double cycle_start_s;
+    int segment;                // curve segment holding t_s - cycle_start_s
+    AliasTable<DEMAND_ENTRIES> entries;
+    AliasTable<DEMAND_CLASSES> classes;
+    DemandClass class_of[DEMAND_CLASSES];
+    uint8_t corridor_entry[2][2];   // eastbound, westbound: intersection, side
+    DemandStats stats;
+};
+
+// xorshift64*
+inline uint64_t nextDemandDraw(DemandGenerator& g) {
+    g.rng ^= g.rng >> 12;
+    g.rng ^= g.rng << 25;
+    g.rng ^= g.rng >> 27;
+    return g.rng * 2685821657736338717ULL;
+}
+
+// In (0, 1], so the log below is finite
+inline double nextDemandUniform(DemandGenerator& g) {
+    return ((nextDemandDraw(g) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+// Type shares are the PROB_* constants. Emergency vehicles go straight and
+// never park; everyone else picks a direction by PROB_STRAIGHT/LEFT/RIGHT
+// and wants parking PARKING_PROBABILITY percent of the time.
+inline void initDemandGenerator(DemandGenerator& g, const DemandProfile& profile, unsigned int seed) {
+    g.profile = &profile;
+    uint64_t z = seed + 0x9e3779b97f4a7c15ULL;     // splitmix64 finalizer; xorshift needs a nonzero state
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    g.rng = (z ^ (z >> 31)) | 1;
+    g.t_s = 0;
+    g.cycle_start_s = 0;
+    g.segment = 0;
+
+    double volumes[DEMAND_ENTRIES];
+    double per_min = 0;
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        for (int side = 0; side < NUM_SIDES; side++) {
+            volumes[i * NUM_SIDES + side] = profile.vehicles_per_min[i][side];
+            per_min += profile.vehicles_per_min[i][side];
+        }
+    }
+    buildAliasTable(g.entries, volumes);
+
+    g.base_rate = per_min / 60.0;
+
+    const int type_share[NUM_VEHICLE_TYPES] = {PROB_CAR, PROB_BIKE, PROB_BUS, PROB_TRACTOR, PROB_AMBULANCE, PROB_FIRETRUCK};
+    const int direction_share[NUM_DIRECTIONS] = {PROB_STRAIGHT, PROB_LEFT, PROB_RIGHT};     // DIRECTIONS order
+    double weights[DEMAND_CLASSES];
+    for (int c = 0; c < DEMAND_CLASSES; c++) {
+        DemandClass& k = g.class_of[c];
+        k.wants_parking = (uint8_t)(c & 1);
+        k.direction = (uint8_t)((c >> 1) % NUM_DIRECTIONS);
+        k.type = (uint8_t)((c >> 1) / NUM_DIRECTIONS);
+        k.emergency = isEmergencyVehicle(VEHICLE_TYPES[k.type]) ? 1 : 0;
+        if (k.emergency) {
+            weights[c] = (k.direction == 0 && !k.wants_parking) ? type_share[k.type] : 0.0;
+        } else {
+            weights[c] = type_share[k.type] * direction_share[k.direction] / 100.0
+                       * (k.wants_parking ? PARKING_PROBABILITY : 100 - PARKING_PROBABILITY) / 100.0;
+        }
+    }
+    buildAliasTable(g.classes, weights);
+    // Emergency vehicles enter only where the emergency corridor starts
+    g.corridor_entry[0][0] = (uint8_t)intersectionIndex("F10");
+    g.corridor_entry[0][1] = (uint8_t)sideIndex("WEST");
+    g.corridor_entry[1][0] = (uint8_t)intersectionIndex("F11");
+    g.corridor_entry[1][1] = (uint8_t)sideIndex("EAST");
+    g.stats = {0, 0};
+}
+
+// Moves t_s on by a unit-rate exponential gap mapped through the integrated
+// demand: the rate is linear within a curve segment, so the gap ends where
+// the segment's trapezoid area reaches what is left of it
+inline void advanceDemandClock(DemandGenerator& g) {
+    const DemandProfile& p = *g.profile;
+    double remaining = -log(nextDemandUniform(g)) / g.base_rate;      // in factor-seconds
+    while (true) {
+        double at = g.t_s - g.cycle_start_s;
+        const DemandPoint& a = p.curve[g.segment];
+        const DemandPoint& b = p.curve[g.segment + 1];
+        double slope = (b.at_s > a.at_s) ? (b.factor - a.factor) / (b.at_s - a.at_s) : 0.0;
+        double f0 = a.factor + slope * (at - a.at_s);
+        double span = b.at_s - at;
+        double area = (f0 + 0.5 * slope * span) * span;
+        if (area >= remaining && remaining > 0) {
+            // f0 * dt + slope * dt^2 / 2 = remaining, in the form that stays exact as slope -> 0
+            g.t_s += 2.0 * remaining / (f0 + sqrt(f0 * f0 + 2.0 * slope * remaining));
+            return;
+        }
+        if (remaining <= 0) return;
+        remaining -= area;
+        g.t_s = g.cycle_start_s + b.at_s;
+        if (++g.segment + 1 >= p.points) {
+            g.segment = 0;
+            g.cycle_start_s += p.period_s;
+        }
+    }
+}
+
+inline void generateDemandArrival(DemandGenerator& g, ArrivalRecord& rec) {
+    advanceDemandClock(g);
+
+    memset(&rec, 0, sizeof(rec));
+    rec.time_ms = (uint32_t)(uint64_t)(g.t_s * 1000.0);
+    const DemandClass& k = g.class_of[sampleAliasTable(g.classes, nextDemandDraw(g))];
+    rec.type = k.type;
+    rec.direction = k.direction;
+    rec.wants_parking = k.wants_parking;
+
+    uint64_t draw = nextDemandDraw(g);
+    if (k.emergency) {
+        rec.intersection = g.corridor_entry[draw & 1][0];
+        rec.side = g.corridor_entry[draw & 1][1];
+    } else {
+        int entry = sampleAliasTable(g.entries, draw);
+        rec.intersection = (uint8_t)(entry / NUM_SIDES);
+        rec.side = (uint8_t)(entry % NUM_SIDES);
+    }
+    rec.park_time_ms = (uint32_t)((PARKING_MIN_TIME + nextDemandDraw(g) % (PARKING_MAX_TIME - PARKING_MIN_TIME)) / 1000);
+    g.stats.generated++;
+}
+
+// The spawner's read-ahead buffer
+struct DemandSchedule {
+    DemandGenerator generator;
+    ArrivalRecord batch[DEMAND_BATCH];
+    int count;
+    int next;
+    long long start_ns;         // the spawner's start; time_ms counts from here
+};
+
+inline void initDemandSchedule(DemandSchedule& s, const DemandProfile& profile, unsigned int seed) {
+    initDemandGenerator(s.generator, profile, seed);
+    s.count = 0;
+    s.next = 0;
+    s.start_ns = 0;
+}
+
+inline void fillDemandBatch(DemandGenerator& g, ArrivalRecord* out, int count) {
+    for (int k = 0; k < count; k++) generateDemandArrival(g, out[k]);
+    g.stats.batches++;
+}
+
+inline void nextDemandArrival(DemandSchedule& s, ArrivalRecord& rec) {
+    if (s.next == s.count) {
+        fillDemandBatch(s.generator, s.batch, DEMAND_BATCH);
+        s.count = DEMAND_BATCH;
+        s.next = 0;
+    }
+    rec = s.batch[s.next++];
+}
+
+inline void printDemandReport(const DemandSchedule& s, int spawned) {
+    const DemandStats& st = s.generator.stats;
+    char text[160];
+    snprintf(text, sizeof(text), "  Demand profile %s: %d spawned from %ld generated in %ld batches\n",
+             s.generator.profile->name.c_str(), spawned, st.generated, st.batches);
+    cout << text;
+}
+
+// DEMAND_BENCH_ARRIVALS per profile, batch by batch as the spawner takes them
+inline int runDemandBenchmark(unsigned int seed) {
+    vector<ArrivalRecord> batch(DEMAND_BATCH);
+    for (int p = 0; p < NUM_DEMAND_PROFILES; p++) {
+        const DemandProfile& profile = DEMAND_PROFILES[p];
+        DemandGenerator g;
+        initDemandGenerator(g, profile, seed);
+
+        long types[NUM_VEHICLE_TYPES] = {0};
+        long entries[DEMAND_ENTRIES] = {0};
+        long parking = 0;
+        long long start_ns = monotonicNowNs();
+        for (long done = 0; done < DEMAND_BENCH_ARRIVALS; done += DEMAND_BATCH) {
+            int count = (int)min((long)DEMAND_BATCH, DEMAND_BENCH_ARRIVALS - done);
+            fillDemandBatch(g, batch.data(), count);
+            for (int k = 0; k < count; k++) {
+                types[batch[k].type]++;
+                entries[batch[k].intersection * NUM_SIDES + batch[k].side]++;
+                parking += batch[k].wants_parking;
+            }
+        }
+        double elapsed_s = (monotonicNowNs() - start_ns) / 1e9;
+
+        double per_min = 0;
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+            for (int side = 0; side < NUM_SIDES; side++) per_min += profile.vehicles_per_min[i][side];
+        }
+        char text[200];
+        snprintf(text, sizeof(text), "[BENCH] Demand %s: %ld arrivals in %.1f ms (%.1f M/s), %.2f vehicles/s "
+                 "over %.0f s (base %.2f)\n",
+                 profile.name.c_str(), DEMAND_BENCH_ARRIVALS, elapsed_s * 1000.0, DEMAND_BENCH_ARRIVALS / elapsed_s / 1e6,
+                 DEMAND_BENCH_ARRIVALS / g.t_s, g.t_s, per_min / 60.0);
+        cout << text;
+        string line = "[BENCH]   types:";
+        for (int t = 0; t < NUM_VEHICLE_TYPES; t++) {
+            snprintf(text, sizeof(text), " %s %.1f%%,", VEHICLE_TYPES[t].c_str(), 100.0 * types[t] / DEMAND_BENCH_ARRIVALS);
+            line += text;
+        }
+        snprintf(text, sizeof(text), " parking %.1f%%", 100.0 * parking / DEMAND_BENCH_ARRIVALS);
+        cout << (line + text + "\n");
+        line = "[BENCH]   entries:";
+        for (int e = 0; e < DEMAND_ENTRIES; e++) {
+            snprintf(text, sizeof(text), " %s %s %.1f%%,", INTERSECTION_IDS[e / NUM_SIDES].c_str(),
+                     SPAWN_SIDES[e % NUM_SIDES].c_str(), 100.0 * entries[e] / DEMAND_BENCH_ARRIVALS);
+            line += text;
+        }
+        line.pop_back();
+        cout << (line + "\n");
+    }
+    return 0;
+}
+
+#endif // DEMAND_H
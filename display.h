@@ -9,6 +9,7 @@
 #include "intersection.h"
 #include "parkinglot.h"
 #include "vehicle.h"
+#include "log.h"
 
 using namespace std;
 
@@ -34,49 +35,46 @@ inline void displayShutdownBanner() {
     cout << ("================================================================================\n");
     cout << ("                          SIMULATION COMPLETE\n");
     cout << ("================================================================================\n");
-    cout << ("  Total Vehicles Processed: " + to_string(vehicles_completed) + "\n");
+    cout << ("  Total Vehicles Processed: " + to_string(vehiclesCompleted(sim_context)) + "\n");
     cout << ("================================================================================\n");
     cout << ("\n");
     
     pthread_mutex_unlock(&console_mutex);
 }
 
-inline void logVehicleSpawn(int id, string type, string intersection, string side, string direction) {
-    safePrintWithTime("[SPAWN] Vehicle " + to_string(id) + " (" + type + ") spawned at " 
-       + intersection + " " + side + " going " + direction);
+inline void logVehicleSpawn(int id, const string& type, const string& intersection, const string& side,
+                            const string& direction) {
+    LOG_DEBUG("[SPAWN] Vehicle ", id, " (", type, ") spawned at ", intersection, " ", side,
+              " going ", direction);
 }
 
-inline void logVehicleEntry(int id, string type, string intersection, string side) {
-    safePrintWithTime("[ENTRY] Vehicle " + to_string(id) + " (" + type + ") entered " 
-       + intersection + " from " + side);
+inline void logVehicleEntry(int id, const string& type, const string& intersection, const string& side) {
+    LOG_DEBUG("[ENTRY] Vehicle ", id, " (", type, ") entered ", intersection, " from ", side);
 }
 
-inline void logVehicleExit(int id, string type, string intersection, string side) {
-    safePrintWithTime("[EXIT] Vehicle " + to_string(id) + " (" + type + ") exited " 
-       + intersection + " via " + side);
+inline void logVehicleExit(int id, const string& type, const string& intersection, const string& side) {
+    LOG_DEBUG("[EXIT] Vehicle ", id, " (", type, ") exited ", intersection, " via ", side);
 }
 
-inline void logVehicleTransit(int id, string type, string from_int, string to_int) {
-    safePrintWithTime("[TRANSIT] Vehicle " + to_string(id) + " (" + type + ") moving from " 
-       + from_int + " to " + to_int);
+inline void logVehicleTransit(int id, const string& type, const string& from_int, const string& to_int) {
+    LOG_DEBUG("[TRANSIT] Vehicle ", id, " (", type, ") moving from ", from_int, " to ", to_int);
 }
 
-inline void logVehicleComplete(int id, string type) {
-    safePrintWithTime("[COMPLETE] Vehicle " + to_string(id) + " (" + type + ") has exited the simulation");
+inline void logVehicleComplete(int id, const string& type) {
+    LOG_DEBUG("[COMPLETE] Vehicle ", id, " (", type, ") has exited the simulation");
 }
 
-inline void logParking(int id, string type, string intersection, bool entering) {
-    safePrintWithTime("[PARKING] Vehicle " + to_string(id) + " (" + type + ") " 
-       + string(entering ? "parked at" : "left parking at") + " " + intersection);
+inline void logParking(int id, const string& type, const string& intersection, bool entering) {
+    LOG_DEBUG("[PARKING] Vehicle ", id, " (", type, ") ", (entering ? "parked at" : "left parking at"),
+              " ", intersection);
 }
 
-inline void logEmergency(string direction, bool starting) {
-    safePrintWithTime("[EMERGENCY] " + string(starting ? "ACTIVATING" : "DEACTIVATING") 
-       + " " + direction + " corridor");
+inline void logEmergency(const string& direction, bool starting) {
+    LOG_INFO("[EMERGENCY] ", (starting ? "ACTIVATING" : "DEACTIVATING"), " ", direction, " corridor");
 }
 
-inline void logLightChange(string intersection, string direction, string state) {
-    safePrintWithTime("[LIGHT] " + intersection + " " + direction + " -> " + state);
+inline void logLightChange(const string& intersection, const string& direction, const string& state) {
+    LOG_INFO("[LIGHT] ", intersection, " ", direction, " -> ", state);
 }
 
 #endif // DISPLAY_H
@@ -0,0 +1,290 @@
+#ifndef EPOCHVIEWS_H
+#define EPOCHVIEWS_H
+
+// Read-only views of the approach queues and parking lots. Whoever changes a
+// queue or lot already holds its lock; it copies the new contents into a
+// fresh immutable view, swaps that in and retires the old one. Readers (the
+// dashboard, the final statistics) announce the epoch they read in, load the
+// current view and walk it without taking any simulation lock. A retired view
+// is freed once every announced reader epoch is past the one it was retired
+// in. Writers never wait for readers: they pay one copy and a push onto the
+// retire list, and every VIEW_RECLAIM_BATCH retirements a scan of the reader
+// slots, whatever the number of readers.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <climits>
+#include <pthread.h>
+#include "simulation.h"
+#include "context.h"
+#include "intersection.h"
+#include "parkinglot.h"
+#include "workload.h"
+
+using namespace std;
+
+const int VIEW_READER_SLOTS = 16;
+const int VIEW_RECLAIM_BATCH = 64;
+const uint64_t VIEW_QUIESCENT = UINT64_MAX;    // slot epoch outside a read
+
+struct ViewVehicle {
+    int32_t id;
+    uint8_t type;               // index into VEHICLE_TYPES
+};
+
+struct IntersectionView {
+    uint64_t version;
+    long long published_ns;     // CLOCK_MONOTONIC
+    uint8_t lights[NUM_SIDES];
+    bool emergency_mode;
+    uint32_t first[NUM_SIDES + 1];      // approach a queues vehicles[first[a]] .. vehicles[first[a + 1] - 1]
+    vector<ViewVehicle> vehicles;
+};
+
+struct ParkingView {
+    uint64_t version;
+    long long published_ns;
+    vector<ViewVehicle> parked;
+    vector<ViewVehicle> waiting;
+};
+
+struct RetiredView {
+    const void* view;
+    void (*destroy)(const void*);
+    uint64_t epoch;
+};
+
+struct alignas(CACHE_LINE_BYTES) ViewReaderSlot {
+    atomic<uint64_t> epoch;
+    atomic<bool> claimed;
+    long reads;                 // owner only
+};
+
+struct ViewDomainStats {
+    long published;
+    long reclaimed;
+    long peak_retired;
+    long fallback_reads;        // readers that found no free slot
+};
+
+struct ViewDomain {
+    atomic<uint64_t> epoch;
+    ViewReaderSlot readers[VIEW_READER_SLOTS];
+    atomic<const IntersectionView*> intersections[NUM_INTERSECTIONS];
+    atomic<const ParkingView*> lots[NUM_INTERSECTIONS];
+    pthread_mutex_t retire_lock;
+    vector<RetiredView> retired;
+    ViewDomainStats stats;      // under retire_lock
+};
+
+inline void destroyIntersectionView(const void* view) {
+    delete (const IntersectionView*)view;
+}
+
+inline void destroyParkingView(const void* view) {
+    delete (const ParkingView*)view;
+}
+
+inline void initViewDomain(ViewDomain& d) {
+    d.epoch.store(0);
+    for (int r = 0; r < VIEW_READER_SLOTS; r++) {
+        d.readers[r].epoch.store(VIEW_QUIESCENT);
+        d.readers[r].claimed.store(false);
+        d.readers[r].reads = 0;
+    }
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        d.intersections[i].store(NULL);
+        d.lots[i].store(NULL);
+    }
+    pthread_mutex_init(&d.retire_lock, NULL);
+    d.retired.reserve(2 * VIEW_RECLAIM_BATCH);
+    d.stats = {0, 0, 0, 0};
+}
+
+// Frees everything; no reader may be left
+inline void destroyViewDomain(ViewDomain& d) {
+    for (size_t k = 0; k < d.retired.size(); k++) d.retired[k].destroy(d.retired[k].view);
+    d.retired.clear();
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        delete d.intersections[i].exchange(NULL);
+        delete d.lots[i].exchange(NULL);
+    }
+    pthread_mutex_destroy(&d.retire_lock);
+}
+
+// Caller holds retire_lock. A view retired in epoch e may still be held by a
+// reader that announced e or earlier; a later reader loaded its successor.
+inline void reclaimViewsLocked(ViewDomain& d) {
+    uint64_t oldest = VIEW_QUIESCENT;
+    for (int r = 0; r < VIEW_READER_SLOTS; r++) oldest = min(oldest, d.readers[r].epoch.load());
+
+    size_t kept = 0;
+    for (size_t k = 0; k < d.retired.size(); k++) {
+        if (d.retired[k].epoch < oldest) {
+            d.retired[k].destroy(d.retired[k].view);
+            d.stats.reclaimed++;
+        } else {
+            d.retired[kept++] = d.retired[k];
+        }
+    }
+    d.retired.resize(kept);
+}
+
+// Caller holds the lock guarding the viewed state, so publications of one
+// slot are ordered and the old view cannot be retired twice
+template <typename View>
+inline void publishView(ViewDomain& d, atomic<const View*>& slot, View* view, void (*destroy)(const void*)) {
+    const View* old = slot.load();
+    view->version = (old == NULL) ? 1 : old->version + 1;
+    view->published_ns = monotonicNowNs();
+    slot.store(view);
+
+    pthread_mutex_lock(&d.retire_lock);
+    d.stats.published++;
+    if (old != NULL) {
+        RetiredView r = {old, destroy, d.epoch.fetch_add(1)};
+        d.retired.push_back(r);
+        d.stats.peak_retired = max(d.stats.peak_retired, (long)d.retired.size());
+        if (d.retired.size() % VIEW_RECLAIM_BATCH == 0) reclaimViewsLocked(d);
+    }
+    pthread_mutex_unlock(&d.retire_lock);
+}
+
+// Caller holds the intersection's mutex
+inline void publishIntersectionView(ViewDomain& d, int index, const Intersection& intersection) {
+    IntersectionView* view = new IntersectionView;
+    for (int side = 0; side < NUM_SIDES; side++) {
+        const TrafficController& approach = intersection.approaches[side];
+        view->lights[side] = intersection.lights[side];
+        view->first[side] = (uint32_t)view->vehicles.size();
+        for (size_t k = 0; k < approach.queue.size(); k++) {
+            ViewVehicle entry = {approach.queue[k].id, (uint8_t)vehicleTypeIndex(approach.queue[k].type)};
+            view->vehicles.push_back(entry);
+        }
+    }
+    view->first[NUM_SIDES] = (uint32_t)view->vehicles.size();
+    view->emergency_mode = intersection.emergency_mode;
+    publishView(d, d.intersections[index], view, destroyIntersectionView);
+}
+
+// Takes the lot's access_lock for the copy and the swap
+inline void publishParkingView(ViewDomain& d, int index, ParkingLot& lot) {
+    ParkingView* view = new ParkingView;
+    sem_wait(&lot.access_lock);
+    view->parked.reserve(lot.parked_vehicles.size());
+    for (size_t k = 0; k < lot.parked_vehicles.size(); k++) {
+        ViewVehicle entry = {lot.parked_vehicles[k].id, (uint8_t)vehicleTypeIndex(lot.parked_vehicles[k].type)};
+        view->parked.push_back(entry);
+    }
+    view->waiting.reserve(lot.waiting_vehicles.size());
+    for (size_t k = 0; k < lot.waiting_vehicles.size(); k++) {
+        ViewVehicle entry = {lot.waiting_vehicles[k].id, (uint8_t)vehicleTypeIndex(lot.waiting_vehicles[k].type)};
+        view->waiting.push_back(entry);
+    }
+    publishView(d, d.lots[index], view, destroyParkingView);
+    sem_post(&lot.access_lock);
+}
+
+// A thread keeps the slot it claims first; -1 once all are taken
+inline int viewReaderSlot(ViewDomain& d) {
+    static thread_local int slot = -2;
+    if (slot != -2) return slot;
+    slot = -1;
+    for (int r = 0; r < VIEW_READER_SLOTS && slot < 0; r++) {
+        bool expected = false;
+        if (d.readers[r].claimed.compare_exchange_strong(expected, true)) slot = r;
+    }
+    return slot;
+}
+
+// Scoped read: views loaded inside it stay valid until it ends. A thread
+// without a slot holds retire_lock instead, which only delays retirement.
+struct ViewReadSection {
+    ViewDomain& domain;
+    int slot;
+
+    explicit ViewReadSection(ViewDomain& d) : domain(d), slot(viewReaderSlot(d)) {
+        if (slot < 0) {
+            pthread_mutex_lock(&d.retire_lock);
+            d.stats.fallback_reads++;
+            return;
+        }
+        d.readers[slot].epoch.store(d.epoch.load());
+        d.readers[slot].reads++;
+    }
+    ~ViewReadSection() {
+        if (slot < 0) pthread_mutex_unlock(&domain.retire_lock);
+        else domain.readers[slot].epoch.store(VIEW_QUIESCENT);
+    }
+
+    const IntersectionView& intersection(int index) const { return *domain.intersections[index].load(); }
+    const ParkingView& lot(int index) const { return *domain.lots[index].load(); }
+};
+
+inline uint32_t viewQueueLength(const IntersectionView& view, int side) {
+    return view.first[side + 1] - view.first[side];
+}
+
+inline void printViewVehicles(const string& heading, const vector<ViewVehicle>& vehicles) {
+    if (vehicles.empty()) {
+        cout << (heading + ": None\n");
+        return;
+    }
+    cout << (heading + ":\n");
+    for (size_t i = 0; i < vehicles.size(); i++) {
+        cout << ("  " + to_string(i + 1) + ". " + VEHICLE_TYPES[vehicles[i].type]
+             + " (ID: " + to_string(vehicles[i].id) + ")\n");
+    }
+}
+
+inline void printParkingLot(const ParkingView& view, const string& id) {
+    cout << ("========================================\n");
+    cout << ("PARKING LOT: " + id + " (view " + to_string(view.version) + ")\n");
+    cout << ("========================================\n");
+    cout << ("Capacity: " + to_string(MAX_PARKING_SPOTS) + " spots\n");
+    cout << ("Available: " + to_string(MAX_PARKING_SPOTS - (int)view.parked.size()) + " spots\n");
+    cout << ("Occupied: " + to_string(view.parked.size()) + " vehicles\n");
+    cout << ("----------------------------------------\n");
+    printViewVehicles("Parked Vehicles", view.parked);
+    cout << ("----------------------------------------\n");
+    cout << ("Wait Queue: " + to_string(view.waiting.size()) + "/" + to_string(MAX_WAITING_QUEUE) + "\n");
+    printViewVehicles("Waiting Vehicles", view.waiting);
+    cout << ("========================================\n");
+}
+
+inline void printIntersection(const IntersectionView& view, const string& id) {
+    cout << ("========================================\n");
+    cout << ("INTERSECTION: " + id + " (view " + to_string(view.version) + ")\n");
+    cout << ("========================================\n");
+    cout << ("Emergency Mode: " + string(view.emergency_mode ? "ACTIVE" : "INACTIVE") + "\n");
+    cout << ("----------------------------------------\n");
+    for (int side = 0; side < NUM_SIDES; side++) {
+        vector<ViewVehicle> queue(view.vehicles.begin() + view.first[side], view.vehicles.begin() + view.first[side + 1]);
+        printViewVehicles(string(FourWayLayout::NAMES[side]) + " (" + LIGHT_STATE_NAMES[view.lights[side]] + ")", queue);
+    }
+    cout << ("========================================\n");
+}
+
+inline void printViewDomainReport(ViewDomain& d) {
+    long reads = 0;
+    int readers = 0;
+    for (int r = 0; r < VIEW_READER_SLOTS; r++) {
+        reads += d.readers[r].reads;
+        if (d.readers[r].claimed.load()) readers++;
+    }
+    pthread_mutex_lock(&d.retire_lock);
+    ViewDomainStats s = d.stats;
+    long pending = (long)d.retired.size();
+    pthread_mutex_unlock(&d.retire_lock);
+
+    string line = "Read-only views: " + to_string(s.published) + " published, " + to_string(s.reclaimed)
+                + " reclaimed, " + to_string(pending) + " awaiting reclamation (peak " + to_string(s.peak_retired)
+                + "), " + to_string(reads) + " lock-free reads by " + to_string(readers) + " readers";
+    if (s.fallback_reads > 0) line += ", " + to_string(s.fallback_reads) + " reads without a slot";
+    cout << (line + "\n");
+}
+
+#endif // EPOCHVIEWS_H
@@ -0,0 +1,422 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <iostream>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "simulation.h"
+#include "workload.h"
+
+using namespace std;
+
+// Arrival feed rows: time_s,intersection,side[,type[,direction[,parking[,park_s]]]]
+// e.g. "12.5,F10,NORTH,Bus,LEFT,0". Rows whose first field is not a number
+// (headers, comments) are skipped.
+const size_t FEED_CHUNK_SIZE = 1 << 20;
+const uint32_t FEED_RING_CAPACITY = 4096;
+const uint32_t FEED_WAKE_BATCH = 256;
+
+struct FeedStats {
+    uint64_t rows;
+    uint64_t skipped;
+    uint64_t bytes;
+};
+
+struct ArrivalFeed {
+    int fd;
+    bool owns_fd;
+    bool mapped;
+    const char* map_data;
+    size_t map_size;
+    char* chunk;
+
+    bool have_origin;
+    int64_t origin_ms;
+    double speed;
+    FeedStats stats;
+
+    // Single-producer/single-consumer ring: the reader thread only advances
+    // ring_tail and the spawner only advances ring_head. The semaphores are
+    // used purely to park a side that found the ring full or empty.
+    ArrivalRecord ring[FEED_RING_CAPACITY];
+    atomic<uint32_t> ring_head;
+    atomic<uint32_t> ring_tail;
+    atomic<bool> producer_waiting;
+    atomic<bool> consumer_waiting;
+    sem_t ring_free;
+    sem_t ring_used;
+    atomic<bool> eof;
+    pthread_t reader_tid;
+};
+
+struct FieldRef {
+    const char* begin;
+    const char* end;
+};
+
+inline bool fieldEquals(const FieldRef& f, const string& value) {
+    return (size_t)(f.end - f.begin) == value.size() && memcmp(f.begin, value.data(), value.size()) == 0;
+}
+
+inline int matchField(const FieldRef& f, const string table[], int count) {
+    for (int i = 0; i < count; i++) {
+        if (fieldEquals(f, table[i])) return i;
+    }
+    return -1;
+}
+
+// Parses "123", "123.4" or "123.456" seconds into milliseconds
+inline bool parseSecondsMs(const FieldRef& f, int64_t& ms) {
+    const char* p = f.begin;
+    if (p == f.end || *p < '0' || *p > '9') return false;
+
+    int64_t whole = 0;
+    while (p < f.end && *p >= '0' && *p <= '9') {
+        whole = whole * 10 + (*p - '0');
+        p++;
+    }
+
+    int64_t frac = 0;
+    int digits = 0;
+    if (p < f.end && *p == '.') {
+        p++;
+        while (p < f.end && *p >= '0' && *p <= '9') {
+            if (digits < 3) {
+                frac = frac * 10 + (*p - '0');
+                digits++;
+            }
+            p++;
+        }
+    }
+    while (digits < 3) {
+        frac *= 10;
+        digits++;
+    }
+
+    ms = whole * 1000 + frac;
+    return p == f.end;
+}
+
+inline bool parseArrivalRow(const char* begin, const char* end, ArrivalFeed& feed, ArrivalRecord& rec) {
+    FieldRef fields[7];
+    int count = 0;
+    const char* start = begin;
+
+    for (const char* p = begin; p <= end && count < 7; p++) {
+        if (p == end || *p == ',') {
+            const char* a = start;
+            const char* b = p;
+            while (a < b && (*a == ' ' || *a == '\t')) a++;
+            while (b > a && (b[-1] == ' ' || b[-1] == '\t' || b[-1] == '\r')) b--;
+            fields[count].begin = a;
+            fields[count].end = b;
+            count++;
+            start = p + 1;
+        }
+    }
+
+    int64_t time_ms;
+    if (count < 3 || !parseSecondsMs(fields[0], time_ms)) return false;
+
+    int intersection = matchField(fields[1], INTERSECTION_IDS, NUM_INTERSECTIONS);
+    int side = matchField(fields[2], SPAWN_SIDES, NUM_SIDES);
+    if (intersection < 0 || side < 0) return false;
+
+    int type = (count > 3) ? matchField(fields[3], VEHICLE_TYPES, NUM_VEHICLE_TYPES) : 0;
+    int direction = (count > 4) ? matchField(fields[4], DIRECTIONS, NUM_DIRECTIONS) : 0;
+    if (type < 0 || direction < 0) return false;
+
+    int64_t park_ms = (PARKING_MIN_TIME + PARKING_MAX_TIME) / 2000;
+    if (count > 6 && !parseSecondsMs(fields[6], park_ms)) return false;
+
+    if (!feed.have_origin) {
+        feed.origin_ms = time_ms;
+        feed.have_origin = true;
+    }
+    int64_t offset = time_ms - feed.origin_ms;
+    if (offset < 0) offset = 0;
+    if (feed.speed > 0) offset = (int64_t)(offset / feed.speed);
+    else offset = 0;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.time_ms = (uint32_t)offset;
+    rec.park_time_ms = (uint32_t)park_ms;
+    rec.type = type;
+    rec.intersection = intersection;
+    rec.side = side;
+    rec.direction = direction;
+    rec.wants_parking = (count > 5 && fields[5].begin < fields[5].end && *fields[5].begin == '1')
+                        && !isEmergencyVehicle(VEHICLE_TYPES[type]);
+    return true;
+}
+
+// Parses every complete line in [data, data + len) and reports the bytes consumed.
+// With at_eof set, a trailing line without a newline is parsed as well.
+// Returns false if the sink asked to stop.
+template <typename Sink>
+inline bool parseArrivalChunk(ArrivalFeed& feed, const char* data, size_t len, bool at_eof,
+                              size_t& consumed, Sink sink) {
+    const char* p = data;
+    const char* end = data + len;
+
+    while (p < end) {
+        const char* nl = (const char*)memchr(p, '\n', end - p);
+        if (nl == NULL) {
+            if (!at_eof) break;
+            nl = end;
+        }
+
+        if (nl > p) {
+            ArrivalRecord rec;
+            if (parseArrivalRow(p, nl, feed, rec)) {
+                feed.stats.rows++;
+                if (!sink(rec)) {
+                    consumed = ((nl < end) ? nl + 1 : end) - data;
+                    return false;
+                }
+            } else {
+                feed.stats.skipped++;
+            }
+        }
+        p = (nl < end) ? nl + 1 : end;
+    }
+
+    consumed = p - data;
+    return true;
+}
+
+// Drives the parser over the whole source; the sink returns false to stop early
+template <typename Sink>
+inline void parseArrivalSource(ArrivalFeed& feed, Sink sink) {
+    size_t used = 0;
+    if (feed.mapped) {
+        feed.stats.bytes = feed.map_size;
+        parseArrivalChunk(feed, feed.map_data, feed.map_size, true, used, sink);
+        return;
+    }
+
+    size_t filled = 0;
+    while (true) {
+        ssize_t n = read(feed.fd, feed.chunk + filled, FEED_CHUNK_SIZE - filled);
+        if (n < 0 && errno == EINTR) continue;
+
+        bool at_eof = (n <= 0);
+        if (n > 0) {
+            filled += n;
+            feed.stats.bytes += n;
+        }
+
+        if (!parseArrivalChunk(feed, feed.chunk, filled, at_eof, used, sink) || at_eof) {
+            return;
+        }
+        if (used == 0 && filled == FEED_CHUNK_SIZE) {
+            feed.stats.skipped++;       // line longer than a whole chunk
+            used = filled;
+        }
+        memmove(feed.chunk, feed.chunk + used, filled - used);
+        filled -= used;
+    }
+}
+
+inline bool openArrivalFeed(ArrivalFeed& feed, const string& path, double speed) {
+    feed.owns_fd = (path != "-");
+    feed.fd = feed.owns_fd ? open(path.c_str(), O_RDONLY) : STDIN_FILENO;
+    if (feed.fd < 0) {
+        perror(("Failed to open arrival feed " + path).c_str());
+        return false;
+    }
+
+    feed.mapped = false;
+    feed.map_data = NULL;
+    feed.map_size = 0;
+    feed.chunk = NULL;
+    feed.have_origin = false;
+    feed.origin_ms = 0;
+    feed.speed = speed;
+    memset(&feed.stats, 0, sizeof(feed.stats));
+    feed.ring_head = 0;
+    feed.ring_tail = 0;
+    feed.eof = false;
+
+    struct stat st;
+    if (fstat(feed.fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, feed.fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            feed.mapped = true;
+            feed.map_data = (const char*)data;
+            feed.map_size = st.st_size;
+        }
+    }
+    if (!feed.mapped) {
+        feed.chunk = new char[FEED_CHUNK_SIZE];
+    }
+
+    feed.producer_waiting = false;
+    feed.consumer_waiting = false;
+    sem_init(&feed.ring_free, 0, 0);
+    sem_init(&feed.ring_used, 0, 0);
+    return true;
+}
+
+inline void closeArrivalFeed(ArrivalFeed& feed) {
+    if (feed.mapped) {
+        munmap((void*)feed.map_data, feed.map_size);
+    }
+    delete[] feed.chunk;
+    feed.chunk = NULL;
+    if (feed.owns_fd && feed.fd >= 0) {
+        close(feed.fd);
+    }
+    feed.fd = -1;
+    sem_destroy(&feed.ring_free);
+    sem_destroy(&feed.ring_used);
+}
+
+inline void wakeArrivalConsumer(ArrivalFeed& feed) {
+    bool expected = true;
+    if (feed.consumer_waiting.compare_exchange_strong(expected, false)) {
+        sem_post(&feed.ring_used);
+    }
+}
+
+// Producer side: blocks while the ring is full, which stalls the reader and,
+// through the pipe or FIFO, whoever is writing the feed
+inline bool pushArrival(ArrivalFeed& feed, const ArrivalRecord& rec) {
+    uint32_t tail = feed.ring_tail.load(memory_order_relaxed);
+
+    while (tail - feed.ring_head.load(memory_order_acquire) == FEED_RING_CAPACITY) {
+        wakeArrivalConsumer(feed);
+        feed.producer_waiting.store(true);
+        if (tail - feed.ring_head.load() == FEED_RING_CAPACITY) {
+            semTimedWaitMs(&feed.ring_free, 100);
+        }
+        feed.producer_waiting.store(false);
+        if (shuttingDown(sim_context)) return false;
+    }
+
+    feed.ring[tail % FEED_RING_CAPACITY] = rec;
+    feed.ring_tail.store(tail + 1, memory_order_release);
+
+    if (tail - feed.ring_head.load(memory_order_relaxed) >= FEED_WAKE_BATCH) {
+        wakeArrivalConsumer(feed);
+    }
+    return true;
+}
+
+inline bool popArrival(ArrivalFeed& feed, ArrivalRecord& rec) {
+    uint32_t head = feed.ring_head.load(memory_order_relaxed);
+
+    while (feed.ring_tail.load(memory_order_acquire) == head) {
+        if (feed.eof.load()) {
+            if (feed.ring_tail.load(memory_order_acquire) != head) break;
+            return false;
+        }
+        if (shuttingDown(sim_context)) return false;
+
+        feed.consumer_waiting.store(true);
+        if (feed.ring_tail.load() == head && !feed.eof.load()) {
+            semTimedWaitMs(&feed.ring_used, 10);
+        }
+        feed.consumer_waiting.store(false);
+    }
+
+    rec = feed.ring[head % FEED_RING_CAPACITY];
+    feed.ring_head.store(head + 1, memory_order_release);
+
+    bool expected = true;
+    if (feed.producer_waiting.load(memory_order_relaxed)
+        && feed.producer_waiting.compare_exchange_strong(expected, false)) {
+        sem_post(&feed.ring_free);
+    }
+    return true;
+}
+
+inline void* feedReaderThread(void* arg) {
+    ArrivalFeed* feed = (ArrivalFeed*)arg;
+
+    parseArrivalSource(*feed, [feed](const ArrivalRecord& rec) {
+        return pushArrival(*feed, rec);
+    });
+
+    feed->eof = true;
+    wakeArrivalConsumer(*feed);
+    return NULL;
+}
+
+inline bool startArrivalFeed(ArrivalFeed& feed) {
+    return pthread_create(&feed.reader_tid, NULL, feedReaderThread, &feed) == 0;
+}
+
+inline double secondsSince(const struct timespec& start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+inline void printIngestBenchmark(const ArrivalFeed& feed, double parse_s, uint64_t handoff_rows, double handoff_s) {
+    cout << ("[BENCH] Ingest: " + to_string(feed.stats.rows) + " rows, " + to_string(feed.stats.skipped)
+         + " skipped, " + to_string(feed.stats.bytes / (1024 * 1024)) + " MiB ("
+         + string(feed.mapped ? "mmap" : "chunked read") + ")\n");
+    cout << ("[BENCH]   parse only:      " + to_string(parse_s * 1000.0) + " ms, "
+         + to_string((uint64_t)(feed.stats.rows / (parse_s > 0 ? parse_s : 1e-9))) + " rows/s\n");
+    if (handoff_s > 0) {
+        cout << ("[BENCH]   parse + handoff: " + to_string(handoff_s * 1000.0) + " ms, "
+             + to_string((uint64_t)(handoff_rows / handoff_s)) + " rows/s\n");
+    }
+}
+
+// Parses the feed once on its own and, for regular files, once more through the
+// reader thread and ring to measure the handoff cost the spawner would see
+inline int runIngestBenchmark(const string& path) {
+    ArrivalFeed* feed = new ArrivalFeed();
+    if (!openArrivalFeed(*feed, path, 0)) {
+        delete feed;
+        return 1;
+    }
+    bool rereadable = feed->mapped;
+
+    uint64_t checksum = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    parseArrivalSource(*feed, [&checksum](const ArrivalRecord& rec) {
+        checksum += rec.time_ms + rec.side;
+        return true;
+    });
+    double parse_s = secondsSince(start);
+    FeedStats parse_stats = feed->stats;
+    closeArrivalFeed(*feed);
+
+    uint64_t handoff_rows = 0;
+    double handoff_s = 0;
+    if (rereadable && openArrivalFeed(*feed, path, 0)) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        startArrivalFeed(*feed);
+        ArrivalRecord rec;
+        while (popArrival(*feed, rec)) {
+            checksum += rec.time_ms;
+            handoff_rows++;
+        }
+        pthread_join(feed->reader_tid, NULL);
+        handoff_s = secondsSince(start);
+        closeArrivalFeed(*feed);
+    }
+
+    feed->stats = parse_stats;
+    printIngestBenchmark(*feed, parse_s, handoff_rows, handoff_s);
+    cout << ("[BENCH]   checksum: " + to_string(checksum) + "\n");
+    delete feed;
+    return 0;
+}
+
+#endif // INGEST_H
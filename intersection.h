@@ -1,101 +1,191 @@
 #ifndef INTERSECTION_H
 #define INTERSECTION_H
 
+// An intersection is a BasicIntersection<N, Layout>: N approaches in a
+// std::array indexed by approach number, and a phase layout that names them
+// and lists which approaches move together in each phase. All lights sit in
+// one array, so switching a whole phase is a single assignment from a table
+// built at compile time. F10 and F11 are the four-way Intersection.
+
 #include <iostream>
 #include <vector>
 #include <string>
+#include <array>
+#include <cstdint>
 #include <semaphore.h>
 #include "vehicle.h"
+#include "log.h"
 
 using namespace std;
 
+const uint8_t LIGHT_RED = 0;
+const uint8_t LIGHT_GREEN = 1;
+const uint8_t LIGHT_YELLOW = 2;
+const int NUM_LIGHT_STATES = 3;
+const string LIGHT_STATE_NAMES[] = {"RED", "GREEN", "YELLOW"};
+
+// Four-way approaches, in SPAWN_SIDES order
+enum Approach {
+    APPROACH_NORTH,
+    APPROACH_SOUTH,
+    APPROACH_EAST,
+    APPROACH_WEST
+};
+
+enum FourWayPhase {
+    PHASE_NORTH_SOUTH,
+    PHASE_EAST_WEST
+};
+
+// A phase layout names each approach and gives, per phase, a bit mask of the
+// approaches that phase releases
+struct FourWayLayout {
+    static constexpr int APPROACHES = 4;
+    static constexpr int PHASES = 2;
+    static constexpr const char* NAMES[APPROACHES] = {"NORTH", "SOUTH", "EAST", "WEST"};
+    static constexpr uint8_t PHASE_MOVEMENTS[PHASES] = {
+        (1 << APPROACH_NORTH) | (1 << APPROACH_SOUTH), (1 << APPROACH_EAST) | (1 << APPROACH_WEST)};
+};
+
+// Through road east-west, side road from the south
+struct TJunctionLayout {
+    static constexpr int APPROACHES = 3;
+    static constexpr int PHASES = 2;
+    static constexpr const char* NAMES[APPROACHES] = {"EAST", "WEST", "SOUTH"};
+    static constexpr uint8_t PHASE_MOVEMENTS[PHASES] = {(1 << 0) | (1 << 1), 1 << 2};
+};
+
+// Crossroads plus a diagonal leg that runs in a phase of its own
+struct FiveLegLayout {
+    static constexpr int APPROACHES = 5;
+    static constexpr int PHASES = 3;
+    static constexpr const char* NAMES[APPROACHES] = {"NORTH", "SOUTH", "EAST", "WEST", "SOUTHWEST"};
+    static constexpr uint8_t PHASE_MOVEMENTS[PHASES] = {(1 << 0) | (1 << 1), (1 << 2) | (1 << 3), 1 << 4};
+};
+
 struct TrafficController {
     string side;
-    string light_state;
     vector<Vehicle> queue;
     
-    TrafficController() : side("NORTH"), light_state("RED") {}
+    TrafficController() : side("NORTH") {}
 };
 
-struct Intersection {
+template <int N, typename Layout>
+struct BasicIntersection {
+    static_assert(Layout::APPROACHES == N, "phase layout describes a different number of approaches");
+
+    typedef array<uint8_t, N> Lights;
+
     string id;
-    TrafficController north_controller;
-    TrafficController south_controller;
-    TrafficController east_controller;
-    TrafficController west_controller;
+    array<TrafficController, N> approaches;
+    Lights lights;                  // LIGHT_* per approach
     sem_t access_semaphore;
     bool emergency_mode;
     string emergency_entry_side;
     string emergency_exit_side;
     
-    Intersection() : id("UNKNOWN"), emergency_mode(false) {
+    BasicIntersection() : id("UNKNOWN"), emergency_mode(false) {
+        lights.fill(LIGHT_RED);
         sem_init(&access_semaphore, 0, 1);
     }
     
-    ~Intersection() {
+    ~BasicIntersection() {
         sem_destroy(&access_semaphore);
     }
 };
 
-inline void initIntersection(Intersection& intersection, string id) {
+typedef BasicIntersection<FourWayLayout::APPROACHES, FourWayLayout> Intersection;
+
+// Each phase with its approaches at `light` and every other approach red
+template <int N, typename Layout>
+constexpr array<array<uint8_t, N>, Layout::PHASES> buildPhaseLights(uint8_t light) {
+    array<array<uint8_t, N>, Layout::PHASES> table{};
+    for (int p = 0; p < Layout::PHASES; p++) {
+        for (int a = 0; a < N; a++) table[p][a] = ((Layout::PHASE_MOVEMENTS[p] >> a) & 1) ? light : LIGHT_RED;
+    }
+    return table;
+}
+
+// Indexed [light][phase]
+template <int N, typename Layout>
+struct PhaseLightTable {
+    typedef array<array<uint8_t, N>, Layout::PHASES> ByPhase;
+    static constexpr array<ByPhase, NUM_LIGHT_STATES> LIGHTS = {{
+        buildPhaseLights<N, Layout>(LIGHT_RED), buildPhaseLights<N, Layout>(LIGHT_GREEN),
+        buildPhaseLights<N, Layout>(LIGHT_YELLOW)}};
+};
+
+template <int N, typename Layout>
+inline void initIntersection(BasicIntersection<N, Layout>& intersection, string id) {
     intersection.id = id;
-    intersection.north_controller.side = "NORTH";
-    intersection.north_controller.light_state = "RED";
-    intersection.south_controller.side = "SOUTH";
-    intersection.south_controller.light_state = "RED";
-    intersection.east_controller.side = "EAST";
-    intersection.east_controller.light_state = "RED";
-    intersection.west_controller.side = "WEST";
-    intersection.west_controller.light_state = "RED";
+    for (int a = 0; a < N; a++) intersection.approaches[a].side = Layout::NAMES[a];
+    intersection.lights.fill(LIGHT_RED);
     intersection.emergency_mode = false;
-    sem_init(&intersection.access_semaphore, 0, 1);
 }
 
-inline TrafficController& getController(Intersection& intersection, string side) {
-    if (side == "NORTH") return intersection.north_controller;
-    if (side == "SOUTH") return intersection.south_controller;
-    if (side == "EAST") return intersection.east_controller;
-    return intersection.west_controller;
+// Approach number for a side name, -1 if the layout has no such approach
+template <typename Layout>
+inline int approachIndex(const string& side) {
+    for (int a = 0; a < Layout::APPROACHES; a++) {
+        if (side == Layout::NAMES[a]) return a;
+    }
+    return -1;
+}
+
+// Vehicles carry their side by name; resolve it once per intersection visited
+inline int approachOf(const string& side) {
+    return approachIndex<FourWayLayout>(side);
+}
+
+template <int N, typename Layout>
+inline TrafficController& getController(BasicIntersection<N, Layout>& intersection, int approach) {
+    return intersection.approaches[approach];
+}
+
+// Unlocked read, for callers that hold the intersection's mutex
+template <int N, typename Layout>
+inline uint8_t approachLight(const BasicIntersection<N, Layout>& intersection, int approach) {
+    return intersection.lights[approach];
 }
 
-inline void setControllerLight(Intersection& intersection, string side, string state) {
+template <int N, typename Layout>
+inline void setControllerLight(BasicIntersection<N, Layout>& intersection, int approach, uint8_t light) {
     sem_wait(&intersection.access_semaphore);
-    
-    if (side == "NORTH") intersection.north_controller.light_state = state;
-    else if (side == "SOUTH") intersection.south_controller.light_state = state;
-    else if (side == "EAST") intersection.east_controller.light_state = state;
-    else if (side == "WEST") intersection.west_controller.light_state = state;
-    
+    intersection.lights[approach] = light;
     sem_post(&intersection.access_semaphore);
 }
 
-inline string getControllerLight(Intersection& intersection, string side) {
+template <int N, typename Layout>
+inline uint8_t getControllerLight(BasicIntersection<N, Layout>& intersection, int approach) {
     sem_wait(&intersection.access_semaphore);
-    string state;
-    
-    if (side == "NORTH") state = intersection.north_controller.light_state;
-    else if (side == "SOUTH") state = intersection.south_controller.light_state;
-    else if (side == "EAST") state = intersection.east_controller.light_state;
-    else state = intersection.west_controller.light_state;
-    
+    uint8_t light = intersection.lights[approach];
     sem_post(&intersection.access_semaphore);
-    return state;
+    return light;
 }
 
-inline bool canVehicleMove(Intersection& intersection, string from_side) {
-    return getControllerLight(intersection, from_side) == "GREEN";
+template <int N, typename Layout>
+inline bool canVehicleMove(BasicIntersection<N, Layout>& intersection, int approach) {
+    return getControllerLight(intersection, approach) == LIGHT_GREEN;
 }
 
-inline void setAllLightsRed(Intersection& intersection) {
+// The whole intersection in one write: the phase's approaches at `light`,
+// everything else red
+template <int N, typename Layout>
+inline void setPhaseLights(BasicIntersection<N, Layout>& intersection, int phase, uint8_t light) {
     sem_wait(&intersection.access_semaphore);
-    intersection.north_controller.light_state = "RED";
-    intersection.south_controller.light_state = "RED";
-    intersection.east_controller.light_state = "RED";
-    intersection.west_controller.light_state = "RED";
+    intersection.lights = PhaseLightTable<N, Layout>::LIGHTS[light][phase];
     sem_post(&intersection.access_semaphore);
 }
 
-inline void setEmergencyMode(Intersection& intersection, bool active, 
+template <int N, typename Layout>
+inline void setAllLightsRed(BasicIntersection<N, Layout>& intersection) {
+    sem_wait(&intersection.access_semaphore);
+    intersection.lights.fill(LIGHT_RED);
+    sem_post(&intersection.access_semaphore);
+}
+
+template <int N, typename Layout>
+inline void setEmergencyMode(BasicIntersection<N, Layout>& intersection, bool active,
                               string entry_side = "", string exit_side = "") {
     sem_wait(&intersection.access_semaphore);
     intersection.emergency_mode = active;
@@ -104,7 +194,8 @@ inline void setEmergencyMode(Intersection& intersection, bool active,
     sem_post(&intersection.access_semaphore);
 }
 
-inline bool isEmergencyMode(Intersection& intersection) {
+template <int N, typename Layout>
+inline bool isEmergencyMode(BasicIntersection<N, Layout>& intersection) {
     sem_wait(&intersection.access_semaphore);
     bool mode = intersection.emergency_mode;
     sem_post(&intersection.access_semaphore);
@@ -112,52 +203,52 @@ inline bool isEmergencyMode(Intersection& intersection) {
 }
 
 inline void activateEastboundEmergencyCorridor(Intersection& f10, Intersection& f11) {
-    cout << ("========================================\n");
-    cout << ("[EMERGENCY] EASTBOUND CORRIDOR ACTIVATED\n");
-    cout << ("[EMERGENCY] Path: F10_WEST -> F10_EAST -> F11_WEST -> F11_EAST\n");
-    cout << ("========================================\n");
-    
-    setAllLightsRed(f10);
-    setAllLightsRed(f11);
+    if (logEnabled(LOG_LEVEL_INFO)) {
+        cout << ("========================================\n");
+        cout << ("[EMERGENCY] EASTBOUND CORRIDOR ACTIVATED\n");
+        cout << ("[EMERGENCY] Path: F10_WEST -> F10_EAST -> F11_WEST -> F11_EAST\n");
+        cout << ("========================================\n");
+    }
     
-    setControllerLight(f10, "WEST", "GREEN");
-    setControllerLight(f10, "EAST", "GREEN");
+    setPhaseLights(f10, PHASE_EAST_WEST, LIGHT_GREEN);
     setEmergencyMode(f10, true, "WEST", "EAST");
     
-    setControllerLight(f11, "WEST", "GREEN");
-    setControllerLight(f11, "EAST", "GREEN");
+    setPhaseLights(f11, PHASE_EAST_WEST, LIGHT_GREEN);
     setEmergencyMode(f11, true, "WEST", "EAST");
     
-    cout << ("[EMERGENCY] F10: WEST=GREEN, EAST=GREEN, others=RED\n");
-    cout << ("[EMERGENCY] F11: WEST=GREEN, EAST=GREEN, others=RED\n");
+    if (logEnabled(LOG_LEVEL_INFO)) {
+        cout << ("[EMERGENCY] F10: WEST=GREEN, EAST=GREEN, others=RED\n");
+        cout << ("[EMERGENCY] F11: WEST=GREEN, EAST=GREEN, others=RED\n");
+    }
 }
 
 inline void activateWestboundEmergencyCorridor(Intersection& f10, Intersection& f11) {
-    cout << ("========================================\n");
-    cout << ("[EMERGENCY] WESTBOUND CORRIDOR ACTIVATED\n");
-    cout << ("[EMERGENCY] Path: F11_EAST -> F11_WEST -> F10_EAST -> F10_WEST\n");
-    cout << ("========================================\n");
-    
-    setAllLightsRed(f10);
-    setAllLightsRed(f11);
+    if (logEnabled(LOG_LEVEL_INFO)) {
+        cout << ("========================================\n");
+        cout << ("[EMERGENCY] WESTBOUND CORRIDOR ACTIVATED\n");
+        cout << ("[EMERGENCY] Path: F11_EAST -> F11_WEST -> F10_EAST -> F10_WEST\n");
+        cout << ("========================================\n");
+    }
     
-    setControllerLight(f11, "EAST", "GREEN");
-    setControllerLight(f11, "WEST", "GREEN");
+    setPhaseLights(f11, PHASE_EAST_WEST, LIGHT_GREEN);
     setEmergencyMode(f11, true, "EAST", "WEST");
     
-    setControllerLight(f10, "EAST", "GREEN");
-    setControllerLight(f10, "WEST", "GREEN");
+    setPhaseLights(f10, PHASE_EAST_WEST, LIGHT_GREEN);
     setEmergencyMode(f10, true, "EAST", "WEST");
     
-    cout << ("[EMERGENCY] F11: EAST=GREEN, WEST=GREEN, others=RED\n");
-    cout << ("[EMERGENCY] F10: EAST=GREEN, WEST=GREEN, others=RED\n");
+    if (logEnabled(LOG_LEVEL_INFO)) {
+        cout << ("[EMERGENCY] F11: EAST=GREEN, WEST=GREEN, others=RED\n");
+        cout << ("[EMERGENCY] F10: EAST=GREEN, WEST=GREEN, others=RED\n");
+    }
 }
 
 inline void deactivateEmergencyCorridor(Intersection& f10, Intersection& f11) {
-    cout << ("========================================\n");
-    cout << ("[EMERGENCY] CORRIDOR DEACTIVATED\n");
-    cout << ("[EMERGENCY] Resuming normal traffic operations\n");
-    cout << ("========================================\n");
+    if (logEnabled(LOG_LEVEL_INFO)) {
+        cout << ("========================================\n");
+        cout << ("[EMERGENCY] CORRIDOR DEACTIVATED\n");
+        cout << ("[EMERGENCY] Resuming normal traffic operations\n");
+        cout << ("========================================\n");
+    }
     
     setEmergencyMode(f10, false);
     setEmergencyMode(f11, false);
@@ -171,28 +262,6 @@ inline void deactivateEmergencyMode(Intersection& intersection) {
     cout << ("[EMERGENCY] " + intersection.id + ": Emergency mode deactivated, resuming normal operation\n");
 }
 
-inline void printIntersection(Intersection& intersection) {
-    sem_wait(&intersection.access_semaphore);
-    
-    cout << ("========================================\n");
-    cout << ("INTERSECTION: " + intersection.id + "\n");
-    cout << ("========================================\n");
-    cout << ("Emergency Mode: " + string(intersection.emergency_mode ? "ACTIVE" : "INACTIVE") + "\n");
-    cout << ("----------------------------------------\n");
-    cout << ("Traffic Controllers:\n");
-    cout << ("  NORTH: [" + intersection.north_controller.light_state + "] - " 
-         + to_string(intersection.north_controller.queue.size()) + " vehicles waiting\n");
-    cout << ("  SOUTH: [" + intersection.south_controller.light_state + "] - "
-         + to_string(intersection.south_controller.queue.size()) + " vehicles waiting\n");
-    cout << ("  EAST:  [" + intersection.east_controller.light_state + "] - "
-         + to_string(intersection.east_controller.queue.size()) + " vehicles waiting\n");
-    cout << ("  WEST:  [" + intersection.west_controller.light_state + "] - "
-         + to_string(intersection.west_controller.queue.size()) + " vehicles waiting\n");
-    cout << ("========================================\n");
-    
-    sem_post(&intersection.access_semaphore);
-}
-
 inline void printLightChange(string intersection_id, string side, string new_state) {
     cout << ("[SIGNAL] " + intersection_id + "_" + side + ": " + new_state + "\n");
 }
@@ -0,0 +1,317 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+// Time-stepped microscopic engine. Vehicles on each lane of each approach are
+// stored as structure-of-arrays, ordered from the stop line backwards, so the
+// follower of index i is i + 1 and one Intelligent Driver Model pass over the
+// arrays updates a whole lane in a loop the compiler can vectorize
+// (build with -O3 -march=native to get wide SIMD).
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <pthread.h>
+#include <time.h>
+#include "simulation.h"
+#include "perfcounters.h"
+
+using namespace std;
+
+// Model parameters (SI units)
+const float KIN_DT = 0.1f;
+const float KIN_DESIRED_SPEED = 13.9f;      // 50 km/h
+const float KIN_MAX_ACCEL = 1.5f;
+const float KIN_COMFORT_DECEL = 2.0f;
+const float KIN_MAX_DECEL = 8.0f;
+const float KIN_MIN_GAP = 2.0f;
+const float KIN_HEADWAY = 1.2f;
+const float KIN_APPROACH_LENGTH = 200.0f;   // entry to stop line
+const float KIN_BOX_LENGTH = 20.0f;         // stop line to exit of the box
+const float KIN_FREE_ROAD = 1.0e6f;
+const int KIN_LANES_PER_APPROACH = 2;       // lane 0: left turns, lane 1: straight/right
+
+const float VEHICLE_LENGTHS[] = {4.5f, 2.0f, 12.0f, 6.0f, 6.5f, 9.0f};   // by VEHICLE_TYPES index
+
+// pos, speed, accel, length, obeys_signal, id and direction
+const size_t KINEMATIC_BYTES_PER_VEHICLE = 5 * sizeof(float) + sizeof(uint32_t) + sizeof(uint8_t);
+
+struct KinematicExit {
+    uint32_t id;
+    uint8_t direction;
+};
+
+struct KinematicLane {
+    int intersection;
+    int approach;       // index into SPAWN_SIDES
+    int lane;
+
+    // Per-vehicle state; entries before `head` have already left the lane
+    vector<float> pos;
+    vector<float> speed;
+    vector<float> accel;
+    vector<float> length;
+    vector<uint32_t> id;
+    vector<uint8_t> direction;
+    vector<float> obeys_signal;     // 1 = stops on red, 0 = emergency free pass
+    size_t head;
+
+    bool green;
+    vector<KinematicExit> exits;
+};
+
+struct KinematicEngine {
+    vector<KinematicLane> lanes;
+    int threads;
+    vector<pthread_t> workers;
+    pthread_barrier_t tick_start;
+    pthread_barrier_t tick_done;
+    bool stopping;
+    long long ticks;
+};
+
+inline int laneBlockIndex(int intersection, int approach, int lane) {
+    return (intersection * NUM_SIDES + approach) * KIN_LANES_PER_APPROACH + lane;
+}
+
+inline int laneForDirection(const string& direction) {
+    return (direction == "LEFT") ? 0 : 1;
+}
+
+inline size_t activeVehicles(const KinematicLane& lane) {
+    return lane.pos.size() - lane.head;
+}
+
+// A new vehicle enters at position 0 only if the last one has moved clear
+inline bool laneHasEntrySpace(const KinematicLane& lane) {
+    if (activeVehicles(lane) == 0) return true;
+    return lane.pos.back() - lane.length.back() >= KIN_MIN_GAP;
+}
+
+inline void addLaneVehicle(KinematicLane& lane, uint32_t id, float vehicle_length, float speed,
+                           uint8_t direction, bool ignores_signal) {
+    // Never enter faster than the vehicle it joins behind
+    if (activeVehicles(lane) > 0 && speed > lane.speed.back()) {
+        speed = lane.speed.back();
+    }
+    lane.pos.push_back(0.0f);
+    lane.speed.push_back(speed);
+    lane.accel.push_back(0.0f);
+    lane.length.push_back(vehicle_length);
+    lane.id.push_back(id);
+    lane.direction.push_back(direction);
+    lane.obeys_signal.push_back(ignores_signal ? 0.0f : 1.0f);
+}
+
+inline void compactLane(KinematicLane& lane) {
+    if (lane.head < 1024 || lane.head * 2 < lane.pos.size()) return;
+    lane.pos.erase(lane.pos.begin(), lane.pos.begin() + lane.head);
+    lane.speed.erase(lane.speed.begin(), lane.speed.begin() + lane.head);
+    lane.accel.erase(lane.accel.begin(), lane.accel.begin() + lane.head);
+    lane.length.erase(lane.length.begin(), lane.length.begin() + lane.head);
+    lane.id.erase(lane.id.begin(), lane.id.begin() + lane.head);
+    lane.direction.erase(lane.direction.begin(), lane.direction.begin() + lane.head);
+    lane.obeys_signal.erase(lane.obeys_signal.begin(), lane.obeys_signal.begin() + lane.head);
+    lane.head = 0;
+}
+
+// Plain compare-select rather than fmaxf: fmaxf's NaN rules keep the
+// vectorizer off unless -ffast-math is given
+inline float maxSelect(float a, float b) {
+    return (a > b) ? a : b;
+}
+
+// Branch-free so the per-lane loop vectorizes: every condition is a select
+// and the flags are combined with & rather than short-circuit &&
+inline float idmAcceleration(float x, float v, float leader_gap, float leader_dv, float red, float obeys) {
+    const float inv_v0 = 1.0f / KIN_DESIRED_SPEED;
+    const float inv_2sqrt_ab = 1.0f / (2.0f * sqrtf(KIN_MAX_ACCEL * KIN_COMFORT_DECEL));
+    const float inv_2b = 1.0f / (2.0f * KIN_COMFORT_DECEL);
+
+    float to_stop = KIN_APPROACH_LENGTH - x;
+    bool must_stop = (red * obeys > 0.0f) & (to_stop > 0.0f) & (v * v * inv_2b <= to_stop);
+    float stop_gap = must_stop ? to_stop : KIN_FREE_ROAD;
+
+    bool stop_closer = stop_gap < leader_gap;
+    float gap = maxSelect(stop_closer ? stop_gap : leader_gap, 0.1f);
+    float dv = stop_closer ? v : leader_dv;
+
+    float s_star = KIN_MIN_GAP + maxSelect(v * KIN_HEADWAY + v * dv * inv_2sqrt_ab, 0.0f);
+    float r = v * inv_v0;
+    float r2 = r * r;
+    float q = s_star / gap;
+    return maxSelect(KIN_MAX_ACCEL * (1.0f - r2 * r2 - q * q), -KIN_MAX_DECEL);
+}
+
+// One IDM tick for every vehicle on the lane. The stop line acts as a
+// stationary leader when the light is not green and the vehicle can still
+// stop comfortably; otherwise each vehicle follows the one ahead of it.
+inline void stepLane(KinematicLane& lane, float dt) {
+    lane.exits.clear();
+    size_t n = activeVehicles(lane);
+    if (n == 0) return;
+
+    float* __restrict x = lane.pos.data() + lane.head;
+    float* __restrict v = lane.speed.data() + lane.head;
+    float* __restrict a = lane.accel.data() + lane.head;
+    const float* __restrict len = lane.length.data() + lane.head;
+    const float* __restrict obeys = lane.obeys_signal.data() + lane.head;
+
+    const float red = lane.green ? 0.0f : 1.0f;
+
+    // The first vehicle has free road ahead; every other one follows index i - 1
+    a[0] = idmAcceleration(x[0], v[0], KIN_FREE_ROAD, 0.0f, red, obeys[0]);
+    for (size_t i = 1; i < n; i++) {
+        a[i] = idmAcceleration(x[i], v[i], x[i - 1] - len[i - 1] - x[i], v[i] - v[i - 1], red, obeys[i]);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        float vn = maxSelect(v[i] + a[i] * dt, 0.0f);
+        x[i] += 0.5f * (v[i] + vn) * dt;
+        v[i] = vn;
+    }
+
+    const float exit_pos = KIN_APPROACH_LENGTH + KIN_BOX_LENGTH;
+    while (lane.head < lane.pos.size() && lane.pos[lane.head] > exit_pos) {
+        KinematicExit e = {lane.id[lane.head], lane.direction[lane.head]};
+        lane.exits.push_back(e);
+        lane.head++;
+    }
+    compactLane(lane);
+}
+
+inline void initKinematicEngine(KinematicEngine& engine, int intersections, int threads) {
+    engine.lanes.clear();
+    for (int i = 0; i < intersections; i++) {
+        for (int approach = 0; approach < NUM_SIDES; approach++) {
+            for (int l = 0; l < KIN_LANES_PER_APPROACH; l++) {
+                KinematicLane lane;
+                lane.intersection = i;
+                lane.approach = approach;
+                lane.lane = l;
+                lane.head = 0;
+                lane.green = false;
+                engine.lanes.push_back(lane);
+            }
+        }
+    }
+    engine.threads = threads;
+    engine.stopping = false;
+    engine.ticks = 0;
+}
+
+struct KinematicWorkerArg {
+    KinematicEngine* engine;
+    int index;
+};
+
+// Worker t owns whole approaches t, t + threads, ... so every lane it steps,
+// and that lane's exit list, is touched by one thread only
+inline void stepOwnedApproaches(KinematicEngine& engine, int index) {
+    PerfRegion perf(PERF_MICRO_STEP);
+    int approaches = (int)engine.lanes.size() / KIN_LANES_PER_APPROACH;
+    for (int ap = index; ap < approaches; ap += engine.threads) {
+        for (int l = 0; l < KIN_LANES_PER_APPROACH; l++) {
+            stepLane(engine.lanes[ap * KIN_LANES_PER_APPROACH + l], KIN_DT);
+        }
+    }
+}
+
+inline void* kinematicWorkerThread(void* arg) {
+    KinematicWorkerArg* w = (KinematicWorkerArg*)arg;
+    KinematicEngine& engine = *w->engine;
+    perfSetThreadRole(PERF_ROLE_MICRO);
+
+    while (true) {
+        pthread_barrier_wait(&engine.tick_start);
+        if (engine.stopping) break;
+        stepOwnedApproaches(engine, w->index);
+        pthread_barrier_wait(&engine.tick_done);
+    }
+    delete w;
+    return NULL;
+}
+
+inline void startKinematicWorkers(KinematicEngine& engine) {
+    pthread_barrier_init(&engine.tick_start, NULL, engine.threads);
+    pthread_barrier_init(&engine.tick_done, NULL, engine.threads);
+    for (int i = 1; i < engine.threads; i++) {
+        KinematicWorkerArg* w = new KinematicWorkerArg();
+        w->engine = &engine;
+        w->index = i;
+        pthread_t tid;
+        pthread_create(&tid, NULL, kinematicWorkerThread, w);
+        engine.workers.push_back(tid);
+    }
+}
+
+// Advances every lane by one tick; the calling thread acts as worker 0
+inline void stepKinematicEngine(KinematicEngine& engine) {
+    if (engine.threads > 1) pthread_barrier_wait(&engine.tick_start);
+    stepOwnedApproaches(engine, 0);
+    if (engine.threads > 1) pthread_barrier_wait(&engine.tick_done);
+    engine.ticks++;
+}
+
+inline void stopKinematicWorkers(KinematicEngine& engine) {
+    if (engine.threads > 1) {
+        engine.stopping = true;
+        pthread_barrier_wait(&engine.tick_start);
+        for (size_t i = 0; i < engine.workers.size(); i++) {
+            pthread_join(engine.workers[i], NULL);
+        }
+    }
+    engine.workers.clear();
+    pthread_barrier_destroy(&engine.tick_start);
+    pthread_barrier_destroy(&engine.tick_done);
+}
+
+// --bench kinematics: fills two intersections' lanes with `vehicles` queued
+// vehicles and times ticks at 1..threads worker counts
+inline int runKinematicsBenchmark(int vehicles, int max_threads) {
+    const int ticks = 50;
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        KinematicEngine* engine = new KinematicEngine();
+        initKinematicEngine(*engine, 2, threads);
+
+        int lanes = (int)engine->lanes.size();
+        for (int l = 0; l < lanes; l++) {
+            KinematicLane& lane = engine->lanes[l];
+            int count = vehicles / lanes + (l < vehicles % lanes ? 1 : 0);
+            lane.green = (lane.approach % 2 == 0);
+            for (int k = 0; k < count; k++) {
+                lane.pos.push_back(KIN_APPROACH_LENGTH - k * 7.0f);
+                lane.speed.push_back(KIN_DESIRED_SPEED * 0.5f);
+                lane.accel.push_back(0.0f);
+                lane.length.push_back(VEHICLE_LENGTHS[k % 6]);
+                lane.id.push_back(k);
+                lane.direction.push_back(lane.lane == 0 ? 1 : 0);
+                lane.obeys_signal.push_back(1.0f);
+            }
+        }
+
+        startKinematicWorkers(*engine);
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int t = 0; t < ticks; t++) {
+            stepKinematicEngine(*engine);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        stopKinematicWorkers(*engine);
+
+        double ms = ((end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6) / ticks;
+        long exited = 0;
+        for (int l = 0; l < lanes; l++) exited += engine->lanes[l].head;
+
+        cout << ("[BENCH] Kinematics: " + to_string(vehicles) + " vehicles, " + to_string(lanes)
+             + " lanes, " + to_string(threads) + " thread(s): " + to_string(ms) + " ms/tick, "
+             + to_string((long long)(vehicles / (ms / 1e3))) + " vehicle-updates/s ("
+             + to_string(exited) + " exited during run)\n");
+        delete engine;
+    }
+    return 0;
+}
+
+#endif // KINEMATICS_H
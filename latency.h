@@ -0,0 +1,139 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// Log2-bucketed latency histogram: bucket b counts samples in [2^b, 2^(b+1))
+// ns, so recording is a few instructions and the whole thing is a fixed-size
+// struct. Percentiles are reported as the upper edge of their bucket.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "simulation.h"
+
+using namespace std;
+
+const int LATENCY_BUCKETS = 40;     // up to ~18 minutes
+const int DRIFT_WINDOW_S = 60;
+const int DRIFT_WINDOWS_SHOWN = 12;
+
+struct LatencyHistogram {
+    long count;
+    long long total_ns;
+    long long max_ns;
+    long buckets[LATENCY_BUCKETS];
+};
+
+inline void resetLatencyHistogram(LatencyHistogram& h) {
+    h.count = 0;
+    h.total_ns = 0;
+    h.max_ns = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) h.buckets[b] = 0;
+}
+
+inline void recordLatency(LatencyHistogram& h, long long ns) {
+    if (ns < 0) ns = 0;
+    int bucket = (ns > 0) ? 63 - __builtin_clzll((unsigned long long)ns) : 0;
+    if (bucket >= LATENCY_BUCKETS) bucket = LATENCY_BUCKETS - 1;
+    h.buckets[bucket]++;
+    h.count++;
+    h.total_ns += ns;
+    if (ns > h.max_ns) h.max_ns = ns;
+}
+
+inline void mergeLatencyHistogram(LatencyHistogram& into, const LatencyHistogram& from) {
+    into.count += from.count;
+    into.total_ns += from.total_ns;
+    if (from.max_ns > into.max_ns) into.max_ns = from.max_ns;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) into.buckets[b] += from.buckets[b];
+}
+
+inline long long latencyPercentileNs(const LatencyHistogram& h, double fraction) {
+    if (h.count == 0) return 0;
+    long target = (long)(fraction * h.count + 0.5);
+    if (target < 1) target = 1;
+    long seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += h.buckets[b];
+        if (seen >= target) {
+            long long upper = (2LL << b) - 1;
+            return (upper < h.max_ns) ? upper : h.max_ns;
+        }
+    }
+    return h.max_ns;
+}
+
+inline string formatLatencyUs(long long ns) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f", ns / 1000.0);
+    return text;
+}
+
+inline void printLatencySummary(const string& label, const LatencyHistogram& h) {
+    if (h.count == 0) {
+        cout << ("  " + label + ": no samples\n");
+        return;
+    }
+    cout << ("  " + label + ": " + to_string(h.count) + " samples, mean " + formatLatencyUs(h.total_ns / h.count)
+             + " us, p50 <= " + formatLatencyUs(latencyPercentileNs(h, 0.50)) + " us, p99 <= "
+             + formatLatencyUs(latencyPercentileNs(h, 0.99)) + " us, max " + formatLatencyUs(h.max_ns) + " us\n");
+}
+
+inline void printLatencyBuckets(const LatencyHistogram& h) {
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        if (h.buckets[b] == 0) continue;
+        char line[96];
+        snprintf(line, sizeof(line), "    %10s - %10s us  %ld\n", formatLatencyUs(1LL << b).c_str(),
+                 formatLatencyUs(2LL << b).c_str(), h.buckets[b]);
+        cout << line;
+    }
+}
+
+// Mean of the samples in each DRIFT_WINDOW_S of run time, so a long run
+// shows whether an error stays flat or creeps upward
+struct DriftTrack {
+    long long window_start_ns;
+    long long window_total_ns;
+    long window_count;
+    vector<double> window_means_us;
+};
+
+inline void resetDriftTrack(DriftTrack& d, long long start_ns) {
+    d.window_start_ns = start_ns;
+    d.window_total_ns = 0;
+    d.window_count = 0;
+    d.window_means_us.clear();
+}
+
+inline void closeDriftWindow(DriftTrack& d) {
+    if (d.window_count > 0) d.window_means_us.push_back(d.window_total_ns / 1000.0 / d.window_count);
+    d.window_total_ns = 0;
+    d.window_count = 0;
+}
+
+inline void recordDrift(DriftTrack& d, long long at_ns, long long error_ns) {
+    while (at_ns - d.window_start_ns >= DRIFT_WINDOW_S * 1000000000LL) {
+        closeDriftWindow(d);
+        d.window_start_ns += DRIFT_WINDOW_S * 1000000000LL;
+    }
+    d.window_total_ns += error_ns;
+    d.window_count++;
+}
+
+inline void printDriftTrack(DriftTrack& d) {
+    closeDriftWindow(d);
+    const vector<double>& means = d.window_means_us;
+    if (means.empty()) return;
+
+    size_t first = (means.size() > (size_t)DRIFT_WINDOWS_SHOWN) ? means.size() - DRIFT_WINDOWS_SHOWN : 0;
+    string line = "    Mean per " + to_string(DRIFT_WINDOW_S) + " s window (us):";
+    if (first > 0) line += " ...";
+    for (size_t w = first; w < means.size(); w++) {
+        char mean[32];
+        snprintf(mean, sizeof(mean), " %.1f", means[w]);
+        line += mean;
+    }
+    cout << (line + "  (" + to_string(means.size()) + " windows)\n");
+}
+
+#endif // LATENCY_H
@@ -0,0 +1,146 @@
+#ifndef LIFECYCLE_H
+#define LIFECYCLE_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include "simulation.h"
+
+using namespace std;
+
+const int COMPLETION_TIMEOUT_MS = 60000;
+
+// Counts vehicles still on the road. The spawner arms one count per vehicle
+// and seals the latch once it stops spawning; every vehicle counts down when
+// it completes or aborts, so the waiter wakes on the last one.
+struct CompletionLatch {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    long outstanding;
+    long completed;
+    long aborted;
+    bool sealed;
+    bool cancelled;
+};
+
+inline void initCompletionLatch(CompletionLatch& latch) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&latch.lock, NULL);
+    pthread_cond_init(&latch.done, &attr);
+    pthread_condattr_destroy(&attr);
+    latch.outstanding = 0;
+    latch.completed = 0;
+    latch.aborted = 0;
+    latch.sealed = false;
+    latch.cancelled = false;
+}
+
+inline void destroyCompletionLatch(CompletionLatch& latch) {
+    pthread_cond_destroy(&latch.done);
+    pthread_mutex_destroy(&latch.lock);
+}
+
+inline void armLatch(CompletionLatch& latch) {
+    pthread_mutex_lock(&latch.lock);
+    latch.outstanding++;
+    pthread_mutex_unlock(&latch.lock);
+}
+
+// For an armed vehicle that never started
+inline void disarmLatch(CompletionLatch& latch) {
+    pthread_mutex_lock(&latch.lock);
+    latch.outstanding--;
+    if (latch.sealed && latch.outstanding == 0) pthread_cond_broadcast(&latch.done);
+    pthread_mutex_unlock(&latch.lock);
+}
+
+inline void countDownLatch(CompletionLatch& latch, bool completed) {
+    pthread_mutex_lock(&latch.lock);
+    latch.outstanding--;
+    if (completed) latch.completed++;
+    else latch.aborted++;
+    if (latch.sealed && latch.outstanding == 0) pthread_cond_broadcast(&latch.done);
+    pthread_mutex_unlock(&latch.lock);
+}
+
+inline void sealLatch(CompletionLatch& latch) {
+    pthread_mutex_lock(&latch.lock);
+    latch.sealed = true;
+    if (latch.outstanding == 0) pthread_cond_broadcast(&latch.done);
+    pthread_mutex_unlock(&latch.lock);
+}
+
+// Wakes the waiter early, e.g. on a shutdown signal
+inline void cancelLatch(CompletionLatch& latch) {
+    pthread_mutex_lock(&latch.lock);
+    latch.cancelled = true;
+    pthread_cond_broadcast(&latch.done);
+    pthread_mutex_unlock(&latch.lock);
+}
+
+inline void addUsToTimespec(struct timespec& ts, long long usec) {
+    ts.tv_sec += usec / 1000000;
+    ts.tv_nsec += (long)(usec % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+}
+
+// True once the latch is sealed and every armed vehicle has counted down
+inline bool waitForLatch(CompletionLatch& latch, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    addUsToTimespec(deadline, (long long)timeout_ms * 1000);
+
+    pthread_mutex_lock(&latch.lock);
+    while (!(latch.sealed && latch.outstanding == 0) && !latch.cancelled) {
+        if (pthread_cond_timedwait(&latch.done, &latch.lock, &deadline) != 0) break;
+    }
+    bool finished = latch.sealed && latch.outstanding == 0;
+    pthread_mutex_unlock(&latch.lock);
+    return finished;
+}
+
+// SIGINT/SIGTERM are blocked in every thread and read from a signalfd
+// instead of being handled asynchronously
+inline void shutdownSignalSet(sigset_t& set) {
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+}
+
+inline int openShutdownSignalFd() {
+    sigset_t set;
+    shutdownSignalSet(set);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) return -1;
+    return signalfd(-1, &set, SFD_CLOEXEC);
+}
+
+// sent_ns is the sender's CLOCK_MONOTONIC stamp from sendShutdownSignal, 0
+// for a plain kill() or a terminal ^C
+inline bool readShutdownSignal(int signal_fd, int& signum, long long& sent_ns) {
+    struct signalfd_siginfo info;
+    if (read(signal_fd, &info, sizeof(info)) != (ssize_t)sizeof(info)) return false;
+    signum = (int)info.ssi_signo;
+    sent_ns = (info.ssi_code == SI_QUEUE) ? (long long)info.ssi_ptr : 0;
+    return true;
+}
+
+inline bool readShutdownSignal(int signal_fd, int& signum) {
+    long long sent_ns;
+    return readShutdownSignal(signal_fd, signum, sent_ns);
+}
+
+// SIGTERM carrying its send time, so the receiver can measure its reaction
+inline int sendShutdownSignal(pid_t pid) {
+    union sigval stamp;
+    stamp.sival_ptr = (void*)(intptr_t)monotonicNowNs();
+    return sigqueue(pid, SIGTERM, stamp);
+}
+
+#endif // LIFECYCLE_H
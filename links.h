@@ -0,0 +1,262 @@
+#ifndef LINKS_H
+#define LINKS_H
+
+// Road links between intersections. A link is a bounded single-producer/
+// single-consumer ring of vehicles tagged with the earliest time they can
+// reach the downstream stop line. Upstream discharge blocks while the ring is
+// full (spillback); the downstream side pops without taking any lock.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include "simulation.h"
+#include "vehicle.h"
+#include "coroengine.h"
+
+using namespace std;
+
+const int LINK_RETRY_US = 20000;
+
+// Called by the consumer when the vehicle reaches the downstream intersection
+typedef void (*LinkReleaseFn)(void* ctx);
+
+struct LinkSlot {
+    Vehicle* vehicle;
+    long long arrive_ns;        // stamped on entry: entry time + link travel time
+    LinkReleaseFn release;
+    void* release_ctx;
+};
+
+struct LinkStats {
+    long entered;
+    long exited;
+    uint32_t peak_occupancy;
+    long long occupancy_sum;    // occupancy seen by each entering vehicle
+    long blocked;
+    long long blocked_ns;
+    long long max_blocked_ns;
+};
+
+struct InterLink {
+    int from;
+    int to;
+    long long travel_ns;
+    vector<LinkSlot> ring;
+    uint32_t capacity;
+    atomic<uint32_t> head;
+    atomic<uint32_t> tail;
+    atomic<bool> producer_waiting;
+    atomic<bool> consumer_waiting;
+    sem_t space;
+    sem_t items;
+
+    // Vehicles from several approaches merge onto the link one at a time;
+    // this is what keeps the ring single-producer
+    pthread_mutex_t producer_lock;
+
+    atomic<bool> stopping;
+    pthread_t drain_tid;
+    LinkStats stats;
+};
+
+inline void initInterLink(InterLink& link, int from, int to, int capacity, int travel_us) {
+    link.from = from;
+    link.to = to;
+    link.travel_ns = (long long)travel_us * 1000;
+    link.capacity = (uint32_t)capacity;
+    link.ring.assign(capacity, LinkSlot());
+    link.head = 0;
+    link.tail = 0;
+    link.producer_waiting = false;
+    link.consumer_waiting = false;
+    sem_init(&link.space, 0, 0);
+    sem_init(&link.items, 0, 0);
+    pthread_mutex_init(&link.producer_lock, NULL);
+    link.stopping = false;
+    link.stats = LinkStats();
+}
+
+inline void destroyInterLink(InterLink& link) {
+    pthread_mutex_destroy(&link.producer_lock);
+    sem_destroy(&link.items);
+    sem_destroy(&link.space);
+}
+
+inline string linkName(const InterLink& link) {
+    return INTERSECTION_IDS[link.from] + "->" + INTERSECTION_IDS[link.to];
+}
+
+inline uint32_t linkOccupancy(const InterLink& link) {
+    return link.tail.load(memory_order_acquire) - link.head.load(memory_order_acquire);
+}
+
+inline void wakeLinkConsumer(InterLink& link) {
+    bool expected = true;
+    if (link.consumer_waiting.compare_exchange_strong(expected, false)) {
+        sem_post(&link.items);
+    }
+}
+
+// Producer side, caller holds producer_lock. blocked_since_ns carries the
+// start of a blocked spell across retries so its length lands in the stats.
+inline bool pushLinkLocked(InterLink& link, const LinkSlot& slot, long long& blocked_since_ns) {
+    uint32_t tail = link.tail.load(memory_order_relaxed);
+    uint32_t occupancy = tail - link.head.load(memory_order_acquire);
+    long long now = monotonicNowNs();
+    if (occupancy == link.capacity) {
+        if (blocked_since_ns == 0) blocked_since_ns = now;
+        return false;
+    }
+
+    LinkSlot& entry = link.ring[tail % link.capacity];
+    entry = slot;
+    entry.arrive_ns = now + link.travel_ns;
+    link.tail.store(tail + 1, memory_order_release);
+
+    link.stats.entered++;
+    link.stats.occupancy_sum += occupancy;
+    if (occupancy + 1 > link.stats.peak_occupancy) link.stats.peak_occupancy = occupancy + 1;
+    if (blocked_since_ns != 0) {
+        long long waited = now - blocked_since_ns;
+        link.stats.blocked++;
+        link.stats.blocked_ns += waited;
+        if (waited > link.stats.max_blocked_ns) link.stats.max_blocked_ns = waited;
+        blocked_since_ns = 0;
+    }
+
+    wakeLinkConsumer(link);
+    return true;
+}
+
+// Non-blocking entry for callers that must not park their thread
+inline bool tryEnterLink(InterLink& link, const LinkSlot& slot, long long& blocked_since_ns) {
+    pthread_mutex_lock(&link.producer_lock);
+    bool entered = pushLinkLocked(link, slot, blocked_since_ns);
+    pthread_mutex_unlock(&link.producer_lock);
+    return entered;
+}
+
+// Blocks the discharging vehicle while the link is full; false on shutdown.
+// The lock is not held while waiting, so every blocked vehicle is counted.
+inline bool enterLink(InterLink& link, const LinkSlot& slot) {
+    long long blocked_since_ns = 0;
+    while (!tryEnterLink(link, slot, blocked_since_ns)) {
+        if (shuttingDown(sim_context)) return false;
+        link.producer_waiting.store(true);
+        if (linkOccupancy(link) == link.capacity) {
+            semTimedWaitMs(&link.space, 100);
+        }
+        link.producer_waiting.store(false);
+    }
+    return true;
+}
+
+// Consumer side: pops the front vehicle once it is due (any vehicle once
+// shutdown has been requested)
+inline bool popDueLinkVehicle(InterLink& link, long long now_ns, LinkSlot& out) {
+    uint32_t head = link.head.load(memory_order_relaxed);
+    if (link.tail.load(memory_order_acquire) == head) return false;
+
+    const LinkSlot& front = link.ring[head % link.capacity];
+    if (front.arrive_ns > now_ns && !shuttingDown(sim_context)) return false;
+
+    out = front;
+    link.head.store(head + 1, memory_order_release);
+    link.stats.exited++;
+
+    bool expected = true;
+    if (link.producer_waiting.load(memory_order_relaxed)
+        && link.producer_waiting.compare_exchange_strong(expected, false)) {
+        sem_post(&link.space);
+    }
+    return true;
+}
+
+// Drain thread for the thread and coroutine engines. Vehicles leave in FIFO
+// order, which with one travel time is also arrival order.
+inline void* linkDrainThread(void* arg) {
+    InterLink& link = *(InterLink*)arg;
+
+    while (!link.stopping.load()) {
+        LinkSlot slot;
+        long long now = monotonicNowNs();
+        if (popDueLinkVehicle(link, now, slot)) {
+            slot.release(slot.release_ctx);
+            continue;
+        }
+
+        uint32_t head = link.head.load(memory_order_relaxed);
+        if (link.tail.load(memory_order_acquire) != head) {
+            // Front vehicle still travelling; sleep until it is due
+            long long wait_ns = link.ring[head % link.capacity].arrive_ns - now;
+            if (wait_ns > 100000000LL) wait_ns = 100000000LL;
+            struct timespec ts = {0, (long)wait_ns};
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        link.consumer_waiting.store(true);
+        if (link.tail.load() == head) {
+            semTimedWaitMs(&link.items, 100);
+        }
+        link.consumer_waiting.store(false);
+    }
+    return NULL;
+}
+
+inline void startLinkDrain(InterLink& link) {
+    pthread_create(&link.drain_tid, NULL, linkDrainThread, &link);
+}
+
+inline void stopLinkDrain(InterLink& link) {
+    link.stopping.store(true);
+    wakeLinkConsumer(link);
+    pthread_join(link.drain_tid, NULL);
+}
+
+inline void postLinkSemaphore(void* ctx) {
+    sem_post((sem_t*)ctx);
+}
+
+#if CORO_ENGINE_AVAILABLE
+inline void resumeLinkCoroutine(void* ctx) {
+    scheduleCoroutine(coroutine_handle<>::from_address(ctx));
+}
+
+// Suspends the coroutine on the link until the drain thread resumes it
+// downstream. The push happens inside await_suspend, so the drain can never
+// resume a coroutine that has not finished suspending. If the link is full
+// the coroutine continues with entered == false and retries later.
+struct LinkEntered {
+    InterLink* link;
+    Vehicle* vehicle;
+    long long* blocked_since_ns;
+    bool entered;
+
+    bool await_ready() const noexcept { return shuttingDown(sim_context); }
+    bool await_suspend(coroutine_handle<> h) {
+        LinkSlot slot = {vehicle, 0, resumeLinkCoroutine, h.address()};
+        entered = tryEnterLink(*link, slot, *blocked_since_ns);
+        return entered;
+    }
+    bool await_resume() const { return entered; }
+};
+#endif
+
+inline void printLinkReport(const InterLink& link) {
+    const LinkStats& s = link.stats;
+    double mean = (s.entered > 0) ? (double)s.occupancy_sum / s.entered : 0.0;
+    cout << ("  Link " + linkName(link) + ": " + to_string(s.entered) + " entered, "
+         + to_string(s.exited) + " exited, peak occupancy " + to_string(s.peak_occupancy) + "/"
+         + to_string(link.capacity) + ", mean occupancy on entry " + to_string(mean) + "\n");
+    cout << ("    Spillback: " + to_string(s.blocked) + " blocked discharges, "
+         + to_string(s.blocked_ns / 1000000) + " ms total, "
+         + to_string(s.max_blocked_ns / 1000000) + " ms longest\n");
+}
+
+#endif // LINKS_H
@@ -0,0 +1,155 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Leveled event log. LOG_TRACE/DEBUG/INFO/WARN(args...) compile to nothing
+// below LOG_COMPILE_LEVEL (e.g. -DLOG_COMPILE_LEVEL=2 drops trace and debug),
+// do not evaluate their arguments below the runtime log_level, and otherwise
+// format the arguments in place into a per-thread buffer: no std::string is
+// built and nothing is allocated per event.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <ctime>
+#include <type_traits>
+#include <pthread.h>
+#include "simulation.h"
+#include "perfcounters.h"
+
+using namespace std;
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_OFF 4
+
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_TRACE
+#endif
+
+const string LOG_LEVEL_NAMES[] = {"trace", "debug", "info", "warn", "off"};
+const int LOG_BUFFER_SIZE = 512;
+
+extern int log_level;
+
+struct LogBuffer {
+    char data[LOG_BUFFER_SIZE];
+    size_t len;
+    time_t stamp_second;
+    char stamp[16];
+};
+
+inline void appendLogBytes(LogBuffer& buf, const char* s, size_t n) {
+    size_t room = LOG_BUFFER_SIZE - 1 - buf.len;     // keep space for the newline
+    if (n > room) n = room;
+    memcpy(buf.data + buf.len, s, n);
+    buf.len += n;
+}
+
+inline void appendLogArg(LogBuffer& buf, const string& s) {
+    appendLogBytes(buf, s.data(), s.size());
+}
+
+inline void appendLogArg(LogBuffer& buf, const char* s) {
+    appendLogBytes(buf, s, strlen(s));
+}
+
+inline void appendLogArg(LogBuffer& buf, char c) {
+    appendLogBytes(buf, &c, 1);
+}
+
+inline void appendLogArg(LogBuffer& buf, double value) {
+    char digits[32];
+    int n = snprintf(digits, sizeof(digits), "%f", value);
+    if (n > 0) appendLogBytes(buf, digits, (size_t)n);
+}
+
+template <typename T>
+inline typename enable_if<is_integral<T>::value>::type appendLogArg(LogBuffer& buf, T value) {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    bool negative = value < 0;
+    unsigned long long v = negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    do {
+        *--p = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    if (negative) *--p = '-';
+    appendLogBytes(buf, p, (size_t)(end - p));
+}
+
+// "[HH:MM:SS] ", reformatted only when the second changes
+inline void appendLogTimestamp(LogBuffer& buf) {
+    time_t now = time(NULL);
+    if (now != buf.stamp_second) {
+        struct tm local;
+        localtime_r(&now, &local);
+        strftime(buf.stamp, sizeof(buf.stamp), "[%H:%M:%S] ", &local);
+        buf.stamp_second = now;
+    }
+    appendLogBytes(buf, buf.stamp, strlen(buf.stamp));
+}
+
+template <typename... Args>
+inline void logWrite(const Args&... args) {
+    static thread_local LogBuffer buf = {{0}, 0, (time_t)-1, {0}};
+    buf.len = 0;
+    appendLogTimestamp(buf);
+    (appendLogArg(buf, args), ...);
+    buf.data[buf.len++] = '\n';
+
+    pthread_mutex_lock(&console_mutex);
+    fwrite(buf.data, 1, buf.len, stdout);
+    fflush(stdout);
+    pthread_mutex_unlock(&console_mutex);
+}
+
+inline bool parseLogLevel(const string& name, int& level) {
+    for (int i = LOG_LEVEL_TRACE; i <= LOG_LEVEL_OFF; i++) {
+        if (LOG_LEVEL_NAMES[i] == name) {
+            level = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// For multi-line reports that are not worth converting to single events
+inline bool logEnabled(int level) {
+    return level >= LOG_COMPILE_LEVEL && level >= log_level;
+}
+
+#define LOG_AT(level, ...) \
+    do { if ((level) >= log_level) { PerfRegion perf_log(PERF_LOGGING); logWrite(__VA_ARGS__); } } while (0)
+
+// Compiled out: still type-checked, but no code and no argument evaluation
+#define LOG_ELIDED(...) \
+    do { if (false) logWrite(__VA_ARGS__); } while (0)
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) LOG_ELIDED(__VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_ELIDED(__VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_ELIDED(__VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) LOG_ELIDED(__VA_ARGS__)
+#endif
+
+#endif // LOG_H
@@ -0,0 +1,183 @@
+#ifndef LOOKAHEAD_H
+#define LOOKAHEAD_H
+
+// Predictive signal control (--predictive). As a green starts, the planner
+// thread locks both intersections, forks the whole simulator and unlocks
+// again: copy-on-write makes the fork the snapshot, so nothing is copied or
+// serialized up front. The snapshot is single-threaded, so it can fork again
+// safely: one child per candidate plan (keep, extend the green to max green,
+// switch now, skip the next phase). Each child runs the intersection's next
+// LOOKAHEAD_HORIZON_US in virtual time, with the transit benchmark's model
+// (a vehicle's delay is its wait for green), and writes the projected
+// vehicle-seconds of delay into a shared result page. Nothing in a snapshot
+// may lock, log or flush stdio: the threads that held those locks were not
+// copied. A snapshot that does not finish in time is killed and the plan
+// kept.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "simulation.h"
+#include "signalplan.h"
+#include "transit.h"
+#include "latency.h"
+
+using namespace std;
+
+const long long LOOKAHEAD_HORIZON_US = 120000000LL;    // two minutes of simulated time
+const int LOOKAHEAD_TIMEOUT_MS = 500;
+const double LOOKAHEAD_MIN_GAIN_S = 1.0;   // vehicle-seconds a change must save over keeping the plan
+
+// A green start waiting for the planner
+struct LookaheadRequest {
+    bool pending;
+    int step;
+    long long start_ns;
+};
+
+// Written by the candidate children, read by the planner once the snapshot exits
+struct LookaheadResults {
+    int vehicles;
+    bool done[NUM_LOOKAHEAD_PLANS];
+    double delay_s[NUM_LOOKAHEAD_PLANS];
+};
+
+struct LookaheadStats {
+    long decisions;
+    long chosen[NUM_LOOKAHEAD_PLANS];
+    long timeouts;
+    long failures;
+    long vehicles;              // projected, summed over decisions
+    double saved_s;             // projected delay saved by the chosen plans
+    LatencyHistogram fork_pause;    // intersections held while the snapshot is forked
+    LatencyHistogram turnaround;    // green start to decision sent
+};
+
+inline void resetLookaheadStats(LookaheadStats& s) {
+    s.decisions = 0;
+    for (int p = 0; p < NUM_LOOKAHEAD_PLANS; p++) s.chosen[p] = 0;
+    s.timeouts = 0;
+    s.failures = 0;
+    s.vehicles = 0;
+    s.saved_s = 0.0;
+    resetLatencyHistogram(s.fork_pause);
+    resetLatencyHistogram(s.turnaround);
+}
+
+inline LookaheadResults* createLookaheadResults() {
+    void* page = mmap(NULL, sizeof(LookaheadResults), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return (page == MAP_FAILED) ? NULL : (LookaheadResults*)page;
+}
+
+inline void destroyLookaheadResults(LookaheadResults* results) {
+    munmap(results, sizeof(LookaheadResults));
+}
+
+// The light sequence from the green step starting at start_ns, as the
+// controller would run it under `choice`, until horizon_ns
+inline vector<LightSegment> lookaheadTimeline(const CompiledSignalPlan& plan, size_t step, long long start_ns,
+                                              long long now_ns, int choice, long long horizon_ns) {
+    vector<LightSegment> timeline;
+    long long end_ns = lookaheadGreenEnd(plan, step, start_ns, now_ns, choice);
+    int skip_phase = (choice == LOOKAHEAD_SKIP_NEXT) ? lookaheadSkippedPhase(plan, step) : -1;
+
+    while (start_ns < horizon_ns) {
+        LightSegment segment = {start_ns, end_ns, plan.steps[step].lights};
+        timeline.push_back(segment);
+
+        size_t previous = step;
+        step = nextSignalStep(plan, previous, -1);
+        if (skip_phase >= 0 && plan.steps[step].phase == skip_phase) {
+            step = nextSignalStep(plan, previous, skip_phase);
+            skip_phase = -1;
+        }
+        start_ns = end_ns;
+        end_ns = start_ns + (long long)plan.steps[step].duration_us * 1000;
+    }
+    return timeline;
+}
+
+// Runs in the snapshot: one child per plan, each scoring the same arrivals
+// (sorted by time; queued vehicles arrive at now_ns). Returns once all exit.
+inline void evaluateLookaheadPlans(const CompiledSignalPlan& plan, size_t step, long long start_ns, long long now_ns,
+                                   const vector<TransitArrival>& arrivals, LookaheadResults& results) {
+    long long horizon_ns = now_ns + LOOKAHEAD_HORIZON_US * 1000;
+    results.vehicles = (int)arrivals.size();
+
+    pid_t children[NUM_LOOKAHEAD_PLANS];
+    for (int p = 0; p < NUM_LOOKAHEAD_PLANS; p++) {
+        results.done[p] = false;
+        children[p] = fork();
+        if (children[p] != 0) continue;
+
+        // Two extra cycles, so every arrival before the horizon sees its green
+        vector<LightSegment> timeline = lookaheadTimeline(plan, step, start_ns, now_ns, p,
+                                                          horizon_ns + 2LL * plan.cycle_us * 1000);
+        TransitDelays d = measureTransitDelays(arrivals, timeline);
+        results.delay_s[p] = d.bus_total_s + d.other_total_s;
+        results.done[p] = true;
+        _exit(0);
+    }
+    for (int p = 0; p < NUM_LOOKAHEAD_PLANS; p++) {
+        if (children[p] > 0) waitpid(children[p], NULL, 0);
+    }
+}
+
+// Waits for the snapshot to exit (done_fd, the read end of a pipe only the
+// snapshot holds open, hangs up); kills it after LOOKAHEAD_TIMEOUT_MS
+inline bool awaitLookahead(pid_t snapshot, int done_fd) {
+    struct pollfd pfd = {done_fd, POLLIN, 0};
+    int ready;
+    do {
+        ready = poll(&pfd, 1, LOOKAHEAD_TIMEOUT_MS);
+    } while (ready < 0 && errno == EINTR);
+
+    if (ready <= 0) kill(snapshot, SIGKILL);
+    waitpid(snapshot, NULL, 0);
+    return ready > 0;
+}
+
+// The cheapest plan; a change must beat keeping the plan by LOOKAHEAD_MIN_GAIN_S
+inline int chooseLookaheadPlan(const LookaheadResults& results, double& saved_s) {
+    int best = LOOKAHEAD_KEEP;
+    saved_s = 0.0;
+    if (!results.done[LOOKAHEAD_KEEP]) return best;
+    for (int p = 0; p < NUM_LOOKAHEAD_PLANS; p++) {
+        if (!results.done[p]) continue;
+        double saved = results.delay_s[LOOKAHEAD_KEEP] - results.delay_s[p];
+        if (saved >= LOOKAHEAD_MIN_GAIN_S && saved > saved_s) {
+            best = p;
+            saved_s = saved;
+        }
+    }
+    return best;
+}
+
+inline void printLookaheadReport(const LookaheadStats& s) {
+    cout << ("Predictive control: " + to_string(s.decisions) + " decisions over a "
+             + to_string(LOOKAHEAD_HORIZON_US / 1000000) + " s horizon, " + to_string(s.timeouts) + " timed out, "
+             + to_string(s.failures) + " fork failures\n");
+    string line = "  Chosen:";
+    for (int p = 0; p < NUM_LOOKAHEAD_PLANS; p++) line += " " + LOOKAHEAD_PLAN_NAMES[p] + " " + to_string(s.chosen[p]) + ",";
+    line.pop_back();
+    cout << (line + "\n");
+    if (s.decisions > 0) {
+        char text[96];
+        snprintf(text, sizeof(text), "  Projected: %.1f vehicles per decision, %.1f vehicle-s of delay saved in total\n",
+                 (double)s.vehicles / s.decisions, s.saved_s);
+        cout << text;
+    }
+    printLatencySummary("Snapshot fork (intersections held)", s.fork_pause);
+    printLatencySummary("Green start to decision sent", s.turnaround);
+}
+
+#endif // LOOKAHEAD_H
@@ -12,6 +12,9 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <cerrno>
 
 #ifndef _WIN32
 #include <sys/wait.h>
@@ -24,12 +27,30 @@
 #include "parkinglot.h"
 #include "controller.h"
 #include "display.h"
+#include "options.h"
+#include "workload.h"
+#include "ingest.h"
+#include "vehiclepool.h"
+#include "coroengine.h"
+#include "kinematics.h"
+#include "lifecycle.h"
+#include "signalplan.h"
+#include "links.h"
+#include "corridor.h"
+#include "transit.h"
+#include "lookahead.h"
+#include "log.h"
+#include "snapshot.h"
+#include "epochviews.h"
+#include "dashboard.h"
+#include "stateexport.h"
+#include "placement.h"
+#include "latency.h"
 
 using namespace std;
 
 // Global variable definitions
 pthread_mutex_t console_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t vehicle_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t f10_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t f11_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -39,95 +60,380 @@ pthread_cond_t f10_east_west_cond = PTHREAD_COND_INITIALIZER;
 pthread_cond_t f11_north_south_cond = PTHREAD_COND_INITIALIZER;
 pthread_cond_t f11_east_west_cond = PTHREAD_COND_INITIALIZER;
 
-bool shutdown_flag = false;
-bool emergency_active = false;
-string emergency_direction = "";
-int vehicles_completed = 0;
-int total_vehicles_to_spawn = DEFAULT_VEHICLE_COUNT;
-int next_vehicle_id = 1;
+SimulationContext sim_context;
 
 int pipe_f10_to_f11[2];
 int pipe_f11_to_f10[2];
 int pipe_f10_to_parent[2];
 int pipe_f11_to_parent[2];
+PeerOutbox peer_outboxes[NUM_INTERSECTIONS];
 
 Intersection intersection_f10;
 Intersection intersection_f11;
 ParkingLot parking_f10;
 ParkingLot parking_f11;
 
-vector<pthread_t> vehicle_threads;
+VehiclePool vehicle_pool;
+pthread_attr_t vehicle_thread_attr;
+bool use_coroutines = false;
 
-volatile sig_atomic_t child_shutdown_flag = 0;
+#if CORO_ENGINE_AVAILABLE
+CoroScheduler coro_scheduler;
+#endif
 
-void childSignalHandler(int signum) {
-    child_shutdown_flag = 1;
-}
+bool use_kinematics = false;
+KinematicEngine kinematic_engine;
+pthread_mutex_t kinematic_inbox_mutex = PTHREAD_MUTEX_INITIALIZER;
+vector<Vehicle*> kinematic_inbox;
+
+SimulationOptions sim_options;
+PerfState perf_state;
+Placement cpu_placement;
+string listener_cpus = "unknown";
+LatencyHistogram light_notify_latency[NUM_INTERSECTIONS];  // controller publish to waiters woken
+uint8_t published_lights[NUM_INTERSECTIONS];    // last state delivered, under the intersection's mutex
+LightMailbox* light_mailbox = NULL;             // --controllers shm
+LightListener light_listener;
+pid_t controller_pids[NUM_INTERSECTIONS];
+pthread_t controller_tids[NUM_INTERSECTIONS];
+LatencyHistogram phase_start_error[NUM_INTERSECTIONS];    // controller publish minus plan deadline
+DriftTrack phase_drift[NUM_INTERSECTIONS];
+int log_level = LOG_LEVEL_DEBUG;
+WorkloadRecorder workload_recorder = {NULL, {}};
+WorkloadReplay workload_replay = {NULL, {}, false, false, 0, false, {}};
+WorkloadOutcome run_outcome = {0, 0, FNV_OFFSET_BASIS, 0};
+
+CompiledSignalPlan signal_plans[NUM_INTERSECTIONS];
+long long signal_reference_ns = 0;             // 0: each controller free-runs from its own start
+InterLink inter_links[NUM_INTERSECTIONS];      // indexed by upstream intersection
+
+ArrivalFeed arrival_feed;
+bool feeding = false;
+DemandSchedule demand_schedule;                 // --demand
+bool demand_driven = false;
+
+CompletionLatch completion_latch;
+DepartureService departure_service;
+ViewDomain views;
+Dashboard dashboard;
+StateExport state_export = {NULL, PTHREAD_MUTEX_INITIALIZER};
+int shutdown_signal_fd = -1;
+int shutdown_wake_fd = -1;
+LookaheadResults* lookahead_results = NULL;     // --predictive
+LookaheadStats lookahead_stats;
+LookaheadRequest lookahead_requests[NUM_INTERSECTIONS];
+pthread_mutex_t lookahead_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t lookahead_wake = PTHREAD_COND_INITIALIZER;
+
+// The arrival the spawner is waiting to make. With run_outcome.spawned, the
+// random generator and demand_schedule, it is guarded by spawner_lock, which
+// a lookahead holds across its fork.
+struct PendingArrival {
+    bool valid;
+    ArrivalRecord rec;
+    long long due_ns;
+};
+PendingArrival pending_arrival = {false, {}, 0};
+pthread_mutex_t spawner_lock = PTHREAD_MUTEX_INITIALIZER;
 
-void signalHandler(int signum) {
-    safePrintWithTime("SIGNAL: Shutdown signal received. Initiating graceful shutdown...");
-    shutdown_flag = true;
+void requestShutdown() {
+    raiseShutdown(sim_context);
     
     pthread_cond_broadcast(&f10_north_south_cond);
     pthread_cond_broadcast(&f10_east_west_cond);
     pthread_cond_broadcast(&f11_north_south_cond);
     pthread_cond_broadcast(&f11_east_west_cond);
+    
+    pthread_mutex_lock(&lookahead_lock);
+    pthread_cond_broadcast(&lookahead_wake);
+    pthread_mutex_unlock(&lookahead_lock);
+    
+    cancelLatch(completion_latch);
 }
 
-void* vehicleThread(void* arg) {
-    Vehicle* v = (Vehicle*)arg;
+// Reads SIGINT/SIGTERM from the signalfd as ordinary data, so shutdown runs
+// on a normal thread rather than inside an async signal handler
+void* shutdownSignalThread(void* arg) {
+    struct pollfd fds[2];
+    fds[0].fd = shutdown_signal_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = shutdown_wake_fd;
+    fds[1].events = POLLIN;
     
-    logVehicleSpawn(v->id, v->type, v->spawn_intersection, v->spawn_side, v->direction);
-    
-    Intersection* current_intersection_ptr;
-    ParkingLot* current_parking;
-    pthread_mutex_t* current_mutex;
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents & POLLIN) break;
+        
+        int signum;
+        if ((fds[0].revents & POLLIN) && readShutdownSignal(shutdown_signal_fd, signum)) {
+            if (!shuttingDown(sim_context)) {
+                LOG_WARN("SIGNAL: ", strsignal(signum), " received. Initiating graceful shutdown...");
+            }
+            requestShutdown();
+        }
+    }
+    return NULL;
+}
+
+struct IntersectionBinding {
+    int index;
+    Intersection* intersection;
+    ParkingLot* parking;
+    pthread_mutex_t* mutex;
     pthread_cond_t* ns_cond;
     pthread_cond_t* ew_cond;
+};
+
+IntersectionBinding bindIntersection(const string& id) {
+    IntersectionBinding b;
+    if (id == "F10") {
+        b.index = 0;
+        b.intersection = &intersection_f10;
+        b.parking = &parking_f10;
+        b.mutex = &f10_mutex;
+        b.ns_cond = &f10_north_south_cond;
+        b.ew_cond = &f10_east_west_cond;
+    } else {
+        b.index = 1;
+        b.intersection = &intersection_f11;
+        b.parking = &parking_f11;
+        b.mutex = &f11_mutex;
+        b.ns_cond = &f11_north_south_cond;
+        b.ew_cond = &f11_east_west_cond;
+    }
+    return b;
+}
+
+// Shared-memory export: each hook rewrites only the section that changed.
+// Link occupancy is two atomic loads, so every update refreshes it too.
+void commitStateUpdate() {
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) snapshotLink(inter_links[i], state_export.region->snapshot);
+    endStateUpdate(state_export);
+}
+
+// Caller holds the intersection's mutex. Every queue or light change comes
+// through here, so it also publishes the intersection's read-only view.
+void exportIntersectionLocked(int index) {
+    Intersection& intersection = *bindIntersection(INTERSECTION_IDS[index]).intersection;
+    publishIntersectionView(views, index, intersection);
+    if (!stateExportEnabled(state_export)) return;
+    StateSnapshot& s = beginStateUpdate(state_export);
+    snapshotIntersectionLocked(intersection, s.intersections[index]);
+    commitStateUpdate();
+}
+
+// Both intersections and the corridor; takes the locks in endEmergencyCorridor's order
+void exportIntersections() {
+    pthread_mutex_lock(&f10_mutex);
+    pthread_mutex_lock(&f11_mutex);
+    publishIntersectionView(views, 0, intersection_f10);
+    publishIntersectionView(views, 1, intersection_f11);
+    if (!stateExportEnabled(state_export)) {
+        pthread_mutex_unlock(&f11_mutex);
+        pthread_mutex_unlock(&f10_mutex);
+        return;
+    }
+    StateSnapshot& s = beginStateUpdate(state_export);
+    snapshotIntersectionLocked(intersection_f10, s.intersections[0]);
+    snapshotIntersectionLocked(intersection_f11, s.intersections[1]);
+    s.emergency = (uint8_t)emergencyState(sim_context);
+    commitStateUpdate();
+    pthread_mutex_unlock(&f11_mutex);
+    pthread_mutex_unlock(&f10_mutex);
+}
+
+void exportParking(int index) {
+    ParkingLot& lot = *bindIntersection(INTERSECTION_IDS[index]).parking;
+    publishParkingView(views, index, lot);
+    if (!stateExportEnabled(state_export)) return;
+    StateSnapshot& s = beginStateUpdate(state_export);
+    snapshotParkingLot(lot, s.parking[index]);
+    commitStateUpdate();
+}
+
+void exportCounters() {
+    if (!stateExportEnabled(state_export)) return;
+    StateSnapshot& s = beginStateUpdate(state_export);
+    snapshotLatch(completion_latch, s);
+    commitStateUpdate();
+}
+
+// The controller downstream of the corridor is told over its peer pipe
+void beginEmergencyCorridor(Vehicle* v) {
+    pthread_mutex_lock(&f10_mutex);
+    pthread_mutex_lock(&f11_mutex);
     
-    while (!v->has_exited && !shutdown_flag) {
-        if (v->current_intersection == "F10") {
-            current_intersection_ptr = &intersection_f10;
-            current_parking = &parking_f10;
-            current_mutex = &f10_mutex;
-            ns_cond = &f10_north_south_cond;
-            ew_cond = &f10_east_west_cond;
-        } else {
-            current_intersection_ptr = &intersection_f11;
-            current_parking = &parking_f11;
-            current_mutex = &f11_mutex;
-            ns_cond = &f11_north_south_cond;
-            ew_cond = &f11_east_west_cond;
+    int notify_index = -1;
+    int direction = EMERGENCY_NONE;
+    char notify = 0;
+    if (v->spawn_intersection == "F10" && v->spawn_side == "WEST") {
+        logEmergency("EASTBOUND", true);
+        setEmergency(sim_context, EMERGENCY_EASTBOUND);
+        activateEastboundEmergencyCorridor(intersection_f10, intersection_f11);
+        notify_index = 1;
+        direction = EMERGENCY_EASTBOUND;
+        notify = MSG_EMERGENCY_EASTBOUND;
+    } else if (v->spawn_intersection == "F11" && v->spawn_side == "EAST") {
+        logEmergency("WESTBOUND", true);
+        setEmergency(sim_context, EMERGENCY_WESTBOUND);
+        activateWestboundEmergencyCorridor(intersection_f10, intersection_f11);
+        notify_index = 0;
+        direction = EMERGENCY_WESTBOUND;
+        notify = MSG_EMERGENCY_WESTBOUND;
+    }
+    
+    pthread_mutex_unlock(&f11_mutex);
+    pthread_mutex_unlock(&f10_mutex);
+    exportIntersections();
+    // It crosses the spawn junction (entry and exit) before reaching the downstream one
+    long long eta_ns = monotonicNowNs() + 2LL * CROSSING_TIME * 1000;
+    if (notify_index >= 0) sendEmergencyNotice(peer_outboxes[notify_index], notify, v->id, direction, eta_ns);
+}
+
+void endEmergencyCorridor() {
+    pthread_mutex_lock(&f10_mutex);
+    pthread_mutex_lock(&f11_mutex);
+    
+    int ending = emergencyState(sim_context);
+    logEmergency((ending == EMERGENCY_NONE) ? "" : EMERGENCY_NAMES[ending], false);
+    setEmergency(sim_context, EMERGENCY_NONE);
+    deactivateEmergencyCorridor(intersection_f10, intersection_f11);
+    
+    pthread_mutex_unlock(&f11_mutex);
+    pthread_mutex_unlock(&f10_mutex);
+    exportIntersections();
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) sendToController(peer_outboxes[i], MSG_EMERGENCY_CLEAR);
+}
+
+void removeFromQueue(TrafficController* controller, int vehicle_id) {
+    for (auto it = controller->queue.begin(); it != controller->queue.end(); ++it) {
+        if (it->id == vehicle_id) {
+            controller->queue.erase(it);
+            break;
         }
+    }
+}
+
+// Each controller reads the pipe named after its peer
+int controllerRequestFd(int index) {
+    return (index == 0) ? pipe_f11_to_f10[1] : pipe_f10_to_f11[1];
+}
+
+// --transit-priority: a bus asks its intersection's controller for green at
+// arrive_ns, on check-in from the link and again if it joins a red queue
+void requestTransitPriority(Vehicle* v, long long arrive_ns) {
+    if (!sim_options.transit_priority || v->priority != "MEDIUM") return;
+    int index = intersectionIndex(v->current_intersection);
+    LOG_DEBUG("[TSP] Bus ", v->id, " requests priority at ", v->current_intersection, " ", v->current_side);
+    sendTransitPriorityRequest(peer_outboxes[index], v->id, approachOf(v->current_side), arrive_ns);
+}
+
+// Moves the vehicle onto the next intersection if its exit leads there
+bool transitToNextIntersection(Vehicle* v, const string& exit_side) {
+    if (!willTransitionToOtherIntersection(v->current_intersection, exit_side)) {
+        return false;
+    }
+    
+    string next_int = (v->current_intersection == "F10") ? "F11" : "F10";
+    logVehicleTransit(v->id, v->type, v->current_intersection, next_int);
+    
+    v->current_intersection = next_int;
+    v->current_side = (next_int == "F11") ? "WEST" : "EAST";
+    requestTransitPriority(v, monotonicNowNs() + LINK_TRAVEL_TIME * 1000LL);
+    return true;
+}
+
+// Blocks while the link is full (spillback), then until the link's drain
+// thread releases the vehicle at the downstream intersection
+bool travelLink(Vehicle* v, int from) {
+    PerfRegion perf(PERF_LINK);
+    sem_t arrived;
+    sem_init(&arrived, 0, 0);
+    LinkSlot slot = {v, 0, postLinkSemaphore, &arrived};
+    bool entered = enterLink(inter_links[from], slot);
+    if (entered) sem_wait(&arrived);
+    sem_destroy(&arrived);
+    return entered && !shuttingDown(sim_context);
+}
+
+void finishVehicle(Vehicle* v, const string& final_exit_side) {
+    if (v->has_exited) {
+        logVehicleComplete(v->id, v->type);
         
-        TrafficController* controller;
-        if (v->current_side == "NORTH") {
-            controller = &current_intersection_ptr->north_controller;
-        } else if (v->current_side == "SOUTH") {
-            controller = &current_intersection_ptr->south_controller;
-        } else if (v->current_side == "EAST") {
-            controller = &current_intersection_ptr->east_controller;
-        } else {
-            controller = &current_intersection_ptr->west_controller;
-        }
+        countVehicleCompleted(sim_context);
+        pthread_mutex_lock(&stats_mutex);
+        run_outcome.completed++;
+        run_outcome.route_digest += vehicleRouteHash(v->id, v->current_intersection, final_exit_side);
+        pthread_mutex_unlock(&stats_mutex);
+    }
+    
+    countDownLatch(completion_latch, v->has_exited);
+    exportCounters();
+    releaseVehicle(vehicle_pool, v);
+}
+
+// Exit through exit_side: leave the network, or cross the link to the next
+// intersection. False if the run shut down while on the link
+bool departIntersection(Vehicle* v, int index, const string& exit_side, string& final_exit_side) {
+    logVehicleExit(v->id, v->type, v->current_intersection, exit_side);
+    
+    if (!transitToNextIntersection(v, exit_side)) {
+        final_exit_side = exit_side;
+        v->has_exited = true;
+        return true;
+    }
+    return travelLink(v, index);
+}
+
+void* vehicleThread(void* arg);
+
+// Departure service callback: the parked vehicle continues on a new thread
+void resumeParkedVehicle(void* ctx) {
+    Vehicle* v = (Vehicle*)ctx;
+    pthread_t tid;
+    if (pthread_create(&tid, &vehicle_thread_attr, vehicleThread, ctx) != 0) {
+        scheduleDeparture(departure_service, *bindIntersection(v->current_intersection).parking,
+                          monotonicNowNs() + DEPARTURE_RETRY_US * 1000LL, resumeParkedVehicle, ctx);
+    }
+}
+
+void logVehicleWaiting(Vehicle* v, uint8_t light) {
+    LOG_DEBUG("[WAITING] Vehicle ", v->id, " (", v->type, ") waiting at ", v->current_intersection, " ",
+              v->current_side, " (light is ", LIGHT_STATE_NAMES[light], ")");
+}
+
+void* vehicleThread(void* arg) {
+    Vehicle* v = (Vehicle*)arg;
+    perfSetThreadRole(PERF_ROLE_VEHICLE);
+    
+    string final_exit_side = "NONE";
+    bool moving = true;
+    
+    if (v->parked) {
+        // Restarted by the departure service once the dwell is over
+        v->parked = false;
+        IntersectionBinding at = bindIntersection(v->current_intersection);
+        exitParking(*at.parking, *v);
+        exportParking(at.index);
+        logParking(v->id, v->type, v->current_intersection, false);
+        moving = departIntersection(v, at.index, getExitSide(v->current_side, v->direction), final_exit_side);
+    } else {
+        logVehicleSpawn(v->id, v->type, v->spawn_intersection, v->spawn_side, v->direction);
+    }
+    
+    while (moving && !v->has_exited && !shuttingDown(sim_context)) {
+        IntersectionBinding at = bindIntersection(v->current_intersection);
+        pthread_mutex_t* current_mutex = at.mutex;
+        int approach = approachOf(v->current_side);
+        TrafficController* controller = &getController(*at.intersection, approach);
         
         // Emergency vehicle handling
         if (v->priority == "HIGH") {
-            pthread_mutex_lock(current_mutex);
-            
-            if (v->spawn_intersection == "F10" && v->spawn_side == "WEST") {
-                logEmergency("EASTBOUND", true);
-                emergency_active = true;
-                emergency_direction = "EASTBOUND";
-                activateEastboundEmergencyCorridor(intersection_f10, intersection_f11);
-            } else if (v->spawn_intersection == "F11" && v->spawn_side == "EAST") {
-                logEmergency("WESTBOUND", true);
-                emergency_active = true;
-                emergency_direction = "WESTBOUND";
-                activateWestboundEmergencyCorridor(intersection_f10, intersection_f11);
-            }
-            
-            pthread_mutex_unlock(current_mutex);
+            PerfRegion perf_cross(PERF_CROSSING);
+            beginEmergencyCorridor(v);
             
             usleep(CROSSING_TIME);
             logVehicleEntry(v->id, v->type, v->current_intersection, v->current_side);
@@ -137,423 +443,937 @@ void* vehicleThread(void* arg) {
             string exit_side = getExitSide(v->current_side, v->direction);
             logVehicleExit(v->id, v->type, v->current_intersection, exit_side);
             
-            if (willTransitionToOtherIntersection(v->current_intersection, getExitSide(v->current_side, v->direction))) {
-                string next_int = (v->current_intersection == "F10") ? "F11" : "F10";
-                logVehicleTransit(v->id, v->type, v->current_intersection, next_int);
-                
-                v->current_intersection = next_int;
-                v->current_side = (next_int == "F11") ? "WEST" : "EAST";
-                
+            if (transitToNextIntersection(v, exit_side)) {
                 usleep(CROSSING_TIME);
                 exit_side = getExitSide(v->current_side, v->direction);
                 logVehicleExit(v->id, v->type, v->current_intersection, exit_side);
             }
+            final_exit_side = exit_side;
             
-            pthread_mutex_lock(&f10_mutex);
-            pthread_mutex_lock(&f11_mutex);
-            
-            logEmergency(emergency_direction, false);
-            emergency_active = false;
-            emergency_direction = "";
-            deactivateEmergencyCorridor(intersection_f10, intersection_f11);
-            
-            pthread_mutex_unlock(&f11_mutex);
-            pthread_mutex_unlock(&f10_mutex);
+            endEmergencyCorridor();
             
             v->has_exited = true;
             
         } else {
             // Regular vehicle processing
-            pthread_mutex_lock(current_mutex);
+            {
+                PerfRegion perf_wait(PERF_QUEUE_WAIT);
+                pthread_mutex_lock(current_mutex);
             
-            controller->queue.push_back(*v);
+                controller->queue.push_back(*v);
+                exportIntersectionLocked(at.index);
+            
+                bool is_ns = (approach == APPROACH_NORTH || approach == APPROACH_SOUTH);
+                pthread_cond_t* wait_cond = is_ns ? at.ns_cond : at.ew_cond;
             
-            bool is_ns = (v->current_side == "NORTH" || v->current_side == "SOUTH");
-            pthread_cond_t* wait_cond = is_ns ? ns_cond : ew_cond;
+                if (approachLight(*at.intersection, approach) != LIGHT_GREEN) {
+                    pthread_mutex_unlock(current_mutex);
+                    logVehicleWaiting(v, approachLight(*at.intersection, approach));
+                    requestTransitPriority(v, monotonicNowNs());
+                    pthread_mutex_lock(current_mutex);
+                }
+            
+                while (approachLight(*at.intersection, approach) != LIGHT_GREEN && !shuttingDown(sim_context) && !emergencyActive(sim_context)) {
+                    pthread_cond_wait(wait_cond, current_mutex);
+                }
+            
+                if (shuttingDown(sim_context)) {
+                    pthread_mutex_unlock(current_mutex);
+                    break;
+                }
+            
+                while (emergencyActive(sim_context) && !shuttingDown(sim_context)) {
+                    pthread_cond_wait(wait_cond, current_mutex);
+                }
+            
+                if (shuttingDown(sim_context)) {
+                    pthread_mutex_unlock(current_mutex);
+                    break;
+                }
+            
+                removeFromQueue(controller, v->id);
+                exportIntersectionLocked(at.index);
             
-            if (controller->light_state != "GREEN") {
                 pthread_mutex_unlock(current_mutex);
-                safePrintWithTime("[WAITING] Vehicle " + to_string(v->id) + " (" + v->type + ") waiting at " + v->current_intersection + " " + v->current_side + " (light is " + controller->light_state + ")");
-                pthread_mutex_lock(current_mutex);
             }
             
-            while (controller->light_state != "GREEN" && !shutdown_flag && !emergency_active) {
-                pthread_cond_wait(wait_cond, current_mutex);
+            {
+                PerfRegion perf_cross(PERF_CROSSING);
+                logVehicleEntry(v->id, v->type, v->current_intersection, v->current_side);
+                usleep(CROSSING_TIME);
             }
             
-            if (shutdown_flag) {
-                pthread_mutex_unlock(current_mutex);
-                break;
+            string exit_side = getExitSide(v->current_side, v->direction);
+            ParkingLot* current_parking = at.parking;
+            
+            // Parking handling
+            if (v->wants_parking && !v->has_exited) {
+                PerfRegion perf_park(PERF_PARKING);
+                bool parked = tryPark(*current_parking, *v);
+                
+                if (!parked && tryJoinWaitQueue(*current_parking, *v)) {
+                    exportParking(at.index);
+                    // Woken as soon as a departure frees a spot, or gives up after the wait
+                    if (semTimedWaitMs(&current_parking->parking_spots, 500)) {
+                        sem_wait(&current_parking->access_lock);
+                        current_parking->parked_vehicles.push_back(*v);
+                        sem_post(&current_parking->access_lock);
+                        parked = true;
+                    }
+                    leaveWaitQueue(*current_parking, v->id);
+                    exportParking(at.index);
+                }
+                
+                if (parked) {
+                    exportParking(at.index);
+                    logParking(v->id, v->type, v->current_intersection, true);
+                    
+                    // Release the thread; the lot's departure wheel brings the vehicle back
+                    v->parked = true;
+                    scheduleDeparture(departure_service, *current_parking, monotonicNowNs() + v->park_time * 1000LL,
+                                      resumeParkedVehicle, v);
+                    return NULL;
+                }
+            }
+            
+            if (!departIntersection(v, at.index, exit_side, final_exit_side)) break;
+        }
+    }
+    
+    finishVehicle(v, final_exit_side);
+    return NULL;
+}
+
+#if CORO_ENGINE_AVAILABLE
+// Same lifecycle as vehicleThread, but every blocking step is a co_await so
+// the scheduler thread is free to run other vehicles in the meantime
+VehicleTask vehicleCoroutine(Vehicle* v) {
+    logVehicleSpawn(v->id, v->type, v->spawn_intersection, v->spawn_side, v->direction);
+    
+    string final_exit_side = "NONE";
+    
+    while (!v->has_exited && !shuttingDown(sim_context)) {
+        IntersectionBinding at = bindIntersection(v->current_intersection);
+        int approach = approachOf(v->current_side);
+        TrafficController* controller = &getController(*at.intersection, approach);
+        
+        if (v->priority == "HIGH") {
+            beginEmergencyCorridor(v);
+            
+            co_await SleepFor{CROSSING_TIME};
+            logVehicleEntry(v->id, v->type, v->current_intersection, v->current_side);
+            
+            co_await SleepFor{CROSSING_TIME};
+            
+            string exit_side = getExitSide(v->current_side, v->direction);
+            logVehicleExit(v->id, v->type, v->current_intersection, exit_side);
+            
+            if (transitToNextIntersection(v, exit_side)) {
+                co_await SleepFor{CROSSING_TIME};
+                exit_side = getExitSide(v->current_side, v->direction);
+                logVehicleExit(v->id, v->type, v->current_intersection, exit_side);
             }
+            final_exit_side = exit_side;
+            
+            endEmergencyCorridor();
+            
+            v->has_exited = true;
             
-            while (emergency_active && !shutdown_flag) {
-                pthread_cond_wait(wait_cond, current_mutex);
+        } else {
+            pthread_mutex_lock(at.mutex);
+            
+            controller->queue.push_back(*v);
+            exportIntersectionLocked(at.index);
+            
+            bool is_ns = (approach == APPROACH_NORTH || approach == APPROACH_SOUTH);
+            int axis = is_ns ? AXIS_NORTH_SOUTH : AXIS_EAST_WEST;
+            
+            if (approachLight(*at.intersection, approach) != LIGHT_GREEN) {
+                pthread_mutex_unlock(at.mutex);
+                logVehicleWaiting(v, approachLight(*at.intersection, approach));
+                requestTransitPriority(v, monotonicNowNs());
+                pthread_mutex_lock(at.mutex);
             }
             
-            if (shutdown_flag) {
-                pthread_mutex_unlock(current_mutex);
-                break;
+            while ((approachLight(*at.intersection, approach) != LIGHT_GREEN || emergencyActive(sim_context)) && !shuttingDown(sim_context)) {
+                co_await LightTurnsGreen{at.index, axis, at.mutex};
             }
             
-            for (auto it = controller->queue.begin(); it != controller->queue.end(); ++it) {
-                if (it->id == v->id) {
-                    controller->queue.erase(it);
-                    break;
-                }
+            if (shuttingDown(sim_context)) {
+                pthread_mutex_unlock(at.mutex);
+                break;
             }
             
-            pthread_mutex_unlock(current_mutex);
+            removeFromQueue(controller, v->id);
+            exportIntersectionLocked(at.index);
+            
+            pthread_mutex_unlock(at.mutex);
             
             logVehicleEntry(v->id, v->type, v->current_intersection, v->current_side);
-            usleep(CROSSING_TIME);
+            co_await SleepFor{CROSSING_TIME};
             
             string exit_side = getExitSide(v->current_side, v->direction);
+            ParkingLot* lot = at.parking;
             
-            // Parking handling
-            if (v->wants_parking && !v->has_exited) {
-                bool parked = tryPark(*current_parking, *v);
+            if (v->wants_parking && !isEmergencyVehicle(v->type)) {
+                bool parked = (sem_trywait(&lot->parking_spots) == 0);
+                bool queued = false;
+                
+                if (!parked && tryJoinWaitQueue(*lot, *v)) {
+                    queued = true;
+                    exportParking(at.index);
+                    parked = co_await ParkingSpotGranted{at.index, &lot->parking_spots, false};
+                    leaveWaitQueue(*lot, v->id);
+                    exportParking(at.index);
+                }
+                
                 if (parked) {
+                    sem_wait(&lot->access_lock);
+                    lot->parked_vehicles.push_back(*v);
+                    sem_post(&lot->access_lock);
+                    exportParking(at.index);
                     logParking(v->id, v->type, v->current_intersection, true);
                     
-                    int park_time = PARKING_MIN_TIME + rand() % (PARKING_MAX_TIME - PARKING_MIN_TIME);
-                    usleep(park_time);
+                    co_await ParkedUntil{&departure_service, lot, monotonicNowNs() + v->park_time * 1000LL};
                     
-                    exitParking(*current_parking, *v);
-                    logParking(v->id, v->type, v->current_intersection, false);
-                } else {
-                    if (tryJoinWaitQueue(*current_parking, *v)) {
-                        usleep(500000);
-                        tryPark(*current_parking, *v);
+                    sem_wait(&lot->access_lock);
+                    for (size_t i = 0; i < lot->parked_vehicles.size(); i++) {
+                        if (lot->parked_vehicles[i].id == v->id) {
+                            lot->parked_vehicles.erase(lot->parked_vehicles.begin() + i);
+                            break;
+                        }
                     }
+                    sem_post(&lot->access_lock);
+                    releaseParkingSpot(at.index, &lot->parking_spots);
+                    exportParking(at.index);
+                    logParking(v->id, v->type, v->current_intersection, false);
+                } else if (queued && shuttingDown(sim_context)) {
+                    break;
                 }
             }
             
             logVehicleExit(v->id, v->type, v->current_intersection, exit_side);
             
-            if (willTransitionToOtherIntersection(v->current_intersection, exit_side)) {
-                string next_int = (v->current_intersection == "F10") ? "F11" : "F10";
-                logVehicleTransit(v->id, v->type, v->current_intersection, next_int);
-                
-                v->current_intersection = next_int;
-                v->current_side = (next_int == "F11") ? "WEST" : "EAST";
-            } else {
+            if (!transitToNextIntersection(v, exit_side)) {
+                final_exit_side = exit_side;
                 v->has_exited = true;
+                continue;
             }
+            
+            // A full link holds the vehicle upstream; retry rather than park a scheduler thread
+            long long blocked_since = 0;
+            while (!shuttingDown(sim_context)) {
+                if (co_await LinkEntered{&inter_links[at.index], v, &blocked_since, false}) break;
+                co_await SleepFor{LINK_RETRY_US};
+            }
+            if (shuttingDown(sim_context)) break;
         }
     }
     
-    if (v->has_exited) {
-        logVehicleComplete(v->id, v->type);
-        
-        pthread_mutex_lock(&stats_mutex);
-        vehicles_completed++;
-        pthread_mutex_unlock(&stats_mutex);
+    finishVehicle(v, final_exit_side);
+}
+#endif
+
+// Micro engine: a vehicle is a row in one of kinematic_engine's lanes, keyed
+// by its pool slot, and moves by car-following instead of CROSSING_TIME sleeps
+KinematicLane& kinematicLaneFor(Vehicle* v) {
+    int index = laneBlockIndex(intersectionIndex(v->current_intersection), sideIndex(v->current_side),
+                               laneForDirection(v->direction));
+    return kinematic_engine.lanes[index];
+}
+
+bool enterKinematicLane(Vehicle* v) {
+    KinematicLane& lane = kinematicLaneFor(v);
+    if (!laneHasEntrySpace(lane)) return false;
+    
+    float length = VEHICLE_LENGTHS[vehicleTypeIndex(v->type)];
+    addLaneVehicle(lane, (uint32_t)(v - vehicle_pool.slots), length, KIN_DESIRED_SPEED,
+                   (uint8_t)directionIndex(v->direction), isEmergencyVehicle(v->type));
+    return true;
+}
+
+void readKinematicLights() {
+    bool green[NUM_INTERSECTIONS][NUM_SIDES];
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        IntersectionBinding at = bindIntersection(INTERSECTION_IDS[i]);
+        pthread_mutex_lock(at.mutex);
+        for (int side = 0; side < NUM_SIDES; side++) {
+            green[i][side] = (approachLight(*at.intersection, side) == LIGHT_GREEN);
+        }
+        pthread_mutex_unlock(at.mutex);
     }
     
-    delete v;
-    return NULL;
+    for (size_t l = 0; l < kinematic_engine.lanes.size(); l++) {
+        KinematicLane& lane = kinematic_engine.lanes[l];
+        lane.green = green[lane.intersection][lane.approach];
+    }
 }
 
-void f10ControllerProcess() {
-    signal(SIGTERM, childSignalHandler);
-    signal(SIGINT, childSignalHandler);
+// Micro mode is both producer and consumer of every link, so it drains them
+// itself instead of running drain threads
+struct LinkDischarge {
+    Vehicle* vehicle;
+    int from;
+    long long blocked_since;
+};
+
+void* kinematicEngineThread(void* arg) {
+    vector<Vehicle*> waiting;    // spawned or transiting, but their lane entry is still occupied
+    vector<Vehicle*> arrivals;
+    vector<LinkDischarge> discharging;    // left the box, link full
+    perfSetThreadRole(PERF_ROLE_MICRO);
     
-    safePrintWithTime("[CONTROLLER] F10 Controller Process started (PID: " + to_string(getpid()) + ")");
+    startKinematicWorkers(kinematic_engine);
     
-    char msg;
-    int cycle = 0;
+    struct timespec next_tick;
+    clock_gettime(CLOCK_MONOTONIC, &next_tick);
     
-    while (!child_shutdown_flag) {
-        ssize_t bytes_read = read(pipe_f11_to_f10[0], &msg, 1);
-        if (bytes_read > 0) {
-            if (msg == MSG_SHUTDOWN) {
-                break;
-            }
-            if (msg == MSG_EMERGENCY_EASTBOUND || msg == MSG_EMERGENCY_WESTBOUND) {
-                safePrintWithTime("[PIPE] F10 received emergency message");
-                usleep(100000);
-                continue;
-            }
+    while (!shuttingDown(sim_context)) {
+        pthread_mutex_lock(&kinematic_inbox_mutex);
+        arrivals.swap(kinematic_inbox);
+        pthread_mutex_unlock(&kinematic_inbox_mutex);
+        
+        for (size_t i = 0; i < arrivals.size(); i++) {
+            logVehicleSpawn(arrivals[i]->id, arrivals[i]->type, arrivals[i]->spawn_intersection,
+                            arrivals[i]->spawn_side, arrivals[i]->direction);
+            waiting.push_back(arrivals[i]);
         }
+        arrivals.clear();
         
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F10: NORTH-SOUTH -> GREEN (cycle " + to_string(++cycle) + ")");
-        write(pipe_f10_to_parent[1], "F10_NS_G", 8);
-        usleep(GREEN_DURATION);
+        long long now = monotonicNowNs();
+        LinkSlot slot;
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+            while (popDueLinkVehicle(inter_links[i], now, slot)) waiting.push_back(slot.vehicle);
+        }
         
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F10: NORTH-SOUTH -> YELLOW");
-        write(pipe_f10_to_parent[1], "F10_NS_Y", 8);
-        usleep(YELLOW_DURATION);
+        size_t kept = 0;
+        for (size_t i = 0; i < discharging.size(); i++) {
+            LinkDischarge& d = discharging[i];
+            LinkSlot entry = {d.vehicle, 0, NULL, NULL};
+            if (!tryEnterLink(inter_links[d.from], entry, d.blocked_since)) discharging[kept++] = d;
+        }
+        discharging.resize(kept);
         
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F10: NORTH-SOUTH -> RED");
-        write(pipe_f10_to_parent[1], "F10_NS_R", 8);
+        kept = 0;
+        for (size_t i = 0; i < waiting.size(); i++) {
+            if (!enterKinematicLane(waiting[i])) waiting[kept++] = waiting[i];
+        }
+        waiting.resize(kept);
         
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F10: EAST-WEST -> GREEN");
-        write(pipe_f10_to_parent[1], "F10_EW_G", 8);
-        usleep(GREEN_DURATION);
+        readKinematicLights();
+        stepKinematicEngine(kinematic_engine);
         
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F10: EAST-WEST -> YELLOW");
-        write(pipe_f10_to_parent[1], "F10_EW_Y", 8);
-        usleep(YELLOW_DURATION);
+        for (size_t l = 0; l < kinematic_engine.lanes.size(); l++) {
+            vector<KinematicExit>& exits = kinematic_engine.lanes[l].exits;
+            for (size_t e = 0; e < exits.size(); e++) {
+                Vehicle* v = &vehicle_pool.slots[exits[e].id];
+                int from = intersectionIndex(v->current_intersection);
+                string exit_side = getExitSide(v->current_side, v->direction);
+                logVehicleExit(v->id, v->type, v->current_intersection, exit_side);
+                
+                if (transitToNextIntersection(v, exit_side)) {
+                    LinkDischarge d = {v, from, 0};
+                    LinkSlot entry = {v, 0, NULL, NULL};
+                    if (!tryEnterLink(inter_links[from], entry, d.blocked_since)) discharging.push_back(d);
+                } else {
+                    v->has_exited = true;
+                    finishVehicle(v, exit_side);
+                }
+            }
+        }
         
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F10: EAST-WEST -> RED");
-        write(pipe_f10_to_parent[1], "F10_EW_R", 8);
+        next_tick.tv_nsec += (long)(KIN_DT * 1e9f);
+        if (next_tick.tv_nsec >= 1000000000) {
+            next_tick.tv_sec++;
+            next_tick.tv_nsec -= 1000000000;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_tick, NULL);
     }
     
-    safePrintWithTime("[CONTROLLER] F10 Controller Process shutting down");
+    stopKinematicWorkers(kinematic_engine);
+    
+    // Whatever is still on the road goes back to the pool unfinished
+    pthread_mutex_lock(&kinematic_inbox_mutex);
+    waiting.insert(waiting.end(), kinematic_inbox.begin(), kinematic_inbox.end());
+    kinematic_inbox.clear();
+    pthread_mutex_unlock(&kinematic_inbox_mutex);
+    
+    for (size_t l = 0; l < kinematic_engine.lanes.size(); l++) {
+        KinematicLane& lane = kinematic_engine.lanes[l];
+        for (size_t i = lane.head; i < lane.id.size(); i++) {
+            waiting.push_back(&vehicle_pool.slots[lane.id[i]]);
+        }
+    }
+    for (size_t i = 0; i < discharging.size(); i++) {
+        waiting.push_back(discharging[i].vehicle);
+    }
+    LinkSlot slot;
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        while (popDueLinkVehicle(inter_links[i], monotonicNowNs(), slot)) waiting.push_back(slot.vehicle);
+    }
+    for (size_t i = 0; i < waiting.size(); i++) {
+        finishVehicle(waiting[i], "NONE");
+    }
+    return NULL;
 }
 
-void f11ControllerProcess() {
-    signal(SIGTERM, childSignalHandler);
-    signal(SIGINT, childSignalHandler);
+// --predictive: hands a green start to the planner; a newer one replaces it
+void postLookahead(int index, int step, long long start_ns) {
+    pthread_mutex_lock(&lookahead_lock);
+    lookahead_requests[index].pending = true;
+    lookahead_requests[index].step = step;
+    lookahead_requests[index].start_ns = start_ns;
+    pthread_cond_signal(&lookahead_wake);
+    pthread_mutex_unlock(&lookahead_lock);
+}
+
+// Applies a published light state and wakes whoever it turned green for. Runs
+// on the listener thread, or on the controller's own thread with
+// --controllers thread; either way under the intersection's mutex.
+void deliverLightState(const LightStateMessage& msg, void* ctx) {
+    int i = msg.intersection;
+    IntersectionBinding at = bindIntersection(INTERSECTION_IDS[i]);
+    pthread_mutex_lock(at.mutex);
+    uint8_t turned_green = applyLightState(*at.intersection, published_lights[i], msg.lights);
+    published_lights[i] = msg.lights;
+    exportIntersectionLocked(i);
+    if (turned_green & (MOVE_NORTH | MOVE_SOUTH)) {
+        pthread_cond_broadcast(at.ns_cond);
+        notifyGreenWaiters(i, AXIS_NORTH_SOUTH);
+    }
+    if (turned_green & (MOVE_EAST | MOVE_WEST)) {
+        pthread_cond_broadcast(at.ew_cond);
+        notifyGreenWaiters(i, AXIS_EAST_WEST);
+    }
+    pthread_mutex_unlock(at.mutex);
     
-    safePrintWithTime("[CONTROLLER] F11 Controller Process started (PID: " + to_string(getpid()) + ")");
+    if (sim_options.predictive && turned_green != 0 && msg.step < signal_plans[i].steps.size()
+        && signal_plans[i].steps[msg.step].green_movements != 0) {
+        postLookahead(i, msg.step, msg.sent_ns);
+    }
     
-    char msg;
-    int cycle = 0;
+    // One delivering thread per intersection, so these need no lock
+    recordLatency(light_notify_latency[i], monotonicNowNs() - msg.sent_ns);
+    if (msg.due_ns != 0) {
+        recordLatency(phase_start_error[i], msg.sent_ns - msg.due_ns);
+        recordDrift(phase_drift[i], msg.sent_ns, msg.sent_ns - msg.due_ns);
+    }
+}
+
+// Each controller reads the pipe its peer's requests arrive on
+int controllerReadFd(int index) {
+    return (index == 0) ? pipe_f11_to_f10[0] : pipe_f10_to_f11[0];
+}
+
+// The same controller body runs in a forked process or an in-process thread
+void runController(int index, const SignalControllerIO& io) {
+    const CompiledSignalPlan& plan = signal_plans[index];
+    const string& id = INTERSECTION_IDS[index];
     
-    while (!child_shutdown_flag) {
-        ssize_t bytes_read = read(pipe_f10_to_f11[0], &msg, 1);
-        if (bytes_read > 0) {
-            if (msg == MSG_SHUTDOWN) {
-                break;
-            }
-            if (msg == MSG_EMERGENCY_EASTBOUND || msg == MSG_EMERGENCY_WESTBOUND) {
-                safePrintWithTime("[PIPE] F11 received emergency message");
-                usleep(100000);
-                continue;
-            }
+    if (cpu_placement.applied) LOG_INFO("[CONTROLLER] ", id, " pinned to CPUs ", currentThreadCpus());
+    if (sim_options.rt_priority > 0) {
+        if (applyRealtimePriority(sim_options.rt_priority)) {
+            LOG_INFO("[CONTROLLER] ", id, " running SCHED_FIFO priority ", sim_options.rt_priority);
+        } else {
+            LOG_WARN("[CONTROLLER] ", id, " could not switch to SCHED_FIFO (", strerror(errno),
+                     "), staying SCHED_OTHER");
         }
+    }
+    
+    LatencyHistogram reaction[NUM_CONTROL_KINDS];
+    for (int k = 0; k < NUM_CONTROL_KINDS; k++) resetLatencyHistogram(reaction[k]);
+    TransitPriorityState tsp;
+    resetTransitPriority(tsp);
+    PeerReaderStats peer;
+    memset(&peer, 0, sizeof(peer));
+    PlanDecisionStats decisions;
+    memset(&decisions, 0, sizeof(decisions));
+    
+    long long reference_ns = (signal_reference_ns != 0) ? signal_reference_ns : monotonicNowNs();
+    runSignalController(plan, io, reference_ns, reaction, tsp, peer, decisions);
+    
+    LOG_INFO("[CONTROLLER] ", id, " Controller ", (io.wake_fd >= 0) ? "Process" : "thread", " shutting down");
+    printControllerReactionReport(id, reaction);
+    printPeerReaderReport(id, peer);
+    printPlanDecisionReport(id, decisions);
+    printTransitPriorityReport(id, tsp);
+}
+
+void signalControllerProcess(int index, const LightChannel& publish) {
+    // Blocked shutdown signals are inherited; this process reads its own copy
+    SignalControllerIO io = {publish, controllerReadFd(index), openShutdownSignalFd()};
+    LOG_INFO("[CONTROLLER] ", INTERSECTION_IDS[index], " Controller Process started (PID: ", getpid(), ")");
+    runController(index, io);
+    close(io.wake_fd);
+}
+
+// --controllers thread: publishing a light state is a call to deliverLightState
+void* signalControllerThread(void* arg) {
+    int index = (int)(intptr_t)arg;
+    applyControlPlacement(cpu_placement);
+    if (index == 0) listener_cpus = currentThreadCpus();
+    
+    // Stopped by MSG_SHUTDOWN on its peer pipe: the process's signalfd belongs to the main thread
+    SignalControllerIO io = {directLightChannel(deliverLightState, NULL, NULL), controllerReadFd(index), -1};
+    LOG_INFO("[CONTROLLER] ", INTERSECTION_IDS[index], " Controller thread started");
+    runController(index, io);
+    return NULL;
+}
+
+void startControllers(int transport) {
+    int* publish_pipes[NUM_INTERSECTIONS] = {pipe_f10_to_parent, pipe_f11_to_parent};
+    light_listener.transport = transport;
+    light_listener.mailbox = light_mailbox;
+    light_listener.stats = NULL;
+    
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        const string& id = INTERSECTION_IDS[i];
+        light_listener.fds[i] = publish_pipes[i][0];
         
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F11: NORTH-SOUTH -> GREEN (cycle " + to_string(++cycle) + ")");
-        write(pipe_f11_to_parent[1], "F11_NS_G", 8);
-        usleep(GREEN_DURATION);
-        
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F11: NORTH-SOUTH -> YELLOW");
-        write(pipe_f11_to_parent[1], "F11_NS_Y", 8);
-        usleep(YELLOW_DURATION);
-        
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F11: NORTH-SOUTH -> RED");
-        write(pipe_f11_to_parent[1], "F11_NS_R", 8);
+        if (transport == TRANSPORT_THREAD) {
+            pthread_create(&controller_tids[i], NULL, signalControllerThread, (void*)(intptr_t)i);
+            LOG_INFO("[PARENT] Started ", id, " controller thread");
+            continue;
+        }
         
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F11: EAST-WEST -> GREEN");
-        write(pipe_f11_to_parent[1], "F11_EW_G", 8);
-        usleep(GREEN_DURATION);
+        // Anything still buffered would be written again by each child
+        fflush(stdout);
+        pid_t pid = fork();
         
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F11: EAST-WEST -> YELLOW");
-        write(pipe_f11_to_parent[1], "F11_EW_Y", 8);
-        usleep(YELLOW_DURATION);
+        if (pid < 0) {
+            perror(("Failed to fork " + id + " controller process").c_str());
+            for (int k = 0; k < i; k++) kill(controller_pids[k], SIGTERM);
+            exit(1);
+        } else if (pid == 0) {
+            close(shutdown_signal_fd);
+            close(shutdown_wake_fd);
+            for (int k = 0; k < NUM_INTERSECTIONS; k++) {
+                close((k == i) ? controllerRequestFd(k) : controllerReadFd(k));
+                close(publish_pipes[k][0]);
+                if (k != i) close(publish_pipes[k][1]);
+            }
+            applyControlPlacement(cpu_placement);
+            LightChannel publish = (transport == TRANSPORT_SHM) ? shmLightChannel(light_mailbox, i, NULL)
+                                                                : pipeLightChannel(publish_pipes[i][1], NULL);
+            signalControllerProcess(i, publish);
+            exit(0);
+        }
         
-        if (child_shutdown_flag) break;
-        safePrintWithTime("[LIGHT] F11: EAST-WEST -> RED");
-        write(pipe_f11_to_parent[1], "F11_EW_R", 8);
+        controller_pids[i] = pid;
+        LOG_INFO("[PARENT] Spawned ", id, " controller process (PID: ", pid, ")");
+    }
+    
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) close(publish_pipes[i][1]);
+}
+
+void stopControllers(int transport) {
+    if (transport == TRANSPORT_THREAD) {
+        LOG_INFO("[PARENT] Stopping controller threads...");
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) sendToController(peer_outboxes[i], MSG_SHUTDOWN);
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+            pthread_join(controller_tids[i], NULL);
+            LOG_INFO("[PARENT] ", INTERSECTION_IDS[i], " controller thread stopped");
+        }
+        return;
     }
     
-    safePrintWithTime("[CONTROLLER] F11 Controller Process shutting down");
+    LOG_INFO("[PARENT] Terminating controller processes...");
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) sendShutdownSignal(controller_pids[i]);
+    
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        int status;
+        waitpid(controller_pids[i], &status, 0);
+        LOG_INFO("[PARENT] ", INTERSECTION_IDS[i], " controller process terminated");
+    }
+}
+
+
+// Lights, queue sizes and emergency modes come from the published views, so
+// the dashboard never takes an intersection lock
+void captureStateSnapshot(StateSnapshot& s) {
+    s.taken_ns = monotonicNowNs();
+    
+    {
+        ViewReadSection read(views);
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+            const IntersectionView& view = read.intersection(i);
+            for (int side = 0; side < NUM_SIDES; side++) {
+                s.intersections[i].lights[side] = view.lights[side];
+                s.intersections[i].queued[side] = viewQueueLength(view, side);
+            }
+            s.intersections[i].emergency_mode = view.emergency_mode;
+        }
+    }
+    s.emergency = (uint8_t)emergencyState(sim_context);
+    
+    snapshotParkingLot(parking_f10, s.parking[0]);
+    snapshotParkingLot(parking_f11, s.parking[1]);
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) snapshotLink(inter_links[i], s);
+    snapshotLatch(completion_latch, s);
+}
+
+// How late each transition was published against its absolute deadline;
+// emergency holds are excluded since they delay the plan on purpose
+void printPhaseTimingReport() {
+    string scheduling = (sim_options.rt_priority > 0) ? "SCHED_FIFO " + to_string(sim_options.rt_priority) + " requested"
+                                                      : "SCHED_OTHER";
+    cout << ("Phase Timing (absolute deadlines, " + scheduling + "):\n");
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        printLatencySummary(INTERSECTION_IDS[i] + " phase start error", phase_start_error[i]);
+        printLatencyBuckets(phase_start_error[i]);
+        printDriftTrack(phase_drift[i]);
+    }
 }
 
 void* lightStateListenerThread(void* arg) {
-    char buffer[16];
-    fd_set read_fds;
-    struct timeval timeout;
-    
-    while (!shutdown_flag) {
-        FD_ZERO(&read_fds);
-        FD_SET(pipe_f10_to_parent[0], &read_fds);
-        FD_SET(pipe_f11_to_parent[0], &read_fds);
-        
-        int max_fd = (pipe_f10_to_parent[0] > pipe_f11_to_parent[0]) ? pipe_f10_to_parent[0] : pipe_f11_to_parent[0];
+    LightStateMessage batch[LIGHT_RECEIVE_BATCH];
+    perfSetThreadRole(PERF_ROLE_LISTENER);
+    applyControlPlacement(cpu_placement);
+    listener_cpus = currentThreadCpus();
+    
+    while (!shuttingDown(sim_context)) {
+        int received = receiveLightStates(light_listener, batch, LIGHT_RECEIVE_BATCH, 100);
+        for (int k = 0; k < received; k++) deliverLightState(batch[k], NULL);
+    }
+    
+    return NULL;
+}
+
+void generateRandomArrival(ArrivalRecord& rec) {
+    memset(&rec, 0, sizeof(rec));
+    
+    bool is_emergency = (rand() % 10 == 0);
+    
+    if (is_emergency) {
+        rec.type = vehicleTypeIndex((rand() % 2 == 0) ? "Ambulance" : "Firetruck");
+        rec.direction = directionIndex("STRAIGHT");
         
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 100000;
+        if (rand() % 2 == 0) {
+            rec.intersection = intersectionIndex("F10");
+            rec.side = sideIndex("WEST");
+        } else {
+            rec.intersection = intersectionIndex("F11");
+            rec.side = sideIndex("EAST");
+        }
+        rec.wants_parking = 0;
+    } else {
+        rec.type = vehicleTypeIndex(getRandomVehicleType());
+        rec.intersection = rand() % 2;
+        rec.side = rand() % 4;
         
-        int ready = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
+        int dir = rand() % 3;
+        switch (dir) {
+            case 0: rec.direction = directionIndex("LEFT"); break;
+            case 1: rec.direction = directionIndex("RIGHT"); break;
+            default: rec.direction = directionIndex("STRAIGHT"); break;
+        }
         
-        if (ready > 0) {
-            if (FD_ISSET(pipe_f10_to_parent[0], &read_fds)) {
-                ssize_t n = read(pipe_f10_to_parent[0], buffer, 8);
-                if (n == 8) {
-                    buffer[n] = '\0';
-                    string msg(buffer);
-                    
-                    pthread_mutex_lock(&f10_mutex);
-                    if (msg == "F10_NS_G") {
-                        intersection_f10.north_controller.light_state = "GREEN";
-                        intersection_f10.south_controller.light_state = "GREEN";
-                        intersection_f10.east_controller.light_state = "RED";
-                        intersection_f10.west_controller.light_state = "RED";
-                        pthread_cond_broadcast(&f10_north_south_cond);
-                    } else if (msg == "F10_NS_Y") {
-                        intersection_f10.north_controller.light_state = "YELLOW";
-                        intersection_f10.south_controller.light_state = "YELLOW";
-                    } else if (msg == "F10_NS_R") {
-                        intersection_f10.north_controller.light_state = "RED";
-                        intersection_f10.south_controller.light_state = "RED";
-                    } else if (msg == "F10_EW_G") {
-                        intersection_f10.east_controller.light_state = "GREEN";
-                        intersection_f10.west_controller.light_state = "GREEN";
-                        intersection_f10.north_controller.light_state = "RED";
-                        intersection_f10.south_controller.light_state = "RED";
-                        pthread_cond_broadcast(&f10_east_west_cond);
-                    } else if (msg == "F10_EW_Y") {
-                        intersection_f10.east_controller.light_state = "YELLOW";
-                        intersection_f10.west_controller.light_state = "YELLOW";
-                    } else if (msg == "F10_EW_R") {
-                        intersection_f10.east_controller.light_state = "RED";
-                        intersection_f10.west_controller.light_state = "RED";
-                    }
-                    pthread_mutex_unlock(&f10_mutex);
-                }
-            }
-            
-            if (FD_ISSET(pipe_f11_to_parent[0], &read_fds)) {
-                ssize_t n = read(pipe_f11_to_parent[0], buffer, 8);
-                if (n == 8) {
-                    buffer[n] = '\0';
-                    string msg(buffer);
-                    
-                    pthread_mutex_lock(&f11_mutex);
-                    if (msg == "F11_NS_G") {
-                        intersection_f11.north_controller.light_state = "GREEN";
-                        intersection_f11.south_controller.light_state = "GREEN";
-                        intersection_f11.east_controller.light_state = "RED";
-                        intersection_f11.west_controller.light_state = "RED";
-                        pthread_cond_broadcast(&f11_north_south_cond);
-                    } else if (msg == "F11_NS_Y") {
-                        intersection_f11.north_controller.light_state = "YELLOW";
-                        intersection_f11.south_controller.light_state = "YELLOW";
-                    } else if (msg == "F11_NS_R") {
-                        intersection_f11.north_controller.light_state = "RED";
-                        intersection_f11.south_controller.light_state = "RED";
-                    } else if (msg == "F11_EW_G") {
-                        intersection_f11.east_controller.light_state = "GREEN";
-                        intersection_f11.west_controller.light_state = "GREEN";
-                        intersection_f11.north_controller.light_state = "RED";
-                        intersection_f11.south_controller.light_state = "RED";
-                        pthread_cond_broadcast(&f11_east_west_cond);
-                    } else if (msg == "F11_EW_Y") {
-                        intersection_f11.east_controller.light_state = "YELLOW";
-                        intersection_f11.west_controller.light_state = "YELLOW";
-                    } else if (msg == "F11_EW_R") {
-                        intersection_f11.east_controller.light_state = "RED";
-                        intersection_f11.west_controller.light_state = "RED";
-                    }
-                    pthread_mutex_unlock(&f11_mutex);
-                }
-            }
+        rec.wants_parking = (rand() % 10 < 3);
+    }
+    
+    rec.park_time_ms = (PARKING_MIN_TIME + rand() % (PARKING_MAX_TIME - PARKING_MIN_TIME)) / 1000;
+}
+
+// Runs in the lookahead snapshot, a single-threaded copy of this process. It
+// reads the queues and links as they were at the fork and draws the
+// spawner's next arrivals from its own copy of the generator, but must not
+// lock, log or touch stdio.
+void gatherLookaheadArrivals(int index, long long now_ns, vector<TransitArrival>& out) {
+    long long horizon_ns = now_ns + LOOKAHEAD_HORIZON_US * 1000;
+    IntersectionBinding at = bindIntersection(INTERSECTION_IDS[index]);
+    for (int approach = 0; approach < NUM_SIDES; approach++) {
+        for (const Vehicle& q : getController(*at.intersection, approach).queue) {
+            if (q.priority == "HIGH") continue;
+            TransitArrival a = {now_ns, approach, q.priority == "MEDIUM"};
+            out.push_back(a);
+        }
+    }
+    
+    for (int l = 0; l < NUM_INTERSECTIONS; l++) {
+        const InterLink& link = inter_links[l];
+        if (link.to != index || link.capacity == 0) continue;
+        for (uint32_t k = link.head.load(); k != link.tail.load(); k++) {
+            const Vehicle* v = link.ring[k % link.capacity].vehicle;
+            if (v->priority == "HIGH") continue;
+            TransitArrival a = {max(link.ring[k % link.capacity].arrive_ns, now_ns), approachOf(v->current_side),
+                                v->priority == "MEDIUM"};
+            out.push_back(a);
         }
     }
     
+    // The spawner's pending arrival, then the same draws, in the same order, as its next spawns
+    int entry_side = approachOf((INTERSECTION_IDS[index] == "F11") ? "WEST" : "EAST");
+    auto project = [&](const ArrivalRecord& rec, long long t) {
+        string type = VEHICLE_TYPES[rec.type];
+        if (isEmergencyVehicle(type)) return;
+        TransitArrival a = {t, rec.side, type == "Bus"};
+        if (rec.intersection == index) {
+            out.push_back(a);
+        } else if (willTransitionToOtherIntersection(INTERSECTION_IDS[rec.intersection],
+                                                     getExitSide(SPAWN_SIDES[rec.side], DIRECTIONS[rec.direction]))) {
+            a.arrive_ns = t + (long long)(CROSSING_TIME + LINK_TRAVEL_TIME) * 1000;
+            a.approach = entry_side;
+            out.push_back(a);
+        }
+    };
+    int left = totalVehicles(sim_context) - run_outcome.spawned;
+    long long t = pending_arrival.due_ns;
+    if (pending_arrival.valid && left > 0) {
+        project(pending_arrival.rec, max(t, now_ns));
+        left--;
+    } else {
+        left = 0;
+    }
+    if (demand_driven) {
+        // What the spawner has buffered, then the generator's own continuation
+        const DemandSchedule& s = demand_schedule;
+        for (int k = s.next; k < s.count && left > 0; k++, left--) {
+            long long due_ns = s.start_ns + (long long)s.batch[k].time_ms * 1000000;
+            if (due_ns >= horizon_ns) break;
+            project(s.batch[k], max(due_ns, now_ns));
+        }
+        DemandGenerator g = s.generator;
+        for (; left > 0; left--) {
+            ArrivalRecord rec;
+            generateDemandArrival(g, rec);
+            long long due_ns = s.start_ns + (long long)rec.time_ms * 1000000;
+            if (due_ns >= horizon_ns) break;
+            project(rec, max(due_ns, now_ns));
+        }
+    } else {
+        for (; left > 0 && t < horizon_ns; left--) {
+            t += (long long)(SPAWN_MIN_DELAY + rand() % (SPAWN_MAX_DELAY - SPAWN_MIN_DELAY)) * 1000;
+            ArrivalRecord rec;
+            generateRandomArrival(rec);
+            project(rec, max(t, now_ns));
+        }
+    }
+    
+    size_t kept = 0;
+    for (size_t k = 0; k < out.size(); k++) {
+        if (out[k].arrive_ns < horizon_ns) out[kept++] = out[k];
+    }
+    out.resize(kept);
+    stable_sort(out.begin(), out.end(),
+                [](const TransitArrival& a, const TransitArrival& b) { return a.arrive_ns < b.arrive_ns; });
+}
+
+// One decision for the green step of `index` that started at start_ns
+void runLookahead(int index, int step, long long start_ns) {
+    const string& id = INTERSECTION_IDS[index];
+    int done[2];
+    if (pipe(done) < 0) {
+        lookahead_stats.failures++;
+        return;
+    }
+    memset(lookahead_results, 0, sizeof(*lookahead_results));
+    
+    // Held across the fork, so the snapshot sees both intersections and the
+    // spawner between updates
+    long long pause_start = monotonicNowNs();
+    pthread_mutex_lock(&spawner_lock);
+    pthread_mutex_lock(&f10_mutex);
+    pthread_mutex_lock(&f11_mutex);
+    pid_t snapshot = fork();
+    if (snapshot == 0) {
+        close(done[0]);
+        vector<TransitArrival> arrivals;
+        long long now_ns = monotonicNowNs();
+        gatherLookaheadArrivals(index, now_ns, arrivals);
+        evaluateLookaheadPlans(signal_plans[index], step, start_ns, now_ns, arrivals, *lookahead_results);
+        _exit(0);
+    }
+    pthread_mutex_unlock(&f11_mutex);
+    pthread_mutex_unlock(&f10_mutex);
+    pthread_mutex_unlock(&spawner_lock);
+    recordLatency(lookahead_stats.fork_pause, monotonicNowNs() - pause_start);
+    close(done[1]);
+    
+    if (snapshot < 0) {
+        close(done[0]);
+        lookahead_stats.failures++;
+        return;
+    }
+    bool finished = awaitLookahead(snapshot, done[0]);
+    close(done[0]);
+    if (!finished) {
+        lookahead_stats.timeouts++;
+        LOG_WARN("[PREDICT] ", id, " lookahead timed out; keeping the plan");
+        return;
+    }
+    
+    const LookaheadResults& r = *lookahead_results;
+    double saved_s;
+    int choice = chooseLookaheadPlan(r, saved_s);
+    sendPlanDecision(peer_outboxes[index], choice, step);
+    
+    lookahead_stats.decisions++;
+    lookahead_stats.chosen[choice]++;
+    lookahead_stats.vehicles += r.vehicles;
+    lookahead_stats.saved_s += saved_s;
+    recordLatency(lookahead_stats.turnaround, monotonicNowNs() - start_ns);
+    
+    char projected[128];
+    snprintf(projected, sizeof(projected), "keep %.1f, extend %.1f, switch %.1f, skip %.1f vehicle-s",
+             r.delay_s[LOOKAHEAD_KEEP], r.delay_s[LOOKAHEAD_EXTEND], r.delay_s[LOOKAHEAD_SWITCH_NOW],
+             r.delay_s[LOOKAHEAD_SKIP_NEXT]);
+    LOG_DEBUG("[PREDICT] ", id, ": ", r.vehicles, " vehicles projected, ", projected, " -> ", LOOKAHEAD_PLAN_NAMES[choice]);
+}
+
+void* lookaheadPlannerThread(void* arg) {
+    pthread_mutex_lock(&lookahead_lock);
+    while (!shuttingDown(sim_context)) {
+        int index = -1;
+        for (int i = 0; i < NUM_INTERSECTIONS && index < 0; i++) {
+            if (lookahead_requests[i].pending) index = i;
+        }
+        if (index < 0) {
+            pthread_cond_wait(&lookahead_wake, &lookahead_lock);
+            continue;
+        }
+        LookaheadRequest request = lookahead_requests[index];
+        lookahead_requests[index].pending = false;
+        pthread_mutex_unlock(&lookahead_lock);
+        runLookahead(index, request.step, request.start_ns);
+        pthread_mutex_lock(&lookahead_lock);
+    }
+    pthread_mutex_unlock(&lookahead_lock);
     return NULL;
 }
 
+bool spawnVehicle(const ArrivalRecord& rec) {
+    PerfRegion perf(PERF_SPAWN);
+    // Blocks while every pool slot is in use, which is the spawner's backpressure
+    Vehicle* v = acquireVehicle(vehicle_pool);
+    if (v == NULL) return false;
+    armLatch(completion_latch);
+    exportCounters();
+    
+    v->id = allocateVehicleId(sim_context);
+    
+    applyArrival(*v, rec);
+    
+    if (use_kinematics) {
+        pthread_mutex_lock(&kinematic_inbox_mutex);
+        kinematic_inbox.push_back(v);
+        pthread_mutex_unlock(&kinematic_inbox_mutex);
+        return true;
+    }
+    
+#if CORO_ENGINE_AVAILABLE
+    if (use_coroutines) {
+        startVehicleTask(vehicleCoroutine(v));
+        return true;
+    }
+#endif
+    
+    pthread_t tid;
+    if (pthread_create(&tid, &vehicle_thread_attr, vehicleThread, (void*)v) == 0) {
+        return true;
+    }
+    
+    disarmLatch(completion_latch);
+    exportCounters();
+    releaseVehicle(vehicle_pool, v);
+    LOG_WARN("ERROR: Failed to create vehicle thread");
+    return false;
+}
+
 void* vehicleSpawnerThread(void* arg) {
+    perfSetThreadRole(PERF_ROLE_SPAWNER);
     int spawned = 0;
+    bool replaying = (workload_replay.file != NULL);
     
-    while (spawned < total_vehicles_to_spawn && !shutdown_flag) {
-        Vehicle* v = new Vehicle();
-        
-        pthread_mutex_lock(&vehicle_mutex);
-        v->id = next_vehicle_id++;
-        pthread_mutex_unlock(&vehicle_mutex);
-        
-        bool is_emergency = (rand() % 10 == 0);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long long start_ns = (long long)start.tv_sec * 1000000000LL + start.tv_nsec;
+    bool generating = !feeding && !replaying && !demand_driven;
+    
+    // The random generator draws each arrival, then the delay before the
+    // next, so the arrival after the delay is drawn (and pending) up front
+    pthread_mutex_lock(&spawner_lock);
+    demand_schedule.start_ns = start_ns;
+    if (generating) {
+        generateRandomArrival(pending_arrival.rec);
+        pending_arrival.due_ns = start_ns;
+        pending_arrival.valid = true;
+    }
+    pthread_mutex_unlock(&spawner_lock);
+    
+    while ((feeding || spawned < totalVehicles(sim_context)) && !shuttingDown(sim_context)) {
+        ArrivalRecord rec;
         
-        if (is_emergency) {
-            v->type = (rand() % 2 == 0) ? "Ambulance" : "Firetruck";
-            v->priority = "HIGH";
-            v->direction = "STRAIGHT";
-            
-            if (rand() % 2 == 0) {
-                v->spawn_intersection = "F10";
-                v->spawn_side = "WEST";
-            } else {
-                v->spawn_intersection = "F11";
-                v->spawn_side = "EAST";
-            }
-            v->wants_parking = false;
+        if (feeding) {
+            if (!popArrival(arrival_feed, rec)) break;
+            sleepUntilOffset(start, rec.time_ms);
+        } else if (replaying) {
+            if (!readArrival(workload_replay, rec)) break;
+            sleepUntilOffset(start, rec.time_ms);
+        } else if (demand_driven) {
+            pthread_mutex_lock(&spawner_lock);
+            nextDemandArrival(demand_schedule, rec);
+            pending_arrival.rec = rec;
+            pending_arrival.due_ns = start_ns + (long long)rec.time_ms * 1000000;
+            pending_arrival.valid = true;
+            pthread_mutex_unlock(&spawner_lock);
+            sleepUntilOffset(start, rec.time_ms);
         } else {
-            v->type = getRandomVehicleType();
-            v->priority = (v->type == "Bus") ? "MEDIUM" : "LOW";
-            
-            v->spawn_intersection = (rand() % 2 == 0) ? "F10" : "F11";
-            
-            int side = rand() % 4;
-            switch (side) {
-                case 0: v->spawn_side = "NORTH"; break;
-                case 1: v->spawn_side = "SOUTH"; break;
-                case 2: v->spawn_side = "EAST"; break;
-                default: v->spawn_side = "WEST"; break;
-            }
-            
-            int dir = rand() % 3;
-            switch (dir) {
-                case 0: v->direction = "LEFT"; break;
-                case 1: v->direction = "RIGHT"; break;
-                default: v->direction = "STRAIGHT"; break;
-            }
-            
-            v->wants_parking = (rand() % 10 < 3);
+            rec = pending_arrival.rec;
+            rec.time_ms = elapsedMs(start);
         }
         
-        v->current_intersection = v->spawn_intersection;
-        v->current_side = v->spawn_side;
-        v->has_exited = false;
-        
-        pthread_t tid;
-        if (pthread_create(&tid, NULL, vehicleThread, (void*)v) == 0) {
-            vehicle_threads.push_back(tid);
-            spawned++;
-        } else {
-            delete v;
-            safePrintWithTime("ERROR: Failed to create vehicle thread");
+        // Held across the spawn so a lookahead never sees the vehicle both
+        // queued and still pending
+        pthread_mutex_lock(&spawner_lock);
+        if (!spawnVehicle(rec)) {
+            pthread_mutex_unlock(&spawner_lock);
+            if (shuttingDown(sim_context)) break;
+            continue;
         }
+        spawned++;
         
-        int delay = SPAWN_MIN_DELAY + rand() % (SPAWN_MAX_DELAY - SPAWN_MIN_DELAY);
-        usleep(delay);
+        int delay = 0;
+        pending_arrival.valid = false;
+        run_outcome.spawned++;
+        run_outcome.arrival_digest = updateArrivalDigest(run_outcome.arrival_digest, rec);
+        if (generating) {
+            delay = SPAWN_MIN_DELAY + rand() % (SPAWN_MAX_DELAY - SPAWN_MIN_DELAY);
+            generateRandomArrival(pending_arrival.rec);
+            pending_arrival.due_ns = monotonicNowNs() + delay * 1000LL;
+            pending_arrival.valid = true;
+        }
+        pthread_mutex_unlock(&spawner_lock);
+        recordArrival(workload_recorder, rec);
+        if (delay > 0) usleep(delay);
     }
     
-    safePrintWithTime("SPAWNER: All vehicles spawned");
+    pthread_mutex_lock(&spawner_lock);
+    pending_arrival.valid = false;
+    pthread_mutex_unlock(&spawner_lock);
+    
+    setTotalVehicles(sim_context, spawned);
+    sealLatch(completion_latch);
+    
+    LOG_INFO("SPAWNER: All vehicles spawned");
     return NULL;
 }
 
+// Readers find a view from the start
 void initializeIntersections() {
-    intersection_f10.id = "F10";
-    intersection_f10.north_controller.side = "NORTH";
-    intersection_f10.north_controller.light_state = "RED";
-    intersection_f10.south_controller.side = "SOUTH";
-    intersection_f10.south_controller.light_state = "RED";
-    intersection_f10.east_controller.side = "EAST";
-    intersection_f10.east_controller.light_state = "RED";
-    intersection_f10.west_controller.side = "WEST";
-    intersection_f10.west_controller.light_state = "RED";
-    intersection_f10.emergency_mode = false;
-    
-    intersection_f11.id = "F11";
-    intersection_f11.north_controller.side = "NORTH";
-    intersection_f11.north_controller.light_state = "RED";
-    intersection_f11.south_controller.side = "SOUTH";
-    intersection_f11.south_controller.light_state = "RED";
-    intersection_f11.east_controller.side = "EAST";
-    intersection_f11.east_controller.light_state = "RED";
-    intersection_f11.west_controller.side = "WEST";
-    intersection_f11.west_controller.light_state = "RED";
-    intersection_f11.emergency_mode = false;
+    initIntersection(intersection_f10, "F10");
+    initIntersection(intersection_f11, "F11");
+    initViewDomain(views);
+    publishIntersectionView(views, 0, intersection_f10);
+    publishIntersectionView(views, 1, intersection_f11);
 }
 
 void initializeParkingLots() {
     initParkingLot(parking_f10, "F10_Parking");
     initParkingLot(parking_f11, "F11_Parking");
+    publishParkingView(views, 0, parking_f10);
+    publishParkingView(views, 1, parking_f11);
+    ParkingLot* lots[NUM_INTERSECTIONS] = {&parking_f10, &parking_f11};
+    initDepartureService(departure_service, lots, NUM_INTERSECTIONS);
 }
 
 void initializePipes() {
@@ -576,6 +1396,12 @@ void initializePipes() {
     
     fcntl(pipe_f10_to_f11[0], F_SETFL, O_NONBLOCK);
     fcntl(pipe_f11_to_f10[0], F_SETFL, O_NONBLOCK);
+    // Vehicle threads write these; a busy or exited controller must not stall or kill them
+    fcntl(pipe_f10_to_f11[1], F_SETFL, O_NONBLOCK);
+    fcntl(pipe_f11_to_f10[1], F_SETFL, O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+    
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) initPeerOutbox(peer_outboxes[i], controllerRequestFd(i), PEER_SOURCE_SIMULATOR);
 }
 
 void cleanup() {
@@ -590,12 +1416,16 @@ void cleanup() {
     
     destroyParkingLot(parking_f10);
     destroyParkingLot(parking_f11);
+    destroyDepartureService(departure_service);
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) destroyPeerOutbox(peer_outboxes[i]);
+    if (light_mailbox != NULL) destroyLightMailbox(light_mailbox);
+    if (lookahead_results != NULL) destroyLookaheadResults(lookahead_results);
     
     pthread_mutex_destroy(&console_mutex);
-    pthread_mutex_destroy(&vehicle_mutex);
     pthread_mutex_destroy(&f10_mutex);
     pthread_mutex_destroy(&f11_mutex);
     pthread_mutex_destroy(&stats_mutex);
+    pthread_mutex_destroy(&kinematic_inbox_mutex);
     
     pthread_cond_destroy(&f10_north_south_cond);
     pthread_cond_destroy(&f10_east_west_cond);
@@ -604,119 +1434,359 @@ void cleanup() {
 }
 
 int main(int argc, char* argv[]) {
-    srand(time(NULL));
+    if (!parseOptions(argc, argv, sim_options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    initPerfCounters(sim_options.perf);
     
-    if (argc > 1) {
-        total_vehicles_to_spawn = atoi(argv[1]);
-        if (total_vehicles_to_spawn <= 0) {
-            total_vehicles_to_spawn = DEFAULT_VEHICLE_COUNT;
+    if (!sim_options.bench_name.empty()) {
+        int bench_code;
+        if (sim_options.bench_name == "ingest") {
+            bench_code = runIngestBenchmark(sim_options.feed_path);
+        } else if (sim_options.bench_name == "corridor") {
+            bench_code = runCorridorBenchmark(sim_options.vehicle_count, sim_options.seed);
+        } else if (sim_options.bench_name == "transit") {
+            bench_code = runTransitBenchmark(sim_options.vehicle_count, sim_options.seed);
+        } else if (sim_options.bench_name == "transport") {
+            bench_code = runTransportBenchmark();
+        } else if (sim_options.bench_name == "demand") {
+            bench_code = runDemandBenchmark(sim_options.seed);
+        } else if (sim_options.bench_name == "kinematics") {
+            bench_code = runKinematicsBenchmark(sim_options.vehicle_count, sim_options.scheduler_threads);
+        } else {
+            cerr << ("Unknown benchmark: " + sim_options.bench_name + "\n");
+            return 1;
         }
+        printPerfReport();
+        return bench_code;
     }
     
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    log_level = sim_options.log_level;
+    if (!planPlacement(cpu_placement, sim_options.placement, sim_options.control_cpus)) return 1;
+    applyWorkerPlacement(cpu_placement);
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) resetLatencyHistogram(light_notify_latency[i]);
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        resetLatencyHistogram(phase_start_error[i]);
+        resetDriftTrack(phase_drift[i], monotonicNowNs());
+    }
+    srand(sim_options.seed);
+    initSimulationContext(sim_context, sim_options.vehicle_count);
+    initVehiclePool(vehicle_pool, sim_options.max_in_flight);
+    initVehicleThreadAttr(vehicle_thread_attr, sim_options.vehicle_stack_kb);
     
-    displayStartupBanner();
+    if (sim_options.engine == "coroutines") {
+#if CORO_ENGINE_AVAILABLE
+        use_coroutines = true;
+#else
+        cerr << ("The coroutine engine needs a C++20 build (g++ -std=c++20)\n");
+        return 1;
+#endif
+    } else if (sim_options.engine == "micro") {
+        use_kinematics = true;
+        initKinematicEngine(kinematic_engine, NUM_INTERSECTIONS, sim_options.scheduler_threads);
+    }
+    
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        initInterLink(inter_links[i], i, (i + 1) % NUM_INTERSECTIONS, sim_options.link_capacity, LINK_TRAVEL_TIME);
+    }
     
-    safePrintWithTime("Initializing simulation with " + to_string(total_vehicles_to_spawn) + " vehicles");
-    safePrintWithTime("[PARENT] Main process PID: " + to_string(getpid()));
+    if (!sim_options.feed_path.empty()) {
+        if (!openArrivalFeed(arrival_feed, sim_options.feed_path, sim_options.feed_speed)) {
+            return 1;
+        }
+        feeding = true;
+    }
+    
+    if (!sim_options.replay_path.empty()) {
+        if (!openWorkloadReplay(workload_replay, sim_options.replay_path)) {
+            return 1;
+        }
+        if (workload_replay.header.record_count > 0) {
+            setTotalVehicles(sim_context, workload_replay.header.record_count);
+        }
+        srand(workload_replay.header.seed);
+    }
+    
+    if (!sim_options.demand.empty()) {
+        initDemandSchedule(demand_schedule, *findDemandProfile(sim_options.demand), sim_options.seed);
+        demand_driven = true;
+    }
+    
+    if (!sim_options.record_path.empty()) {
+        if (!openWorkloadRecorder(workload_recorder, sim_options.record_path, sim_options.seed)) {
+            return 1;
+        }
+    }
+    
+    // Blocked before any thread or controller exists so every one inherits the mask
+    initCompletionLatch(completion_latch);
+    shutdown_signal_fd = openShutdownSignalFd();
+    shutdown_wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (shutdown_signal_fd < 0 || shutdown_wake_fd < 0) {
+        perror("Failed to set up shutdown signal handling");
+        return 1;
+    }
+    pthread_t signal_tid;
+    pthread_create(&signal_tid, NULL, shutdownSignalThread, NULL);
     
     initializeIntersections();
     initializeParkingLots();
+    
+    if (!sim_options.export_path.empty()) {
+        if (!openStateExport(state_export, sim_options.export_path, monotonicNowNs())) {
+            perror(("Failed to open state export " + sim_options.export_path).c_str());
+            return 1;
+        }
+        StateSnapshot initial;
+        captureStateSnapshot(initial);
+        beginStateUpdate(state_export) = initial;
+        endStateUpdate(state_export);
+        LOG_INFO("[EXPORT] Publishing state to ", sim_options.export_path);
+    }
+    
+    displayStartupBanner();
+    
+    LOG_INFO("Initializing simulation with ", totalVehicles(sim_context), " vehicles");
+    LOG_INFO("[PARENT] Main process PID: ", getpid());
+    if (feeding) {
+        LOG_INFO("[FEED] Streaming arrivals from ", sim_options.feed_path,
+                 (arrival_feed.mapped ? " (mmap)" : " (chunked read)"));
+    } else if (workload_replay.file != NULL) {
+        LOG_INFO("[REPLAY] Driving spawner from ", sim_options.replay_path);
+    } else if (demand_driven) {
+        LOG_INFO("[DEMAND] Profile ", sim_options.demand, ", seed ", sim_options.seed);
+    } else {
+        LOG_INFO("Random workload seed: ", sim_options.seed);
+    }
+    
     initializePipes();
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        SignalPlan plan = defaultSignalPlan(i);
+        plan.offset_us = sim_options.offsets_ms[i] * 1000;
+        if (!compileSignalPlan(plan, signal_plans[i])) return 1;
+    }
+    if (sim_options.green_wave) {
+        signal_plans[1].offset_us = optimizeGreenWaveOffset(signal_plans[0], signal_plans[1], corridorTravelUs());
+    }
+    if (sim_options.coordinated) {
+        // Forked controllers share CLOCK_MONOTONIC, so one reference serves both processes
+        signal_reference_ns = monotonicNowNs();
+        LOG_INFO("[SIGNAL] Corridor coordination: F10 offset ", signal_plans[0].offset_us / 1000,
+                 " ms, F11 offset ", signal_plans[1].offset_us / 1000, " ms, two-way bandwidth ",
+                 corridorBandwidthUs(signal_plans[0], signal_plans[1], corridorTravelUs()) / 1000,
+                 " ms/cycle", (sim_options.green_wave ? " (green wave)" : ""));
+    }
     
-    safePrintWithTime("Initialization complete. Starting simulation...");
-    usleep(1000000);
+    if (cpu_placement.applied) {
+        LOG_INFO("[PLACEMENT] Controllers and listener on CPUs ", formatCpuList(cpu_placement.control_cpus),
+                 ", workers on CPUs ", formatCpuList(cpu_placement.worker_cpus));
+    } else if (cpu_placement.policy == PLACEMENT_DEDICATED) {
+        LOG_WARN("[PLACEMENT] Dedicated placement ", cpu_placement.note);
+    }
     
-    pid_t f10_pid = fork();
+    LOG_INFO("Initialization complete. Starting simulation...");
     
-    if (f10_pid < 0) {
-        perror("Failed to fork F10 controller process");
-        exit(1);
-    } else if (f10_pid == 0) {
-        close(pipe_f10_to_f11[0]);
-        close(pipe_f11_to_f10[1]);
-        close(pipe_f10_to_parent[0]);
-        close(pipe_f11_to_parent[0]);
-        close(pipe_f11_to_parent[1]);
-        f10ControllerProcess();
-        exit(0);
+    int transport = sim_options.controller_transport;
+    if (transport == TRANSPORT_SHM) {
+        light_mailbox = createLightMailbox();
+        if (light_mailbox == NULL) {
+            perror("Failed to map the light-state mailbox");
+            return 1;
+        }
     }
+    startControllers(transport);
     
-    safePrintWithTime("[PARENT] Spawned F10 controller process (PID: " + to_string(f10_pid) + ")");
+    endSharedAllocation(cpu_placement);
     
-    pid_t f11_pid = fork();
+    // Thread controllers deliver light changes themselves
+    pthread_t listener_tid;
+    if (transport != TRANSPORT_THREAD) pthread_create(&listener_tid, NULL, lightStateListenerThread, NULL);
     
-    if (f11_pid < 0) {
-        perror("Failed to fork F11 controller process");
-        kill(f10_pid, SIGTERM);
-        exit(1);
-    } else if (f11_pid == 0) {
-        close(pipe_f11_to_f10[0]);
-        close(pipe_f10_to_f11[1]);
-        close(pipe_f11_to_parent[0]);
-        close(pipe_f10_to_parent[0]);
-        close(pipe_f10_to_parent[1]);
-        f11ControllerProcess();
-        exit(0);
+    pthread_t planner_tid;
+    if (sim_options.predictive) {
+        resetLookaheadStats(lookahead_stats);
+        lookahead_results = createLookaheadResults();
+        if (lookahead_results == NULL || pthread_create(&planner_tid, NULL, lookaheadPlannerThread, NULL) != 0) {
+            LOG_WARN("[PREDICT] Cannot start the lookahead planner; running the fixed plans");
+            sim_options.predictive = false;
+        }
     }
     
-    safePrintWithTime("[PARENT] Spawned F11 controller process (PID: " + to_string(f11_pid) + ")");
+    if (feeding && !startArrivalFeed(arrival_feed)) {
+        LOG_WARN("ERROR: Failed to start arrival feed reader");
+        feeding = false;
+    }
     
-    close(pipe_f10_to_parent[1]);
-    close(pipe_f11_to_parent[1]);
+#if CORO_ENGINE_AVAILABLE
+    if (use_coroutines) {
+        startCoroScheduler(sim_options.scheduler_threads);
+        LOG_INFO("[PARENT] Coroutine engine running on ", sim_options.scheduler_threads, " scheduler threads");
+    }
+#endif
     
-    pthread_t listener_tid;
-    pthread_create(&listener_tid, NULL, lightStateListenerThread, NULL);
+    if (!use_kinematics) {
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) startLinkDrain(inter_links[i]);
+        startDepartureService(departure_service);
+    }
+    
+    pthread_t kinematic_tid;
+    if (use_kinematics) {
+        pthread_create(&kinematic_tid, NULL, kinematicEngineThread, NULL);
+        LOG_INFO("[PARENT] Micro engine stepping ", kinematic_engine.lanes.size(), " lanes every ",
+                 (int)(KIN_DT * 1000), " ms on ", sim_options.scheduler_threads, " threads");
+    }
+    
+    if (sim_options.dashboard) {
+        startDashboard(dashboard, sim_options.dashboard_hz, captureStateSnapshot);
+    }
     
     pthread_t spawner_tid;
     pthread_create(&spawner_tid, NULL, vehicleSpawnerThread, NULL);
     
     pthread_join(spawner_tid, NULL);
     
-    safePrintWithTime("Waiting for all vehicles to complete...");
+    LOG_INFO("Waiting for all vehicles to complete...");
     
-    int timeout_counter = 0;
-    int max_timeout = 60;
+    if (!waitForLatch(completion_latch, COMPLETION_TIMEOUT_MS) && !shuttingDown(sim_context)) {
+        LOG_WARN("[PARENT] Timed out waiting for vehicles to complete");
+    }
     
-    while (vehicles_completed < total_vehicles_to_spawn && timeout_counter < max_timeout && !shutdown_flag) {
-        usleep(1000000);
-        timeout_counter++;
+    if (sim_options.dashboard) {
+        stopDashboard(dashboard);
     }
     
-    shutdown_flag = true;
+    requestShutdown();
     
-    pthread_cond_broadcast(&f10_north_south_cond);
-    pthread_cond_broadcast(&f10_east_west_cond);
-    pthread_cond_broadcast(&f11_north_south_cond);
-    pthread_cond_broadcast(&f11_east_west_cond);
+#if CORO_ENGINE_AVAILABLE
+    if (use_coroutines) {
+        pthread_mutex_t* intersection_mutexes[2] = {&f10_mutex, &f11_mutex};
+        wakeAllCoroutines(intersection_mutexes);
+    }
+#endif
+    
+    if (sim_options.predictive) pthread_join(planner_tid, NULL);
     
-    safePrintWithTime("[PARENT] Terminating controller processes...");
-    kill(f10_pid, SIGTERM);
-    kill(f11_pid, SIGTERM);
+    stopControllers(transport);
     
-    int status;
-    waitpid(f10_pid, &status, 0);
-    safePrintWithTime("[PARENT] F10 controller process terminated");
-    waitpid(f11_pid, &status, 0);
-    safePrintWithTime("[PARENT] F11 controller process terminated");
+    if (transport != TRANSPORT_THREAD) pthread_join(listener_tid, NULL);
+    
+    if (use_kinematics) {
+        pthread_join(kinematic_tid, NULL);
+        LOG_INFO("[PARENT] Micro engine stopped after ", kinematic_engine.ticks, " ticks");
+    }
+    
+    if (feeding) {
+        if (!arrival_feed.eof) {
+            pthread_cancel(arrival_feed.reader_tid);   // still blocked reading a live FIFO or stdin
+        }
+        pthread_join(arrival_feed.reader_tid, NULL);
+        LOG_INFO("[FEED] ", arrival_feed.stats.rows, " rows ingested, ", arrival_feed.stats.skipped,
+                 " skipped");
+        closeArrivalFeed(arrival_feed);
+    }
     
-    pthread_join(listener_tid, NULL);
+    bool vehicles_drained = waitForVehiclesDrained(vehicle_pool, 5000);
+    if (!vehicles_drained) {
+        LOG_WARN("[PARENT] WARNING: vehicle threads still active after shutdown");
+    }
+    
+    if (!use_kinematics) {
+        stopDepartureService(departure_service);
+    }
+    
+#if CORO_ENGINE_AVAILABLE
+    if (use_coroutines && vehicles_drained) {
+        stopCoroScheduler();
+    }
+#endif
     
-    for (size_t i = 0; i < vehicle_threads.size(); i++) {
-        pthread_join(vehicle_threads[i], NULL);
+    // Kept running until the vehicles drained: at shutdown they release everyone still on a link
+    if (!use_kinematics) {
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) stopLinkDrain(inter_links[i]);
     }
     
+    markStateExportFinished(state_export);
+    
     displayShutdownBanner();
     
-    safePrintWithTime("Final Statistics:");
-    cout << ("  Vehicles Completed: " + to_string(vehicles_completed) + "/" + to_string(total_vehicles_to_spawn) + "\n");
-    cout << ("  F10 Parking Final: " + to_string(parking_f10.parked_vehicles.size()) + " parked\n");
-    cout << ("  F11 Parking Final: " + to_string(parking_f11.parked_vehicles.size()) + " parked\n");
+    LOG_INFO("Final Statistics:");
+    cout << ("  Vehicles Completed: " + to_string(vehiclesCompleted(sim_context)) + "/" + to_string(totalVehicles(sim_context)) + "\n");
+    cout << ("  Vehicles Aborted: " + to_string(completion_latch.aborted) + "\n");
+    {
+        ViewReadSection read(views);
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+            cout << ("  " + INTERSECTION_IDS[i] + " Parking Final: " + to_string(read.lot(i).parked.size()) + " parked\n");
+        }
+    }
+    if (demand_driven) printDemandReport(demand_schedule, (int)run_outcome.spawned);
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) printLinkReport(inter_links[i]);
+    if (!use_kinematics) printDepartureReport(departure_service);
+    printViewDomainReport(views);
+#if CORO_ENGINE_AVAILABLE
+    if (use_coroutines) {
+        printVehicleMemoryReport(vehicle_pool, "Coroutine frame per vehicle", coro_scheduler.frame_bytes_peak.load());
+        printCoroEngineReport();
+    } else
+#endif
+    if (use_kinematics) {
+        printVehicleMemoryReport(vehicle_pool, "Lane state per vehicle", KINEMATIC_BYTES_PER_VEHICLE);
+    } else
+    printVehicleMemoryReport(vehicle_pool, "Stack per vehicle thread", vehicleThreadStackBytes(vehicle_thread_attr));
+    printPlacementReport(cpu_placement, listener_cpus);
+    LatencyHistogram light_notify_total;
+    resetLatencyHistogram(light_notify_total);
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) mergeLatencyHistogram(light_notify_total, light_notify_latency[i]);
+    printLatencySummary("Light notification over " + TRANSPORT_NAMES[transport] +
+                        " (controller publish to waiters woken)", light_notify_total);
+    cout << ("Controller peer pipes (framed, batched with writev):\n");
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) printPeerOutboxReport("To " + INTERSECTION_IDS[i], peer_outboxes[i].stats);
+    printPhaseTimingReport();
+    if (sim_options.predictive) printLookaheadReport(lookahead_stats);
+    printPerfReport();
+    
+    int exit_code = 0;
+    
+    if (!sim_options.record_path.empty()) {
+        closeWorkloadRecorder(workload_recorder, run_outcome);
+        LOG_INFO("[RECORD] Wrote ", run_outcome.spawned, " arrivals to ", sim_options.record_path);
+    }
+    
+    if (workload_replay.file != NULL) {
+        // Verifying reads the rest of the file, so a bad record past the spawned ones is caught too
+        bool has_outcome = sim_options.verify_replay && readWorkloadOutcome(workload_replay);
+        if (workload_replay.corrupt) {
+            cerr << ("[REPLAY] Corrupt arrival file " + sim_options.replay_path + ": record "
+                     + to_string(workload_replay.records_read + 1) + " is invalid\n");
+            exit_code = 2;
+        } else if (sim_options.verify_replay) {
+            if (!has_outcome) {
+                LOG_INFO("[REPLAY] Arrival file has no recorded outcome to verify against");
+                exit_code = 2;
+            } else if (!verifyWorkloadOutcome(workload_replay.outcome, run_outcome)) {
+                exit_code = 2;
+            }
+        }
+        closeWorkloadReplay(workload_replay);
+    }
+    
+    uint64_t wake = 1;
+    write(shutdown_wake_fd, &wake, sizeof(wake));
+    pthread_join(signal_tid, NULL);
+    close(shutdown_wake_fd);
+    close(shutdown_signal_fd);
     
     cleanup();
+    pthread_attr_destroy(&vehicle_thread_attr);
+    if (vehicles_drained) {
+        destroyVehiclePool(vehicle_pool);
+        destroyCompletionLatch(completion_latch);
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) destroyInterLink(inter_links[i]);
+        destroyViewDomain(views);
+        if (stateExportEnabled(state_export)) closeStateExport(state_export);
+    }
     
-    safePrintWithTime("Simulation ended successfully.");
+    LOG_INFO("Simulation ended successfully.");
     
-    return 0;
+    return exit_code;
 }
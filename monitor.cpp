@@ -0,0 +1,138 @@
+// Traffic Simulation Monitor - attaches to a running simulator's state export
+// Compile with: g++ -std=c++17 -pthread -o traffic_monitor monitor.cpp
+// Run: ./traffic_monitor /dev/shm/traffic_sim [--hz N] [--once]
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "simulation.h"
+#include "snapshot.h"
+#include "stateexport.h"
+#include "dashboard.h"
+
+using namespace std;
+
+// The headers declare these for the simulator; the monitor only ever uses console_mutex
+pthread_mutex_t console_mutex = PTHREAD_MUTEX_INITIALIZER;
+int log_level = LOG_LEVEL_OFF;
+
+const SharedStateRegion* attached = NULL;
+Dashboard dash;
+StateSnapshot last_snapshot;
+uint32_t last_version = 0;
+
+// Maps the export read-only; the simulator's writes never wait on us
+const SharedStateRegion* attachStateExport(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror(("Cannot open " + path).c_str());
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SharedStateRegion)) {
+        cerr << (path + " is not a state export (too small)\n");
+        close(fd);
+        return NULL;
+    }
+    void* base = mmap(NULL, sizeof(SharedStateRegion), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+
+    const SharedStateRegion* region = (const SharedStateRegion*)base;
+    if (region->magic != STATE_EXPORT_MAGIC || region->layout != STATE_EXPORT_LAYOUT
+        || region->snapshot_bytes != sizeof(StateSnapshot)) {
+        cerr << (path + " has an unknown layout (built from a different simulator version?)\n");
+        munmap(base, sizeof(SharedStateRegion));
+        return NULL;
+    }
+    return region;
+}
+
+bool simulatorFinished() {
+    return attached->finished.load(memory_order_acquire) != 0;
+}
+
+bool simulatorAlive() {
+    return kill(attached->writer_pid, 0) == 0;
+}
+
+// Dashboard capture callback: a consistent copy, or the last one if the
+// writer is stuck mid-update
+void captureExportedSnapshot(StateSnapshot& out) {
+    StateSnapshot fresh;
+    uint32_t version = 0;
+    bool consistent = readStateSnapshot(attached, fresh, version);
+    if (consistent) {
+        last_snapshot = fresh;
+        last_version = version;
+    }
+    out = last_snapshot;
+
+    string state = simulatorFinished() ? "finished" : (simulatorAlive() ? "running" : "writer gone");
+    dash.status_line = "Monitor  simulator pid " + to_string(attached->writer_pid) + " (" + state + "), update "
+                     + to_string(last_version) + (consistent ? "" : " (stale)");
+}
+
+void printMonitorUsage(const char* program) {
+    cout << ("Usage: " + string(program) + " PATH [--hz N] [--once]\n");
+    cout << ("  PATH      State file written by traffic_sim --export-state PATH\n");
+    cout << ("  --hz N    Redraw rate (default 10)\n");
+    cout << ("  --once    Print the current state once and exit\n");
+}
+
+int main(int argc, char* argv[]) {
+    string path;
+    int hz = DEFAULT_DASHBOARD_HZ;
+    bool once = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--hz" && i + 1 < argc) {
+            hz = atoi(argv[++i]);
+        } else if (arg == "--once") {
+            once = true;
+        } else if (!arg.empty() && arg[0] != '-' && path.empty()) {
+            path = arg;
+        } else {
+            printMonitorUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (path.empty() || hz <= 0 || hz > 100) {
+        printMonitorUsage(argv[0]);
+        return 1;
+    }
+
+    attached = attachStateExport(path);
+    if (attached == NULL) return 1;
+
+    initDashboard(dash, hz, captureExportedSnapshot);
+    dash.start_ns = attached->start_ns;
+    dash.ansi = !once;
+
+    struct timespec next_frame;
+    clock_gettime(CLOCK_MONOTONIC, &next_frame);
+
+    while (true) {
+        bool done = simulatorFinished() || !simulatorAlive();
+        drawDashboard(dash);
+
+        if (once || done) break;
+        addUsToTimespec(next_frame, 1000000 / hz);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_frame, NULL);
+    }
+
+    munmap((void*)attached, sizeof(SharedStateRegion));
+    return 0;
+}
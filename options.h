@@ -0,0 +1,286 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "simulation.h"
+#include "log.h"
+#include "placement.h"
+#include "transport.h"
+#include "demand.h"
+
+using namespace std;
+
+struct SimulationOptions {
+    int vehicle_count;
+    unsigned int seed;
+    string record_path;
+    string replay_path;
+    bool verify_replay;
+    string feed_path;
+    double feed_speed;
+    int max_in_flight;
+    int vehicle_stack_kb;
+    string engine;
+    int scheduler_threads;
+    int link_capacity;
+    bool coordinated;
+    int offsets_ms[NUM_INTERSECTIONS];
+    bool green_wave;
+    int log_level;
+    bool dashboard;
+    string export_path;
+    int dashboard_hz;
+    bool perf;
+    int placement;
+    string control_cpus;
+    int rt_priority;
+    bool transit_priority;
+    int controller_transport;
+    bool predictive;
+    string demand;
+    string bench_name;
+
+    SimulationOptions() : vehicle_count(DEFAULT_VEHICLE_COUNT), seed((unsigned int)time(NULL)),
+                          verify_replay(false), feed_speed(1.0), max_in_flight(DEFAULT_MAX_IN_FLIGHT),
+                          vehicle_stack_kb(DEFAULT_VEHICLE_STACK_KB),
+                          engine("threads"), scheduler_threads(DEFAULT_SCHEDULER_THREADS),
+                          link_capacity(DEFAULT_LINK_CAPACITY), coordinated(false), green_wave(false),
+                          log_level(LOG_LEVEL_DEBUG), dashboard(false), dashboard_hz(DEFAULT_DASHBOARD_HZ),
+                          perf(false), placement(PLACEMENT_NONE), rt_priority(0),
+                          transit_priority(false), controller_transport(TRANSPORT_PIPE), predictive(false) {
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) offsets_ms[i] = 0;
+    }
+};
+
+extern SimulationOptions sim_options;
+
+inline void printUsage(const char* program) {
+    cout << ("Usage: " + string(program) + " [vehicle_count] [options]\n");
+    cout << ("  --seed N          Seed the random workload generator\n");
+    cout << ("  --record FILE     Record every spawn decision to an arrival file\n");
+    cout << ("  --replay FILE     Drive the spawner from a recorded arrival file\n");
+    cout << ("  --verify          With --replay, check the run reproduces the recorded outcome\n");
+    cout << ("  --feed PATH       Stream arrivals from a CSV file, FIFO or '-' for stdin\n");
+    cout << ("  --feed-speed X    Replay feed timestamps X times faster (0 = as fast as possible)\n");
+    cout << ("  --max-in-flight N Vehicle pool size; spawning pauses while all N are active\n");
+    cout << ("  --stack-kb N      Stack size of each vehicle thread in KB (default 64)\n");
+    cout << ("  --engine NAME     Vehicle execution engine: threads (default), coroutines or micro\n");
+    cout << ("  --sched-threads N Scheduler threads for the coroutine engine, workers for micro (default 2)\n");
+    cout << ("  --link-capacity N Vehicles the F10-F11 link holds per direction (default 8)\n");
+    cout << ("  --offsets A,B     Coordinate F10/F11 cycles on a shared reference with these offsets (ms)\n");
+    cout << ("  --green-wave      Coordinate with the F11 offset that maximizes two-way corridor bandwidth\n");
+    cout << ("  --log-level NAME  Lowest event level printed: trace, debug (default), info, warn or off\n");
+    cout << ("  --quiet           Print only warnings and the final report (same as --log-level warn)\n");
+    cout << ("  --dashboard       Redraw a live status dashboard instead of printing events (implies --log-level off)\n");
+    cout << ("  --dashboard-hz N  Dashboard frame rate (default 10)\n");
+    cout << ("  --export-state PATH Publish a live state snapshot to a shared file (e.g. /dev/shm/traffic_sim)\n");
+    cout << ("  --perf            Report CPU time, cycles, cache/branch misses and context switches per code region\n");
+    cout << ("  --placement NAME  CPU placement: none (default) or dedicated (controllers and listener on their own CPU)\n");
+    cout << ("  --control-cpus LIST CPUs reserved for controllers and listener, e.g. 3 or 2-3 (implies dedicated)\n");
+    cout << ("  --rt-priority N   Run the signal controllers SCHED_FIFO at priority N (1-99; needs CAP_SYS_NICE)\n");
+    cout << ("  --transit-priority Let buses request a green extension or early green from their controller\n");
+    cout << ("  --controllers MODE Signal controllers as threads, or forked processes over pipe (default) or shm\n");
+    cout << ("  --predictive      Fork copy-on-write lookaheads at each green and pick the plan with least projected delay\n");
+    cout << ("  --demand NAME     Spawn from a demand profile's Poisson arrivals: flat, rush-hour or corridor\n");
+    cout << ("  --bench NAME      Run a benchmark instead of the simulation (ingest, kinematics, corridor, transit,\n");
+    cout << ("                    transport, demand)\n");
+}
+
+inline bool parseOptions(int argc, char* argv[], SimulationOptions& opts) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = (i + 1 < argc);
+
+        if (arg == "--seed" && has_value) {
+            opts.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        }
+        else if (arg == "--record" && has_value) {
+            opts.record_path = argv[++i];
+        }
+        else if (arg == "--replay" && has_value) {
+            opts.replay_path = argv[++i];
+        }
+        else if (arg == "--verify") {
+            opts.verify_replay = true;
+        }
+        else if (arg == "--feed" && has_value) {
+            opts.feed_path = argv[++i];
+        }
+        else if (arg == "--feed-speed" && has_value) {
+            opts.feed_speed = atof(argv[++i]);
+        }
+        else if (arg == "--max-in-flight" && has_value) {
+            opts.max_in_flight = atoi(argv[++i]);
+        }
+        else if (arg == "--stack-kb" && has_value) {
+            opts.vehicle_stack_kb = atoi(argv[++i]);
+        }
+        else if (arg == "--engine" && has_value) {
+            opts.engine = argv[++i];
+        }
+        else if (arg == "--sched-threads" && has_value) {
+            opts.scheduler_threads = atoi(argv[++i]);
+        }
+        else if (arg == "--link-capacity" && has_value) {
+            opts.link_capacity = atoi(argv[++i]);
+        }
+        else if (arg == "--offsets" && has_value) {
+            char* cursor = argv[++i];
+            for (int k = 0; k < NUM_INTERSECTIONS; k++) {
+                char* end;
+                opts.offsets_ms[k] = (int)strtol(cursor, &end, 10);
+                if (end == cursor || (k + 1 < NUM_INTERSECTIONS && *end != ',') || (k + 1 == NUM_INTERSECTIONS && *end != '\0')) {
+                    cerr << ("--offsets expects " + to_string(NUM_INTERSECTIONS) + " comma-separated values\n");
+                    return false;
+                }
+                cursor = end + 1;
+            }
+            opts.coordinated = true;
+        }
+        else if (arg == "--green-wave") {
+            opts.green_wave = true;
+            opts.coordinated = true;
+        }
+        else if (arg == "--log-level" && has_value) {
+            string name = argv[++i];
+            if (!parseLogLevel(name, opts.log_level)) {
+                cerr << ("--log-level must be trace, debug, info, warn or off\n");
+                return false;
+            }
+        }
+        else if (arg == "--quiet") {
+            opts.log_level = LOG_LEVEL_WARN;
+        }
+        else if (arg == "--dashboard") {
+            opts.dashboard = true;
+            opts.log_level = LOG_LEVEL_OFF;
+        }
+        else if (arg == "--dashboard-hz" && has_value) {
+            opts.dashboard_hz = atoi(argv[++i]);
+        }
+        else if (arg == "--export-state" && has_value) {
+            opts.export_path = argv[++i];
+        }
+        else if (arg == "--perf") {
+            opts.perf = true;
+        }
+        else if (arg == "--placement" && has_value) {
+            string name = argv[++i];
+            if (name == PLACEMENT_NAMES[PLACEMENT_NONE]) {
+                opts.placement = PLACEMENT_NONE;
+            } else if (name == PLACEMENT_NAMES[PLACEMENT_DEDICATED]) {
+                opts.placement = PLACEMENT_DEDICATED;
+            } else {
+                cerr << ("--placement must be none or dedicated\n");
+                return false;
+            }
+        }
+        else if (arg == "--control-cpus" && has_value) {
+            opts.control_cpus = argv[++i];
+            opts.placement = PLACEMENT_DEDICATED;
+        }
+        else if (arg == "--rt-priority" && has_value) {
+            opts.rt_priority = atoi(argv[++i]);
+        }
+        else if (arg == "--transit-priority") {
+            opts.transit_priority = true;
+        }
+        else if (arg == "--controllers" && has_value) {
+            string name = argv[++i];
+            opts.controller_transport = -1;
+            for (int t = 0; t < NUM_TRANSPORTS; t++) {
+                if (name == TRANSPORT_NAMES[t]) opts.controller_transport = t;
+            }
+            if (opts.controller_transport < 0) {
+                cerr << ("--controllers must be thread, pipe or shm\n");
+                return false;
+            }
+        }
+        else if (arg == "--predictive") {
+            opts.predictive = true;
+        }
+        else if (arg == "--demand" && has_value) {
+            opts.demand = argv[++i];
+            if (findDemandProfile(opts.demand) == NULL) {
+                cerr << ("--demand must be flat, rush-hour or corridor\n");
+                return false;
+            }
+        }
+        else if (arg == "--bench" && has_value) {
+            opts.bench_name = argv[++i];
+        }
+        else if (arg == "--help" || arg == "-h") {
+            return false;
+        }
+        else if (!arg.empty() && arg[0] != '-') {
+            opts.vehicle_count = atoi(arg.c_str());
+            if (opts.vehicle_count <= 0) {
+                opts.vehicle_count = DEFAULT_VEHICLE_COUNT;
+            }
+        }
+        else {
+            cerr << ("Unknown or incomplete option: " + arg + "\n");
+            return false;
+        }
+    }
+
+    if (!opts.record_path.empty() && opts.record_path == opts.replay_path) {
+        cerr << ("--record and --replay must use different files\n");
+        return false;
+    }
+    if (!opts.feed_path.empty() && !opts.replay_path.empty()) {
+        cerr << ("--feed and --replay are mutually exclusive\n");
+        return false;
+    }
+    if (opts.max_in_flight <= 0) {
+        cerr << ("--max-in-flight must be positive\n");
+        return false;
+    }
+    if (opts.vehicle_stack_kb <= 0) {
+        cerr << ("--stack-kb must be positive\n");
+        return false;
+    }
+    if (opts.engine != "threads" && opts.engine != "coroutines" && opts.engine != "micro") {
+        cerr << ("--engine must be threads, coroutines or micro\n");
+        return false;
+    }
+    if (opts.scheduler_threads <= 0) {
+        cerr << ("--sched-threads must be positive\n");
+        return false;
+    }
+    if (opts.link_capacity <= 0) {
+        cerr << ("--link-capacity must be positive\n");
+        return false;
+    }
+    if (opts.dashboard_hz <= 0 || opts.dashboard_hz > 100) {
+        cerr << ("--dashboard-hz must be between 1 and 100\n");
+        return false;
+    }
+    if (opts.rt_priority < 0 || opts.rt_priority > 99) {
+        cerr << ("--rt-priority must be between 1 and 99\n");
+        return false;
+    }
+    if (opts.predictive && opts.engine == "micro") {
+        cerr << ("--predictive needs the threads or coroutines engine\n");
+        return false;
+    }
+    if (!opts.demand.empty() && (!opts.feed_path.empty() || !opts.replay_path.empty())) {
+        cerr << ("--demand cannot be combined with --feed or --replay\n");
+        return false;
+    }
+    if (opts.bench_name == "ingest" && opts.feed_path.empty()) {
+        cerr << ("--bench ingest requires --feed\n");
+        return false;
+    }
+    if (opts.verify_replay && opts.replay_path.empty()) {
+        cerr << ("--verify requires --replay\n");
+        return false;
+    }
+    return true;
+}
+
+#endif // OPTIONS_H
@@ -4,13 +4,20 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <algorithm>
+#include <climits>
+#include <pthread.h>
 #include <semaphore.h>
 #include "vehicle.h"
+#include "timerwheel.h"
+#include "coroengine.h"
 
 using namespace std;
 
 const int MAX_PARKING_SPOTS = 10;
 const int MAX_WAITING_QUEUE = 5;
+const int DEPARTURE_RETRY_US = 10000;
 
 struct ParkingLot {
     string intersection_id;
@@ -20,23 +27,33 @@ struct ParkingLot {
     vector<Vehicle> waiting_vehicles;
     sem_t access_lock;
     
+    // Parked vehicles hold no thread or scheduler slot: the lot keeps each
+    // one's departure here until the departure service re-injects it
+    TimerWheel departures;
+    pthread_mutex_t departures_lock;
+    
     ParkingLot(string id) {
         intersection_id = id;
         sem_init(&parking_spots, 0, MAX_PARKING_SPOTS);
         sem_init(&waiting_queue, 0, MAX_WAITING_QUEUE);
         sem_init(&access_lock, 0, 1);
+        pthread_mutex_init(&departures_lock, NULL);
+        initTimerWheel(departures, monotonicNowNs());
     }
     
     ParkingLot() : intersection_id("F10") {
         sem_init(&parking_spots, 0, MAX_PARKING_SPOTS);
         sem_init(&waiting_queue, 0, MAX_WAITING_QUEUE);
         sem_init(&access_lock, 0, 1);
+        pthread_mutex_init(&departures_lock, NULL);
+        initTimerWheel(departures, monotonicNowNs());
     }
     
     ~ParkingLot() {
         sem_destroy(&parking_spots);
         sem_destroy(&waiting_queue);
         sem_destroy(&access_lock);
+        pthread_mutex_destroy(&departures_lock);
     }
 };
 
@@ -45,12 +62,15 @@ inline void initParkingLot(ParkingLot& lot, string id) {
     sem_init(&lot.parking_spots, 0, MAX_PARKING_SPOTS);
     sem_init(&lot.waiting_queue, 0, MAX_WAITING_QUEUE);
     sem_init(&lot.access_lock, 0, 1);
+    pthread_mutex_init(&lot.departures_lock, NULL);
+    initTimerWheel(lot.departures, monotonicNowNs());
 }
 
 inline void destroyParkingLot(ParkingLot& lot) {
     sem_destroy(&lot.parking_spots);
     sem_destroy(&lot.waiting_queue);
     sem_destroy(&lot.access_lock);
+    pthread_mutex_destroy(&lot.departures_lock);
 }
 
 inline int getAvailableSpots(ParkingLot& lot) {
@@ -142,43 +162,151 @@ inline bool leaveWaitQueue(ParkingLot& lot, int vehicle_id) {
     return false;
 }
 
-inline void printParkingLot(ParkingLot& lot) {
-    sem_wait(&lot.access_lock);
-    
-    cout << ("========================================\n");
-    cout << ("PARKING LOT: " + lot.intersection_id + "\n");
-    cout << ("========================================\n");
-    cout << ("Capacity: " + to_string(MAX_PARKING_SPOTS) + " spots\n");
-    cout << ("Available: " + to_string(getAvailableSpots(lot)) + " spots\n");
-    cout << ("Occupied: " + to_string(lot.parked_vehicles.size()) + " vehicles\n");
-    cout << ("----------------------------------------\n");
+// One thread serves every lot's departures: it sleeps until the earliest
+// wheel tick with work, expires everything due in one pass per lot and runs
+// the callbacks (which restart the vehicles) outside the locks. Once the
+// simulation shuts down it releases every parked vehicle at once.
+struct DepartureStats {
+    long batches;
+    long departed;
+    long largest_batch;
+};
+
+struct DepartureService {
+    ParkingLot* lots[NUM_INTERSECTIONS];
+    int lot_count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool rescan;                        // a departure was added ahead of next_wake_ns
+    atomic<long long> next_wake_ns;     // LLONG_MAX while scanning: every add signals
+    atomic<bool> stopping;
+    pthread_t tid;
+    DepartureStats stats;
+};
+
+inline void initDepartureService(DepartureService& service, ParkingLot* const* lots, int lot_count) {
+    for (int i = 0; i < lot_count; i++) service.lots[i] = lots[i];
+    service.lot_count = lot_count;
+    pthread_mutex_init(&service.lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&service.wake, &attr);
+    pthread_condattr_destroy(&attr);
+    service.rescan = false;
+    service.next_wake_ns.store(LLONG_MAX);
+    service.stopping.store(false);
+    service.stats.batches = 0;
+    service.stats.departed = 0;
+    service.stats.largest_batch = 0;
+}
+
+inline void destroyDepartureService(DepartureService& service) {
+    pthread_cond_destroy(&service.wake);
+    pthread_mutex_destroy(&service.lock);
+}
+
+// fire(ctx) runs on the service thread at or shortly after due_ns
+inline void scheduleDeparture(DepartureService& service, ParkingLot& lot, long long due_ns, TimerFireFn fire, void* ctx) {
+    pthread_mutex_lock(&lot.departures_lock);
+    addTimer(lot.departures, due_ns, fire, ctx);
+    pthread_mutex_unlock(&lot.departures_lock);
     
-    if (!lot.parked_vehicles.empty()) {
-        cout << ("Parked Vehicles:\n");
-        for (size_t i = 0; i < lot.parked_vehicles.size(); i++) {
-            cout << ("  " + to_string(i + 1) + ". " + lot.parked_vehicles[i].type 
-                 + " (ID: " + to_string(lot.parked_vehicles[i].id) + ")\n");
-        }
-    } else {
-        cout << ("Parked Vehicles: None\n");
+    if (due_ns < service.next_wake_ns.load()) {
+        pthread_mutex_lock(&service.lock);
+        service.rescan = true;
+        pthread_cond_signal(&service.wake);
+        pthread_mutex_unlock(&service.lock);
     }
+}
+
+inline void* departureServiceThread(void* arg) {
+    DepartureService& service = *(DepartureService*)arg;
+    vector<TimerWheelEntry> due;
     
-    cout << ("----------------------------------------\n");
-    cout << ("Wait Queue: " + to_string(lot.waiting_vehicles.size()) + "/" + to_string(MAX_WAITING_QUEUE) + "\n");
-    
-    if (!lot.waiting_vehicles.empty()) {
-        cout << ("Waiting Vehicles:\n");
-        for (size_t i = 0; i < lot.waiting_vehicles.size(); i++) {
-            cout << ("  " + to_string(i + 1) + ". " + lot.waiting_vehicles[i].type 
-                 + " (ID: " + to_string(lot.waiting_vehicles[i].id) + ")\n");
+    while (true) {
+        bool stopping = service.stopping.load();
+        bool flush = stopping || shuttingDown(sim_context);
+        service.next_wake_ns.store(LLONG_MAX);
+        long long now = monotonicNowNs();
+        long long next = now + 100000000LL;
+        
+        for (int i = 0; i < service.lot_count; i++) {
+            ParkingLot& lot = *service.lots[i];
+            pthread_mutex_lock(&lot.departures_lock);
+            if (flush) drainTimerWheel(lot.departures, due);
+            else advanceTimerWheel(lot.departures, now, due);
+            next = min(next, nextTimerWheelWakeNs(lot.departures));
+            pthread_mutex_unlock(&lot.departures_lock);
+        }
+        
+        if (!due.empty()) {
+            service.stats.batches++;
+            service.stats.departed += (long)due.size();
+            service.stats.largest_batch = max(service.stats.largest_batch, (long)due.size());
+            for (size_t i = 0; i < due.size(); i++) due[i].fire(due[i].ctx);
+            due.clear();
+            continue;       // callbacks take time and may park again; rescan before sleeping
+        }
+        if (stopping) break;
+        
+        pthread_mutex_lock(&service.lock);
+        service.next_wake_ns.store(flush ? now + 10000000LL : next);
+        if (!service.rescan && !service.stopping.load()) {
+            struct timespec deadline = {(time_t)(service.next_wake_ns.load() / 1000000000LL),
+                                        (long)(service.next_wake_ns.load() % 1000000000LL)};
+            pthread_cond_timedwait(&service.wake, &service.lock, &deadline);
         }
-    } else {
-        cout << ("Waiting Vehicles: None\n");
+        service.rescan = false;
+        pthread_mutex_unlock(&service.lock);
     }
-    
-    cout << ("========================================\n");
-    
-    sem_post(&lot.access_lock);
+    return NULL;
+}
+
+inline void startDepartureService(DepartureService& service) {
+    pthread_create(&service.tid, NULL, departureServiceThread, &service);
+}
+
+// Returns after every departure still pending has fired
+inline void stopDepartureService(DepartureService& service) {
+    pthread_mutex_lock(&service.lock);
+    service.stopping.store(true);
+    pthread_cond_signal(&service.wake);
+    pthread_mutex_unlock(&service.lock);
+    pthread_join(service.tid, NULL);
+}
+
+#if CORO_ENGINE_AVAILABLE
+inline void resumeParkedCoroutine(void* ctx) {
+    scheduleCoroutine(coroutine_handle<>::from_address(ctx));
+}
+
+// co_await ParkedUntil{...}: the frame sits in the lot's departure wheel and
+// is rescheduled by the departure service
+struct ParkedUntil {
+    DepartureService* service;
+    ParkingLot* lot;
+    long long due_ns;
+
+    bool await_ready() const noexcept { return shuttingDown(sim_context); }
+    void await_suspend(coroutine_handle<> h) {
+        scheduleDeparture(*service, *lot, due_ns, resumeParkedCoroutine, h.address());
+    }
+    void await_resume() const noexcept {}
+};
+#endif
+
+inline void printDepartureReport(const DepartureService& service) {
+    const DepartureStats& s = service.stats;
+    string line = "  Parking departures: " + to_string(s.departed) + " in " + to_string(s.batches)
+                + " batches (largest " + to_string(s.largest_batch) + "), peak parked";
+    for (int i = 0; i < service.lot_count; i++) {
+        const TimerWheel& w = service.lots[i]->departures;
+        line += " " + service.lots[i]->intersection_id + " " + to_string(w.peak_pending) + " ("
+              + to_string(timerWheelBytes(w)) + " bytes)";
+        if (i + 1 < service.lot_count) line += ",";
+    }
+    cout << (line + "\n");
 }
 
 inline void printParkingEntry(int vehicle_id, string vehicle_type, string intersection_id) {
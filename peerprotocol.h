@@ -0,0 +1,242 @@
+#ifndef PEERPROTOCOL_H
+#define PEERPROTOCOL_H
+
+// Framed binary protocol on the controller peer pipes. A frame is a fixed
+// 24-byte header (magic, type, source, payload length, sequence number,
+// CLOCK_MONOTONIC send time) followed by payload_bytes of payload; clear and
+// shutdown frames carry none. Senders append frames to the pipe's outbox;
+// whoever finds no flush in progress becomes the flusher and writes
+// everything queued with one writev, so concurrent senders share syscalls
+// without waiting out a batching window. A batch stays within PIPE_BUF, so it
+// lands in the pipe whole. The reader takes whatever the pipe holds with one
+// read and splits it into frames, keeping a partial frame for the next read.
+// Sequence numbers count per outbox, so a gap at the reader is a frame the
+// full (non-blocking) pipe refused.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include "simulation.h"
+
+using namespace std;
+
+const uint16_t PEER_FRAME_MAGIC = 0x4654;
+const uint8_t PEER_SOURCE_SIMULATOR = 0xff;     // sent by the simulation rather than a controller
+const int PEER_BATCH_FRAMES = 32;               // frames per writev
+const int PEER_READ_BYTES = 4096;
+const int PEER_SOURCES = 256;
+
+struct PeerFrameHeader {
+    uint16_t magic;
+    uint8_t type;               // MSG_*
+    uint8_t source;             // sending intersection, or PEER_SOURCE_SIMULATOR
+    uint16_t payload_bytes;
+    uint16_t reserved;
+    uint32_t seq;
+    uint32_t reserved2;
+    int64_t sent_ns;
+};
+
+// Emergency, transit priority and plan decision payload
+struct PeerPayload {
+    int32_t vehicle_id;
+    uint8_t direction;          // emergency: EMERGENCY_EASTBOUND or EMERGENCY_WESTBOUND; plan decision: the plan
+    uint8_t approach;           // transit priority: the bus's approach, in SPAWN_SIDES order
+    uint16_t step;              // plan decision: the green step it was made in
+    int64_t eta_ns;             // when the vehicle reaches this controller's stop line
+};
+
+struct PeerFrame {
+    PeerFrameHeader header;
+    PeerPayload payload;
+};
+
+static_assert(sizeof(PeerFrameHeader) == 24 && sizeof(PeerPayload) == 16, "peer frame layout changed");
+static_assert(sizeof(PeerFrame) * PEER_BATCH_FRAMES <= PIPE_BUF, "a peer batch must be one atomic pipe write");
+
+struct PeerOutboxStats {
+    long frames;
+    long writes;
+    long dropped;
+    long peak_batch;
+};
+
+struct PeerOutbox {
+    int fd;
+    uint8_t source;
+    pthread_mutex_t lock;
+    bool flushing;
+    uint32_t next_seq;
+    vector<PeerFrame> queued;
+    vector<PeerFrame> sending;  // the flusher's batch, written outside the lock
+    PeerOutboxStats stats;
+};
+
+struct PeerReaderStats {
+    long frames;
+    long reads;
+    long lost;                  // sequence gaps
+    long corrupt;               // bytes discarded after a bad header
+};
+
+struct PeerReader {
+    char buf[PEER_READ_BYTES];
+    size_t start;
+    size_t used;
+    bool seen[PEER_SOURCES];
+    uint32_t next_seq[PEER_SOURCES];
+    PeerReaderStats stats;
+};
+
+inline void initPeerOutbox(PeerOutbox& out, int fd, uint8_t source) {
+    out.fd = fd;
+    out.source = source;
+    pthread_mutex_init(&out.lock, NULL);
+    out.flushing = false;
+    out.next_seq = 0;
+    out.queued.reserve(PEER_BATCH_FRAMES);
+    out.sending.reserve(PEER_BATCH_FRAMES);
+    memset(&out.stats, 0, sizeof(out.stats));
+}
+
+inline void destroyPeerOutbox(PeerOutbox& out) {
+    pthread_mutex_destroy(&out.lock);
+}
+
+// One writev per PEER_BATCH_FRAMES frames; a pipe too full for the batch drops all of it
+inline void writePeerBatch(PeerOutbox& out, const vector<PeerFrame>& frames, long& writes, long& dropped) {
+    struct iovec iov[PEER_BATCH_FRAMES * 2];
+    for (size_t first = 0; first < frames.size(); first += PEER_BATCH_FRAMES) {
+        size_t count = min(frames.size() - first, (size_t)PEER_BATCH_FRAMES);
+        int n = 0;
+        for (size_t k = first; k < first + count; k++) {
+            iov[n].iov_base = (void*)&frames[k].header;
+            iov[n++].iov_len = sizeof(PeerFrameHeader);
+            if (frames[k].header.payload_bytes == 0) continue;
+            iov[n].iov_base = (void*)&frames[k].payload;
+            iov[n++].iov_len = frames[k].header.payload_bytes;
+        }
+        writes++;
+        if (writev(out.fd, iov, n) < 0) dropped += (long)count;
+    }
+}
+
+inline void sendPeerFrame(PeerOutbox& out, char type, const PeerPayload* payload) {
+    PeerFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.header.magic = PEER_FRAME_MAGIC;
+    frame.header.type = (uint8_t)type;
+    frame.header.source = out.source;
+    if (payload != NULL) {
+        frame.header.payload_bytes = sizeof(PeerPayload);
+        frame.payload = *payload;
+    }
+
+    pthread_mutex_lock(&out.lock);
+    frame.header.seq = out.next_seq++;
+    frame.header.sent_ns = monotonicNowNs();
+    out.queued.push_back(frame);
+    if (out.flushing) {
+        pthread_mutex_unlock(&out.lock);
+        return;
+    }
+
+    out.flushing = true;
+    while (!out.queued.empty()) {
+        out.sending.swap(out.queued);
+        long batch = (long)out.sending.size();
+        long writes = 0, dropped = 0;
+        pthread_mutex_unlock(&out.lock);
+        writePeerBatch(out, out.sending, writes, dropped);
+        pthread_mutex_lock(&out.lock);
+        out.sending.clear();
+        out.stats.frames += batch;
+        out.stats.writes += writes;
+        out.stats.dropped += dropped;
+        if (batch > out.stats.peak_batch) out.stats.peak_batch = batch;
+    }
+    out.flushing = false;
+    pthread_mutex_unlock(&out.lock);
+}
+
+inline void initPeerReader(PeerReader& r) {
+    r.start = 0;
+    r.used = 0;
+    memset(r.seen, 0, sizeof(r.seen));
+    memset(r.next_seq, 0, sizeof(r.next_seq));
+    memset(&r.stats, 0, sizeof(r.stats));
+}
+
+inline int parsePeerFrames(PeerReader& r, PeerFrame* out, int max) {
+    int n = 0;
+    while (n < max && r.used - r.start >= sizeof(PeerFrameHeader)) {
+        PeerFrame& f = out[n];
+        memcpy(&f.header, r.buf + r.start, sizeof(PeerFrameHeader));
+        if (f.header.magic != PEER_FRAME_MAGIC || f.header.payload_bytes > sizeof(PeerPayload)) {
+            // Nothing to resynchronize on; drop what is buffered
+            r.stats.corrupt += (long)(r.used - r.start);
+            r.start = r.used = 0;
+            break;
+        }
+        size_t length = sizeof(PeerFrameHeader) + f.header.payload_bytes;
+        if (r.used - r.start < length) break;
+
+        memset(&f.payload, 0, sizeof(f.payload));
+        memcpy(&f.payload, r.buf + r.start + sizeof(PeerFrameHeader), f.header.payload_bytes);
+        r.start += length;
+
+        uint8_t source = f.header.source;
+        if (r.seen[source] && f.header.seq != r.next_seq[source]) r.stats.lost += (long)(f.header.seq - r.next_seq[source]);
+        r.seen[source] = true;
+        r.next_seq[source] = f.header.seq + 1;
+        r.stats.frames++;
+        n++;
+    }
+    if (r.start == r.used) r.start = r.used = 0;
+    return n;
+}
+
+// Frames already buffered, else one read of everything the (non-blocking) pipe holds; 0 once it is empty
+inline int readPeerFrames(PeerReader& r, int fd, PeerFrame* out, int max) {
+    int n = parsePeerFrames(r, out, max);
+    if (n > 0) return n;
+
+    if (r.start > 0) {
+        memmove(r.buf, r.buf + r.start, r.used - r.start);
+        r.used -= r.start;
+        r.start = 0;
+    }
+    ssize_t got = read(fd, r.buf + r.used, sizeof(r.buf) - r.used);
+    if (got <= 0) return 0;
+    r.stats.reads++;
+    r.used += (size_t)got;
+    return parsePeerFrames(r, out, max);
+}
+
+inline void printPeerOutboxReport(const string& label, const PeerOutboxStats& s) {
+    string line = "  " + label + ": " + to_string(s.frames) + " frames in " + to_string(s.writes) + " writev calls";
+    if (s.writes > 0) {
+        char ratio[32];
+        snprintf(ratio, sizeof(ratio), "%.2f", (double)s.frames / s.writes);
+        line += " (" + string(ratio) + " per call, largest batch " + to_string(s.peak_batch) + ")";
+    }
+    line += ", " + to_string(s.dropped) + " dropped";
+    cout << (line + "\n");
+}
+
+inline void printPeerReaderReport(const string& id, const PeerReaderStats& s) {
+    string line = "Controller " + id + " peer pipe: " + to_string(s.frames) + " frames in " + to_string(s.reads) + " reads";
+    line += ", " + to_string(s.lost) + " lost";
+    if (s.corrupt > 0) line += ", " + to_string(s.corrupt) + " bytes discarded";
+    cout << (line + "\n");
+}
+
+#endif // PEERPROTOCOL_H
@@ -0,0 +1,293 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+// Optional per-region performance counters (--perf). Each thread lazily opens
+// one perf_event_open group on itself (task clock as leader, then cycles,
+// instructions, cache misses and branch misses, each only if the host
+// supports it) and reads the whole group with one read() at both ends of a
+// region. Counting is user-space only, so context switches always come from
+// getrusage. Without perf_event_open (container, seccomp, paranoid setting)
+// the task clock falls back to thread CPU time. Regions are inclusive: a log
+// line inside a crossing counts in both.
+
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "simulation.h"
+
+using namespace std;
+
+enum PerfRegionId {
+    PERF_SPAWN,
+    PERF_QUEUE_WAIT,
+    PERF_CROSSING,
+    PERF_PARKING,
+    PERF_LINK,
+    PERF_MICRO_STEP,
+    PERF_LOGGING,
+    PERF_NUM_REGIONS
+};
+const string PERF_REGION_NAMES[] = {"spawn", "queue/wait", "crossing", "parking", "link", "micro step", "logging"};
+
+enum PerfThreadRole {
+    PERF_ROLE_MAIN,
+    PERF_ROLE_SPAWNER,
+    PERF_ROLE_VEHICLE,
+    PERF_ROLE_LISTENER,
+    PERF_ROLE_SCHEDULER,
+    PERF_ROLE_MICRO,
+    PERF_NUM_ROLES
+};
+const string PERF_ROLE_NAMES[] = {"main", "spawner", "vehicle", "listener", "scheduler", "micro"};
+
+// Counter slots; all but PERF_CONTEXT_SWITCHES are perf group members
+enum PerfCounterId {
+    PERF_TASK_CLOCK,
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_CONTEXT_SWITCHES,
+    PERF_NUM_COUNTERS
+};
+const string PERF_COUNTER_NAMES[] = {"cpu ms", "cycles", "instructions", "cache misses", "branch misses", "ctx switches"};
+
+struct PerfRegionTotals {
+    atomic<long> calls;
+    atomic<long long> wall_ns;
+    atomic<long long> counters[PERF_NUM_COUNTERS];
+};
+
+struct PerfState {
+    bool enabled;
+    atomic<int> mode;               // 0 software timing, 1 perf_event_open
+    int available;                  // bit per PerfCounterId the host provides
+    string fallback_reason;
+    PerfRegionTotals totals[PERF_NUM_ROLES][PERF_NUM_REGIONS];
+};
+
+extern PerfState perf_state;
+
+// One thread's counter group; closed when the thread exits
+struct PerfThreadCounters {
+    int leader_fd;
+    int fds[PERF_NUM_COUNTERS];
+    int slot[PERF_NUM_COUNTERS];    // position in the group read, -1 if not opened
+    int members;
+    bool opened;
+    int role;
+
+    PerfThreadCounters() : leader_fd(-1), members(0), opened(false), role(PERF_ROLE_MAIN) {
+        for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+            fds[c] = -1;
+            slot[c] = -1;
+        }
+    }
+
+    ~PerfThreadCounters() {
+        for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+            if (fds[c] >= 0) close(fds[c]);
+        }
+    }
+};
+
+inline PerfThreadCounters& perfThreadCounters() {
+    static thread_local PerfThreadCounters counters;
+    return counters;
+}
+
+inline void perfSetThreadRole(int role) {
+    if (perf_state.enabled) perfThreadCounters().role = role;
+}
+
+inline int perfEventOpen(uint32_t type, uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = (group_fd == -1);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+// Opens what the host supports; available gets a bit per opened counter
+inline bool perfOpenThreadCounters(PerfThreadCounters& t, int& available) {
+    static const uint32_t types[PERF_CONTEXT_SWITCHES] = {
+        PERF_TYPE_SOFTWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+    static const uint64_t configs[PERF_CONTEXT_SWITCHES] = {
+        PERF_COUNT_SW_TASK_CLOCK, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+    t.opened = true;
+    t.leader_fd = perfEventOpen(types[0], configs[0], -1);
+    if (t.leader_fd < 0) return false;
+    t.fds[0] = t.leader_fd;
+    t.slot[0] = 0;
+    t.members = 1;
+
+    available = (1 << PERF_TASK_CLOCK) | (1 << PERF_CONTEXT_SWITCHES);
+    for (int c = 1; c < PERF_CONTEXT_SWITCHES; c++) {
+        t.fds[c] = perfEventOpen(types[c], configs[c], t.leader_fd);
+        if (t.fds[c] >= 0) {
+            t.slot[c] = t.members++;
+            available |= 1 << c;
+        }
+    }
+    ioctl(t.leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+// Decides once per run whether hardware/software perf events can be used
+inline void perfProbe() {
+    PerfThreadCounters& t = perfThreadCounters();
+    int available = 0;
+    bool ok = perfOpenThreadCounters(t, available);
+    if (ok) {
+        perf_state.available = available;
+    } else {
+        perf_state.fallback_reason = strerror(errno);
+        perf_state.available = (1 << PERF_TASK_CLOCK) | (1 << PERF_CONTEXT_SWITCHES);
+    }
+    perf_state.mode = ok ? 1 : 0;
+}
+
+struct PerfSample {
+    long long wall_ns;
+    long long values[PERF_NUM_COUNTERS];
+};
+
+inline long long clockNs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+inline void perfSample(PerfSample& s) {
+    memset(s.values, 0, sizeof(s.values));
+    s.wall_ns = monotonicNowNs();
+    PerfThreadCounters& t = perfThreadCounters();
+
+    // Voluntary (blocked) plus involuntary (preempted) switches
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    s.values[PERF_CONTEXT_SWITCHES] = usage.ru_nvcsw + usage.ru_nivcsw;
+
+    if (perf_state.mode.load(memory_order_relaxed) == 1) {
+        int available;
+        if (!t.opened) perfOpenThreadCounters(t, available);
+        if (t.leader_fd >= 0) {
+            uint64_t buf[1 + PERF_NUM_COUNTERS];
+            if (read(t.leader_fd, buf, sizeof(uint64_t) * (1 + t.members)) > 0) {
+                for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+                    if (t.slot[c] >= 0) s.values[c] = (long long)buf[1 + t.slot[c]];
+                }
+            }
+            return;
+        }
+        // Out of descriptors for this thread: software timing, hardware counters read as 0
+    }
+    s.values[PERF_TASK_CLOCK] = clockNs(CLOCK_THREAD_CPUTIME_ID);
+}
+
+// Scoped region: PerfRegion r(PERF_CROSSING); costs one branch when --perf is off
+struct PerfRegion {
+    int region;
+    bool active;
+    PerfSample start;
+
+    explicit PerfRegion(int id) : region(id), active(perf_state.enabled) {
+        if (active) perfSample(start);
+    }
+
+    ~PerfRegion() {
+        if (!active) return;
+        PerfSample end;
+        perfSample(end);
+        PerfRegionTotals& totals = perf_state.totals[perfThreadCounters().role][region];
+        totals.calls.fetch_add(1, memory_order_relaxed);
+        totals.wall_ns.fetch_add(end.wall_ns - start.wall_ns, memory_order_relaxed);
+        for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+            totals.counters[c].fetch_add(end.values[c] - start.values[c], memory_order_relaxed);
+        }
+    }
+};
+
+inline void initPerfCounters(bool enabled) {
+    perf_state.enabled = enabled;
+    perf_state.mode = 0;
+    perf_state.available = 0;
+    for (int r = 0; r < PERF_NUM_ROLES; r++) {
+        for (int g = 0; g < PERF_NUM_REGIONS; g++) {
+            PerfRegionTotals& totals = perf_state.totals[r][g];
+            totals.calls = 0;
+            totals.wall_ns = 0;
+            for (int c = 0; c < PERF_NUM_COUNTERS; c++) totals.counters[c] = 0;
+        }
+    }
+    if (enabled) perfProbe();
+}
+
+inline string perfCell(const PerfRegionTotals& totals, int counter) {
+    if (!(perf_state.available & (1 << counter))) return "-";
+    long long value = totals.counters[counter].load();
+    if (counter != PERF_TASK_CLOCK) return to_string(value);
+    char ms[32];
+    snprintf(ms, sizeof(ms), "%.1f", value / 1e6);
+    return ms;
+}
+
+inline void printPerfReport() {
+    if (!perf_state.enabled) return;
+    bool hardware = perf_state.mode.load() == 1;
+    cout << ("Performance Counters (" + string(hardware ? "perf_event_open" : "software timing: perf_event_open "
+             + perf_state.fallback_reason) + ", regions inclusive):\n");
+
+    char line[256];
+    snprintf(line, sizeof(line), "  %-10s %-11s %8s %10s", "thread", "region", "calls", "wall ms");
+    string header = line;
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        snprintf(line, sizeof(line), " %13s", PERF_COUNTER_NAMES[c].c_str());
+        header += line;
+    }
+    cout << (header + "  IPC\n");
+
+    for (int r = 0; r < PERF_NUM_ROLES; r++) {
+        for (int g = 0; g < PERF_NUM_REGIONS; g++) {
+            const PerfRegionTotals& totals = perf_state.totals[r][g];
+            long calls = totals.calls.load();
+            if (calls == 0) continue;
+
+            snprintf(line, sizeof(line), "  %-10s %-11s %8ld %10.1f", PERF_ROLE_NAMES[r].c_str(),
+                     PERF_REGION_NAMES[g].c_str(), calls, totals.wall_ns.load() / 1e6);
+            string row = line;
+            for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+                snprintf(line, sizeof(line), " %13s", perfCell(totals, c).c_str());
+                row += line;
+            }
+            long long cycles = totals.counters[PERF_CYCLES].load();
+            bool have_ipc = (perf_state.available & (1 << PERF_CYCLES)) && (perf_state.available & (1 << PERF_INSTRUCTIONS));
+            if (have_ipc && cycles > 0) {
+                snprintf(line, sizeof(line), "  %.2f", (double)totals.counters[PERF_INSTRUCTIONS].load() / cycles);
+                row += line;
+            } else {
+                row += "  -";
+            }
+            cout << (row + "\n");
+        }
+    }
+}
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,251 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+// CPU and NUMA placement (--placement). With the dedicated policy the signal
+// controllers and the light-state listener share reserved "control" CPUs, so
+// light changes travel between caches that stay warm, while the main thread
+// is confined to the remaining "worker" CPUs before it starts anything else:
+// the spawner, vehicle threads, scheduler/micro workers and link drains
+// inherit that mask. On multi-node hosts shared simulation state is
+// allocated on the control CPUs' node and every thread started afterwards
+// allocates node-locally. Topology comes from sched_getaffinity and sysfs, so
+// no libnuma is needed.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "simulation.h"
+
+using namespace std;
+
+enum PlacementPolicy {
+    PLACEMENT_NONE,
+    PLACEMENT_DEDICATED
+};
+const string PLACEMENT_NAMES[] = {"none", "dedicated"};
+
+const int MAX_NUMA_NODES = 64;
+
+struct Placement {
+    int policy;
+    bool applied;                   // false: nothing pinned, see note
+    string note;
+    vector<int> allowed_cpus;       // what this process may run on
+    vector<int> control_cpus;
+    vector<int> worker_cpus;
+    int nodes;
+    int control_node;
+};
+
+// "0-3,8,10-11" as used by sysfs and --control-cpus
+inline bool parseCpuList(const string& text, vector<int>& cpus) {
+    cpus.clear();
+    const char* p = text.c_str();
+    while (*p != '\0' && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= CPU_SETSIZE) return false;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first || last >= CPU_SETSIZE) return false;
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++) cpus.push_back((int)cpu);
+        if (*p == ',') p++;
+        else if (*p != '\0' && *p != '\n') return false;
+    }
+    return !cpus.empty();
+}
+
+inline string formatCpuList(const vector<int>& cpus) {
+    string text;
+    for (size_t i = 0; i < cpus.size(); i++) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) j++;
+        if (!text.empty()) text += ",";
+        text += to_string(cpus[i]);
+        if (j > i) text += "-" + to_string(cpus[j]);
+        i = j;
+    }
+    return text.empty() ? "none" : text;
+}
+
+inline bool containsCpu(const vector<int>& cpus, int cpu) {
+    for (size_t i = 0; i < cpus.size(); i++) {
+        if (cpus[i] == cpu) return true;
+    }
+    return false;
+}
+
+inline void fillCpuSet(const vector<int>& cpus, cpu_set_t& set) {
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < cpus.size(); i++) CPU_SET(cpus[i], &set);
+}
+
+inline vector<int> cpusInSet(const cpu_set_t& set) {
+    vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+struct NumaNode {
+    int id;
+    vector<int> cpus;
+};
+
+// Empty without sysfs; node ids may have gaps
+inline vector<NumaNode> readNumaNodes() {
+    vector<NumaNode> nodes;
+    for (int id = 0; id < MAX_NUMA_NODES; id++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+        FILE* f = fopen(path, "r");
+        if (f == NULL) continue;
+        char line[1024];
+        NumaNode node;
+        node.id = id;
+        if (fgets(line, sizeof(line), f) != NULL && parseCpuList(line, node.cpus)) nodes.push_back(node);
+        fclose(f);
+    }
+    return nodes;
+}
+
+// Control CPUs default to the last allowed CPU: CPU 0 tends to take the
+// most device interrupts
+inline bool planPlacement(Placement& p, int policy, const string& control_list) {
+    p.policy = policy;
+    p.applied = false;
+    p.control_cpus.clear();
+    p.worker_cpus.clear();
+    p.control_node = 0;
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) CPU_ZERO(&allowed);
+    p.allowed_cpus = cpusInSet(allowed);
+    vector<NumaNode> nodes = readNumaNodes();
+    p.nodes = nodes.empty() ? 1 : (int)nodes.size();
+
+    if (policy == PLACEMENT_NONE) {
+        p.note = "threads and controllers float across CPUs " + formatCpuList(p.allowed_cpus);
+        return true;
+    }
+
+    if (!control_list.empty()) {
+        if (!parseCpuList(control_list, p.control_cpus)) {
+            cerr << ("--control-cpus expects a list such as 2 or 2-3,6\n");
+            return false;
+        }
+        for (size_t i = 0; i < p.control_cpus.size(); i++) {
+            if (!containsCpu(p.allowed_cpus, p.control_cpus[i])) {
+                cerr << ("--control-cpus: CPU " + to_string(p.control_cpus[i]) + " is not available to this process ("
+                         + formatCpuList(p.allowed_cpus) + ")\n");
+                return false;
+            }
+        }
+    } else if (!p.allowed_cpus.empty()) {
+        p.control_cpus.push_back(p.allowed_cpus.back());
+    }
+
+    for (size_t i = 0; i < p.allowed_cpus.size(); i++) {
+        if (!containsCpu(p.control_cpus, p.allowed_cpus[i])) p.worker_cpus.push_back(p.allowed_cpus[i]);
+    }
+    if (p.control_cpus.empty() || p.worker_cpus.empty()) {
+        p.note = "not applied: " + to_string(p.allowed_cpus.size())
+               + " CPU(s) available, dedicated placement needs a control and a worker CPU";
+        p.control_cpus.clear();
+        p.worker_cpus.clear();
+        return true;
+    }
+
+    for (size_t n = 0; n < nodes.size(); n++) {
+        if (containsCpu(nodes[n].cpus, p.control_cpus[0])) p.control_node = nodes[n].id;
+    }
+    p.applied = true;
+    return true;
+}
+
+inline bool pinCurrentThread(const vector<int>& cpus) {
+    cpu_set_t set;
+    fillCpuSet(cpus, set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) errno = rc;
+    return rc == 0;
+}
+
+inline string currentThreadCpus() {
+    cpu_set_t set;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0) return "unknown";
+    return formatCpuList(cpusInSet(set));
+}
+
+// Calling-thread memory policy; inherited by threads it creates afterwards
+inline bool preferMemoryNode(int node) {
+    unsigned long mask[MAX_NUMA_NODES / (8 * sizeof(unsigned long))] = {0};
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    return syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, MAX_NUMA_NODES + 1) == 0;
+}
+
+inline bool useLocalMemory() {
+    return syscall(SYS_set_mempolicy, MPOL_LOCAL, NULL, 0) == 0;
+}
+
+// SCHED_FIFO for the calling thread; needs CAP_SYS_NICE or an RLIMIT_RTPRIO
+// of at least priority, otherwise false with errno set
+inline bool applyRealtimePriority(int priority) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (rc != 0) errno = rc;
+    return rc == 0;
+}
+
+// Main thread, before any other thread exists
+inline void applyWorkerPlacement(const Placement& p) {
+    if (!p.applied) return;
+    if (!pinCurrentThread(p.worker_cpus)) perror("pthread_setaffinity_np (worker CPUs)");
+    if (p.nodes > 1 && !preferMemoryNode(p.control_node)) perror("set_mempolicy (shared state)");
+}
+
+// Shared state is allocated; everything started from here allocates locally
+inline void endSharedAllocation(const Placement& p) {
+    if (p.applied && p.nodes > 1) useLocalMemory();
+}
+
+// Forked controllers and the listener
+inline void applyControlPlacement(const Placement& p) {
+    if (!p.applied) return;
+    if (!pinCurrentThread(p.control_cpus)) perror("pthread_setaffinity_np (control CPUs)");
+    if (p.nodes > 1) preferMemoryNode(p.control_node);
+}
+
+inline void printPlacementReport(const Placement& p, const string& listener_cpus) {
+    cout << ("Placement Report (" + PLACEMENT_NAMES[p.policy] + ", " + to_string(p.nodes) + " NUMA node(s)):\n");
+    if (!p.applied) {
+        cout << ("  " + p.note + "\n");
+    } else {
+        cout << ("  Control CPUs " + formatCpuList(p.control_cpus) + " (node " + to_string(p.control_node)
+                 + "): F10/F11 controllers, light-state listener (running on " + listener_cpus + ")\n");
+        cout << ("  Worker CPUs " + formatCpuList(p.worker_cpus)
+                 + ": main, spawner, vehicles, scheduler/micro workers, link drains\n");
+        if (p.nodes > 1) {
+            cout << ("  Memory: shared state preferred on node " + to_string(p.control_node)
+                     + ", threads allocate node-locally\n");
+        }
+    }
+}
+
+#endif // PLACEMENT_H
@@ -0,0 +1,555 @@
+#ifndef SIGNALPLAN_H
+#define SIGNALPLAN_H
+
+// Signal plans as data. A plan is a list of phases, each giving the approaches
+// that move together and its timings; compileSignalPlan flattens it into a
+// table of light states, so the controller loop only ever advances an index
+// and publishes one packed state word.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "simulation.h"
+#include "intersection.h"
+#include "lifecycle.h"
+#include "latency.h"
+#include "transport.h"
+#include "peerprotocol.h"
+#include "log.h"
+
+using namespace std;
+
+// Movement sets: bit i is approach SPAWN_SIDES[i]
+const uint8_t MOVE_NORTH = 1 << 0;
+const uint8_t MOVE_SOUTH = 1 << 1;
+const uint8_t MOVE_EAST = 1 << 2;
+const uint8_t MOVE_WEST = 1 << 3;
+
+struct SignalPhase {
+    string name;
+    uint8_t movements;
+    int min_green_us;
+    int max_green_us;       // upper bound for any green extension
+    int yellow_us;
+    int all_red_us;
+};
+
+struct SignalPlan {
+    int intersection;       // index into INTERSECTION_IDS
+    vector<SignalPhase> phases;
+    int offset_us;          // cycle start, measured from the shared reference time
+};
+
+struct SignalStep {
+    uint8_t lights;
+    uint8_t phase;
+    uint8_t green_movements;    // movements released by this step, 0 if none
+    int duration_us;
+    int start_us;               // position within the cycle
+    string label;
+};
+
+struct CompiledSignalPlan {
+    int intersection;
+    vector<SignalStep> steps;
+    vector<SignalPhase> phases;
+    int cycle_us;
+    int offset_us;
+};
+
+// Packed light states: two bits per approach in SPAWN_SIDES order
+inline uint8_t lightOf(uint8_t lights, int side) {
+    return (lights >> (side * 2)) & 3;
+}
+
+inline uint8_t packLights(uint8_t movements, uint8_t state) {
+    uint8_t lights = 0;
+    for (int side = 0; side < NUM_SIDES; side++) {
+        if (movements & (1 << side)) lights |= state << (side * 2);
+    }
+    return lights;
+}
+
+inline string movementName(uint8_t movements) {
+    string name;
+    for (int side = 0; side < NUM_SIDES; side++) {
+        if (!(movements & (1 << side))) continue;
+        if (!name.empty()) name += "-";
+        name += SPAWN_SIDES[side];
+    }
+    return name.empty() ? "NONE" : name;
+}
+
+// The original two-phase fixed-time plan: north-south, then east-west
+inline SignalPlan defaultSignalPlan(int intersection) {
+    SignalPlan plan;
+    plan.intersection = intersection;
+    plan.offset_us = 0;
+
+    SignalPhase ns = {"NORTH-SOUTH", (uint8_t)(MOVE_NORTH | MOVE_SOUTH), GREEN_DURATION, MAX_GREEN_DURATION,
+                      YELLOW_DURATION, 0};
+    SignalPhase ew = {"EAST-WEST", (uint8_t)(MOVE_EAST | MOVE_WEST), GREEN_DURATION, MAX_GREEN_DURATION,
+                      YELLOW_DURATION, 0};
+    plan.phases.push_back(ns);
+    plan.phases.push_back(ew);
+    return plan;
+}
+
+inline bool compileSignalPlan(const SignalPlan& plan, CompiledSignalPlan& out) {
+    if (plan.phases.empty() || plan.phases.size() > 255) {
+        cerr << ("Signal plan needs between 1 and 255 phases\n");
+        return false;
+    }
+
+    out.intersection = plan.intersection;
+    out.steps.clear();
+    out.phases = plan.phases;
+    out.cycle_us = 0;
+
+    for (size_t p = 0; p < plan.phases.size(); p++) {
+        const SignalPhase& phase = plan.phases[p];
+        if (phase.movements == 0 || phase.min_green_us <= 0 || phase.max_green_us < phase.min_green_us
+            || phase.yellow_us < 0 || phase.all_red_us < 0) {
+            cerr << ("Signal plan phase " + phase.name + " has invalid movements or timings\n");
+            return false;
+        }
+
+        SignalStep green = {packLights(phase.movements, LIGHT_GREEN), (uint8_t)p, phase.movements,
+                            phase.min_green_us, out.cycle_us, phase.name + " -> GREEN"};
+        out.steps.push_back(green);
+        out.cycle_us += phase.min_green_us;
+
+        if (phase.yellow_us > 0) {
+            SignalStep yellow = {packLights(phase.movements, LIGHT_YELLOW), (uint8_t)p, 0,
+                                 phase.yellow_us, out.cycle_us, phase.name + " -> YELLOW"};
+            out.steps.push_back(yellow);
+            out.cycle_us += phase.yellow_us;
+        }
+
+        // All-red clearance; a zero-length one still publishes the red
+        SignalStep red = {0, (uint8_t)p, 0, phase.all_red_us, out.cycle_us, phase.name + " -> RED"};
+        out.steps.push_back(red);
+        out.cycle_us += phase.all_red_us;
+    }
+
+    out.offset_us = (plan.offset_us % out.cycle_us + out.cycle_us) % out.cycle_us;
+    return true;
+}
+
+// Position within the cycle at `elapsed_us` after the shared reference
+inline long long cyclePosition(const CompiledSignalPlan& plan, long long elapsed_us) {
+    long long pos = (elapsed_us - plan.offset_us) % plan.cycle_us;
+    return (pos < 0) ? pos + plan.cycle_us : pos;
+}
+
+// The step in force at a cycle position (the last one starting at or before it)
+inline size_t stepAt(const CompiledSignalPlan& plan, long long pos_us) {
+    size_t step = 0;
+    for (size_t s = 0; s < plan.steps.size(); s++) {
+        if (plan.steps[s].start_us <= pos_us && plan.steps[s].duration_us > 0) step = s;
+    }
+    return step;
+}
+
+inline bool isGreenAt(const CompiledSignalPlan& plan, int side, long long elapsed_us) {
+    const SignalStep& step = plan.steps[stepAt(plan, cyclePosition(plan, elapsed_us))];
+    return lightOf(step.lights, side) == LIGHT_GREEN;
+}
+
+// Earliest time at or after `elapsed_us` when the approach shows green
+inline long long nextGreenUs(const CompiledSignalPlan& plan, int side, long long elapsed_us) {
+    long long pos = cyclePosition(plan, elapsed_us);
+    if (lightOf(plan.steps[stepAt(plan, pos)].lights, side) == LIGHT_GREEN) return elapsed_us;
+
+    long long cycle_start = elapsed_us - pos;
+    for (int lap = 0; lap < 2; lap++) {
+        for (size_t s = 0; s < plan.steps.size(); s++) {
+            const SignalStep& step = plan.steps[s];
+            long long start = cycle_start + (long long)lap * plan.cycle_us + step.start_us;
+            if (start > elapsed_us && step.duration_us > 0 && lightOf(step.lights, side) == LIGHT_GREEN) {
+                return start;
+            }
+        }
+    }
+    return elapsed_us;    // the approach is never green in this plan
+}
+
+// Writes decoded lights into an intersection's controllers; returns the
+// movements that turned green with this state
+inline uint8_t applyLightState(Intersection& intersection, uint8_t previous, uint8_t lights) {
+    Intersection::Lights decoded;
+    uint8_t turned_green = 0;
+    for (int side = 0; side < NUM_SIDES; side++) {
+        decoded[side] = lightOf(lights, side);
+        if (decoded[side] == LIGHT_GREEN && lightOf(previous, side) != LIGHT_GREEN) turned_green |= 1 << side;
+    }
+    intersection.lights = decoded;
+    return turned_green;
+}
+
+// Where a controller sends its light states and listens for its peer
+struct SignalControllerIO {
+    LightChannel publish;
+    int peer_read_fd;       // non-blocking; -1 if there is no peer
+    int wake_fd;            // shutdown signalfd; -1 to stop on MSG_SHUTDOWN only
+};
+
+// Control messages a controller reacts to, for its reaction latency report
+enum ControlMessageKind {
+    CONTROL_EMERGENCY_EASTBOUND,
+    CONTROL_EMERGENCY_WESTBOUND,
+    CONTROL_EMERGENCY_CLEAR,
+    CONTROL_TRANSIT_PRIORITY,
+    CONTROL_PLAN_DECISION,
+    CONTROL_SHUTDOWN,
+    NUM_CONTROL_KINDS
+};
+const string CONTROL_KIND_NAMES[] = {"emergency eastbound", "emergency westbound", "emergency clear", "transit priority",
+                                     "plan decision", "shutdown"};
+
+const long long EMERGENCY_HOLD_NS = 100000000LL;    // each emergency message holds the current step this long
+
+inline int controlKind(uint8_t type) {
+    if (type == MSG_EMERGENCY_EASTBOUND) return CONTROL_EMERGENCY_EASTBOUND;
+    if (type == MSG_EMERGENCY_WESTBOUND) return CONTROL_EMERGENCY_WESTBOUND;
+    if (type == MSG_EMERGENCY_CLEAR) return CONTROL_EMERGENCY_CLEAR;
+    if (type == MSG_TRANSIT_PRIORITY) return CONTROL_TRANSIT_PRIORITY;
+    if (type == MSG_PLAN_DECISION) return CONTROL_PLAN_DECISION;
+    return CONTROL_SHUTDOWN;
+}
+
+// Transit signal priority: a bus asks its controller to hold its green until
+// it arrives (extension) or to end the conflicting green early. Either moves
+// the running plan off schedule; the next green of another phase pays the
+// difference back, so the cycle and any green-wave offset recover within one
+// cycle. Cross traffic carries the cost of an extension, the bus's own phase
+// gets back what an early green took.
+const int TSP_MAX_ADJUST_US = 1500000;      // furthest one grant moves the end of a green
+const int TSP_MIN_CUT_GREEN_US = 1000000;   // shortest a green is cut to, by an early green or a payback
+const int TSP_ARRIVAL_MARGIN_US = 200000;   // green kept after the bus's expected arrival
+const int TSP_GRANTS_PER_CYCLE = 1;
+
+enum TransitOutcome {
+    TSP_EXTENDED,
+    TSP_EARLY_GREEN,
+    TSP_NO_ACTION,
+    TSP_DENIED_LIMIT,
+    TSP_DENIED_BOUNDS,
+    NUM_TSP_OUTCOMES
+};
+const string TSP_OUTCOME_NAMES[] = {"green extended", "early green", "no change needed", "denied (cycle limit)",
+                                    "denied (green bounds)"};
+
+struct TransitPriorityState {
+    long long displaced_ns;     // plan running late (+) or early (-) by grants not yet paid back
+    int grants_this_cycle;
+    long outcomes[NUM_TSP_OUTCOMES];
+    long long extended_ns;
+    long long cut_ns;
+};
+
+inline void resetTransitPriority(TransitPriorityState& tsp) {
+    tsp.displaced_ns = 0;
+    tsp.grants_this_cycle = 0;
+    for (int o = 0; o < NUM_TSP_OUTCOMES; o++) tsp.outcomes[o] = 0;
+    tsp.extended_ns = 0;
+    tsp.cut_ns = 0;
+}
+
+// Decides one request against the step in force and returns that step's new
+// end. Extension needs the bus's phase green now and must cover the arrival
+// within max green; early green needs the bus's phase to be next.
+inline long long grantTransitPriority(const CompiledSignalPlan& plan, size_t step, long long step_start_ns,
+                                      long long step_end_ns, long long now_ns, int approach, long long arrive_ns,
+                                      TransitPriorityState& tsp) {
+    const SignalStep& s = plan.steps[step];
+    const SignalPhase& phase = plan.phases[s.phase];
+    const SignalPhase& next = plan.phases[(s.phase + 1) % plan.phases.size()];
+    uint8_t bus = 1 << approach;
+    long long end_ns = step_end_ns;
+    int outcome;
+
+    if (s.green_movements & bus) {
+        long long wanted = arrive_ns + TSP_ARRIVAL_MARGIN_US * 1000LL;
+        if (wanted <= step_end_ns) outcome = TSP_NO_ACTION;
+        else if (tsp.grants_this_cycle >= TSP_GRANTS_PER_CYCLE) outcome = TSP_DENIED_LIMIT;
+        else if (wanted - step_end_ns > TSP_MAX_ADJUST_US * 1000LL
+                 || wanted - step_start_ns > phase.max_green_us * 1000LL) outcome = TSP_DENIED_BOUNDS;
+        else {
+            outcome = TSP_EXTENDED;
+            end_ns = wanted;
+        }
+    } else if (s.green_movements != 0 && (next.movements & bus)) {
+        // The conflicting green ends early enough for the bus's green to start on arrival
+        long long wanted = arrive_ns - (long long)(phase.yellow_us + phase.all_red_us) * 1000;
+        long long earliest = max(max(step_start_ns + TSP_MIN_CUT_GREEN_US * 1000LL, now_ns),
+                                 step_end_ns - TSP_MAX_ADJUST_US * 1000LL);
+        if (wanted >= step_end_ns) outcome = TSP_NO_ACTION;
+        else if (tsp.grants_this_cycle >= TSP_GRANTS_PER_CYCLE) outcome = TSP_DENIED_LIMIT;
+        else if (earliest >= step_end_ns) outcome = TSP_DENIED_BOUNDS;
+        else {
+            outcome = TSP_EARLY_GREEN;
+            end_ns = max(wanted, earliest);
+        }
+    } else {
+        outcome = TSP_NO_ACTION;    // clearance running, the bus's green is coming anyway
+    }
+
+    tsp.outcomes[outcome]++;
+    if (end_ns != step_end_ns) {
+        tsp.grants_this_cycle++;
+        tsp.displaced_ns += end_ns - step_end_ns;
+        if (end_ns > step_end_ns) tsp.extended_ns += end_ns - step_end_ns;
+        else tsp.cut_ns += step_end_ns - end_ns;
+    }
+    return end_ns;
+}
+
+// Called as a step starts; a green step pays back displacement within its
+// min/max green and returns its adjusted end
+inline long long repayTransitPriority(const CompiledSignalPlan& plan, size_t step, long long step_start_ns,
+                                      long long step_end_ns, TransitPriorityState& tsp) {
+    const SignalStep& s = plan.steps[step];
+    if (tsp.displaced_ns == 0 || s.green_movements == 0) return step_end_ns;
+
+    long long green_ns = step_end_ns - step_start_ns;
+    long long change;
+    if (tsp.displaced_ns > 0) change = -min(tsp.displaced_ns, green_ns - TSP_MIN_CUT_GREEN_US * 1000LL);
+    else change = min(-tsp.displaced_ns, plan.phases[s.phase].max_green_us * 1000LL - green_ns);
+    if ((tsp.displaced_ns > 0) != (change < 0)) return step_end_ns;    // no room in this green
+
+    tsp.displaced_ns += change;
+    return step_end_ns + change;
+}
+
+// Printed by each controller process that received a request
+inline void printTransitPriorityReport(const string& id, const TransitPriorityState& tsp) {
+    long requests = 0;
+    for (int o = 0; o < NUM_TSP_OUTCOMES; o++) requests += tsp.outcomes[o];
+    if (requests == 0) return;
+
+    string line = "Controller " + id + " transit priority: " + to_string(requests) + " requests";
+    for (int o = 0; o < NUM_TSP_OUTCOMES; o++) {
+        if (tsp.outcomes[o] > 0) line += ", " + TSP_OUTCOME_NAMES[o] + " " + to_string(tsp.outcomes[o]);
+    }
+    cout << (line + "\n");
+    cout << ("  Greens extended by " + to_string(tsp.extended_ns / 1000000) + " ms, cut by "
+             + to_string(tsp.cut_ns / 1000000) + " ms in total\n");
+}
+
+// Predictive control (--predictive): a decision made as a green starts
+// either moves that green's end or skips the phase after it. Unlike a
+// transit priority grant it is not paid back; the plan simply runs on from
+// the new end.
+enum LookaheadPlan {
+    LOOKAHEAD_KEEP,
+    LOOKAHEAD_EXTEND,
+    LOOKAHEAD_SWITCH_NOW,
+    LOOKAHEAD_SKIP_NEXT,
+    NUM_LOOKAHEAD_PLANS
+};
+const string LOOKAHEAD_PLAN_NAMES[] = {"keep plan", "extend green", "switch now", "skip next phase"};
+
+struct PlanDecisionStats {
+    long applied[NUM_LOOKAHEAD_PLANS];
+    long stale;             // arrived after its green ended, or during an emergency hold
+};
+
+// The end of a green step under each plan; extend runs to max green, switch
+// now ends it as soon as the shortest allowed green has run
+inline long long lookaheadGreenEnd(const CompiledSignalPlan& plan, size_t step, long long start_ns, long long now_ns,
+                                   int choice) {
+    const SignalStep& s = plan.steps[step];
+    if (choice == LOOKAHEAD_EXTEND) return start_ns + plan.phases[s.phase].max_green_us * 1000LL;
+    if (choice == LOOKAHEAD_SWITCH_NOW) return max(start_ns + TSP_MIN_CUT_GREEN_US * 1000LL, now_ns);
+    return start_ns + s.duration_us * 1000LL;
+}
+
+// The phase a skip decision leaves out, or -1 if the plan has no other phase
+inline int lookaheadSkippedPhase(const CompiledSignalPlan& plan, size_t step) {
+    if (plan.phases.size() < 2) return -1;
+    return (plan.steps[step].phase + 1) % (int)plan.phases.size();
+}
+
+// The step after `step`, passing over every step of skip_phase (if >= 0)
+inline size_t nextSignalStep(const CompiledSignalPlan& plan, size_t step, int skip_phase) {
+    size_t next = (step + 1 == plan.steps.size()) ? 0 : step + 1;
+    while (skip_phase >= 0 && plan.steps[next].phase == skip_phase) next = (next + 1 == plan.steps.size()) ? 0 : next + 1;
+    return next;
+}
+
+inline void printPlanDecisionReport(const string& id, const PlanDecisionStats& d) {
+    long total = d.stale;
+    for (int p = 0; p < NUM_LOOKAHEAD_PLANS; p++) total += d.applied[p];
+    if (total == 0) return;
+    string line = "Controller " + id + " plan decisions:";
+    for (int p = 0; p < NUM_LOOKAHEAD_PLANS; p++) line += " " + LOOKAHEAD_PLAN_NAMES[p] + " " + to_string(d.applied[p]) + ",";
+    cout << (line + " stale " + to_string(d.stale) + "\n");
+}
+
+inline void armDeadline(int timer_fd, long long deadline_ns) {
+    struct itimerspec spec = {{0, 0}, {(time_t)(deadline_ns / 1000000000LL), (long)(deadline_ns % 1000000000LL)}};
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) spec.it_value.tv_nsec = 1;
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+inline void watchReadable(int epoll_fd, int fd) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// One event loop per controller process: publish the step, then block in
+// epoll on the phase timerfd, the peer pipe and the shutdown signalfd
+// together, so a message is handled the moment it arrives, mid-phase.
+// Transitions are scheduled from reference_ns (CLOCK_MONOTONIC, shared by
+// every controller process): each step's deadline is the previous deadline
+// plus its duration, never "now plus duration", so cycle N starts at
+// reference + N * cycle however late any single wake-up was. The state is
+// published as soon as the deadline passes and logged afterwards, so
+// logging never delays a transition. An emergency message holds the
+// current step until EMERGENCY_HOLD_NS after it arrived; a transit priority
+// request may move the end of the current green (grantTransitPriority).
+inline void runSignalController(const CompiledSignalPlan& plan, const SignalControllerIO& io, long long reference_ns,
+                                LatencyHistogram reaction[NUM_CONTROL_KINDS], TransitPriorityState& tsp,
+                                PeerReaderStats& peer, PlanDecisionStats& decisions) {
+    const string& id = INTERSECTION_IDS[plan.intersection];
+    long long now = monotonicNowNs();
+    long long pos = cyclePosition(plan, (now - reference_ns) / 1000);
+    size_t step = stepAt(plan, pos);
+    long long next_ns = now + (plan.steps[step].start_us + plan.steps[step].duration_us - pos) * 1000;
+    long long step_start_ns = next_ns - (long long)plan.steps[step].duration_us * 1000;
+    long long due_ns = 0;
+    long long hold_until_ns = 0;
+    int skip_phase = -1;
+    int cycle = 0;
+    PeerReader reader;
+    initPeerReader(reader);
+    PeerFrame frames[PEER_BATCH_FRAMES];
+
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (timer_fd < 0 || epoll_fd < 0) {
+        LOG_WARN("[CONTROLLER] ", id, " cannot create its event loop: ", strerror(errno));
+        if (timer_fd >= 0) close(timer_fd);
+        return;
+    }
+    watchReadable(epoll_fd, timer_fd);
+    if (io.wake_fd >= 0) watchReadable(epoll_fd, io.wake_fd);
+    if (io.peer_read_fd >= 0) watchReadable(epoll_fd, io.peer_read_fd);
+
+    bool running = true;
+    while (running) {
+        const SignalStep& s = plan.steps[step];
+        LightStateMessage state = {(uint8_t)plan.intersection, s.lights, (uint16_t)step, monotonicNowNs(), due_ns};
+        if (!publishLightState(io.publish, state)) break;
+
+        if (step == 0) cycle++;
+        if (step == 0) LOG_INFO("[LIGHT] ", id, ": ", s.label, " (cycle ", cycle, ")");
+        else LOG_INFO("[LIGHT] ", id, ": ", s.label);
+
+        armDeadline(timer_fd, next_ns);
+        bool step_over = false;
+        while (running && !step_over) {
+            struct epoll_event events[3];
+            int ready = epoll_wait(epoll_fd, events, 3, -1);
+            for (int e = 0; e < ready; e++) {
+                int fd = events[e].data.fd;
+                if (fd == io.wake_fd && fd >= 0) {
+                    int signum;
+                    long long sent_ns;
+                    if (readShutdownSignal(io.wake_fd, signum, sent_ns) && sent_ns != 0) {
+                        recordLatency(reaction[CONTROL_SHUTDOWN], monotonicNowNs() - sent_ns);
+                    }
+                    running = false;
+                } else if (fd == io.peer_read_fd) {
+                    int count;
+                    while ((count = readPeerFrames(reader, io.peer_read_fd, frames, PEER_BATCH_FRAMES)) > 0) {
+                        long long received_ns = monotonicNowNs();
+                        for (int k = 0; k < count; k++) {
+                            const PeerFrameHeader& h = frames[k].header;
+                            const PeerPayload& p = frames[k].payload;
+                            recordLatency(reaction[controlKind(h.type)], received_ns - h.sent_ns);
+                            if (h.type == MSG_SHUTDOWN) {
+                                running = false;
+                            } else if (h.type == MSG_EMERGENCY_EASTBOUND || h.type == MSG_EMERGENCY_WESTBOUND) {
+                                hold_until_ns = received_ns + EMERGENCY_HOLD_NS;
+                                LOG_INFO("[PIPE] ", id, " received emergency message #", h.seq, " (vehicle ", p.vehicle_id,
+                                         ", due in ", (p.eta_ns - received_ns) / 1000000, " ms)");
+                            } else if (h.type == MSG_TRANSIT_PRIORITY && p.approach < NUM_SIDES) {
+                                long long end_ns = grantTransitPriority(plan, step, step_start_ns, next_ns, received_ns,
+                                                                        p.approach, p.eta_ns, tsp);
+                                if (end_ns == next_ns) continue;
+                                LOG_INFO("[TSP] ", id, ": bus ", p.vehicle_id, " on ", SPAWN_SIDES[p.approach], ", ",
+                                         plan.steps[step].label, (end_ns > next_ns) ? " extended by " : " cut by ",
+                                         llabs(end_ns - next_ns) / 1000000, " ms");
+                                next_ns = end_ns;
+                                armDeadline(timer_fd, max(hold_until_ns, next_ns));
+                            } else if (h.type == MSG_PLAN_DECISION && p.direction < NUM_LOOKAHEAD_PLANS) {
+                                if (p.step != step || plan.steps[step].green_movements == 0 || hold_until_ns > received_ns) {
+                                    decisions.stale++;
+                                    continue;
+                                }
+                                decisions.applied[p.direction]++;
+                                if (p.direction == LOOKAHEAD_KEEP) continue;
+                                if (p.direction == LOOKAHEAD_SKIP_NEXT) {
+                                    skip_phase = lookaheadSkippedPhase(plan, step);
+                                    if (skip_phase >= 0) LOG_INFO("[PREDICT] ", id, ": skipping ", plan.phases[skip_phase].name);
+                                    continue;
+                                }
+                                long long end_ns = lookaheadGreenEnd(plan, step, step_start_ns, received_ns, p.direction);
+                                LOG_INFO("[PREDICT] ", id, ": ", plan.steps[step].label, " ", LOOKAHEAD_PLAN_NAMES[p.direction],
+                                         ", ends in ", (end_ns - received_ns) / 1000000, " ms");
+                                next_ns = end_ns;
+                                armDeadline(timer_fd, max(hold_until_ns, next_ns));
+                            }
+                        }
+                    }
+                } else if (fd == timer_fd) {
+                    uint64_t expirations;
+                    if (read(timer_fd, &expirations, sizeof(expirations)) != (ssize_t)sizeof(expirations)) continue;
+                    long long end_ns = (hold_until_ns > next_ns) ? hold_until_ns : next_ns;
+                    if (monotonicNowNs() >= end_ns) step_over = true;
+                    else armDeadline(timer_fd, end_ns);
+                }
+            }
+        }
+        if (!running) break;
+
+        // A step an emergency hold pushed past its deadline was late on purpose
+        size_t previous = step;
+        step = nextSignalStep(plan, previous, -1);
+        if (skip_phase >= 0 && plan.steps[step].phase == skip_phase) {
+            step = nextSignalStep(plan, previous, skip_phase);
+            skip_phase = -1;
+        }
+        due_ns = (hold_until_ns > next_ns) ? 0 : next_ns;
+        step_start_ns = next_ns;
+        next_ns += (long long)plan.steps[step].duration_us * 1000;
+        if (step <= previous) tsp.grants_this_cycle = 0;
+        next_ns = repayTransitPriority(plan, step, step_start_ns, next_ns, tsp);
+    }
+    peer = reader.stats;
+    close(epoll_fd);
+    close(timer_fd);
+}
+
+// Printed by each controller process as it exits
+inline void printControllerReactionReport(const string& id, const LatencyHistogram reaction[NUM_CONTROL_KINDS]) {
+    cout << ("Controller " + id + " reaction latency (sent to handled in its event loop):\n");
+    for (int k = 0; k < NUM_CONTROL_KINDS; k++) {
+        if (reaction[k].count > 0) printLatencySummary(CONTROL_KIND_NAMES[k], reaction[k]);
+    }
+}
+
+#endif // SIGNALPLAN_H
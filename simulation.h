@@ -10,20 +10,29 @@
 #include <signal.h>
 #include <cstdlib>
 #include <ctime>
+#include <cstdint>
+#include "context.h"
 
 using namespace std;
 
 // Configuration
 const int DEFAULT_VEHICLE_COUNT = 15;
+const int DEFAULT_MAX_IN_FLIGHT = 1000;
+const int DEFAULT_VEHICLE_STACK_KB = 64;
+const int DEFAULT_SCHEDULER_THREADS = 2;
+const int DEFAULT_LINK_CAPACITY = 8;
+const int DEFAULT_DASHBOARD_HZ = 10;
 
 // Time delays (microseconds)
 const int SPAWN_MIN_DELAY = 500000;
 const int SPAWN_MAX_DELAY = 2000000;
 const int CROSSING_TIME = 1000000;
 const int GREEN_DURATION = 3000000;
+const int MAX_GREEN_DURATION = 4500000;     // longest a green may be extended to (transit priority)
 const int YELLOW_DURATION = 1000000;
 const int PARKING_MIN_TIME = 2000000;
 const int PARKING_MAX_TIME = 5000000;
+const int LINK_TRAVEL_TIME = 2000000;      // F10 <-> F11 at free-flow speed
 
 // Vehicle type distribution (out of 100)
 const int PROB_CAR = 40;
@@ -42,7 +51,6 @@ const int PROB_RIGHT = 25;
 
 // Synchronization primitives
 extern pthread_mutex_t console_mutex;
-extern pthread_mutex_t vehicle_mutex;
 extern pthread_mutex_t f10_mutex;
 extern pthread_mutex_t f11_mutex;
 extern pthread_mutex_t stats_mutex;
@@ -52,13 +60,7 @@ extern pthread_cond_t f10_east_west_cond;
 extern pthread_cond_t f11_north_south_cond;
 extern pthread_cond_t f11_east_west_cond;
 
-extern bool shutdown_flag;
-extern bool emergency_active;
-extern string emergency_direction;
-
-extern int next_vehicle_id;
-extern int vehicles_completed;
-extern int total_vehicles_to_spawn;
+extern SimulationContext sim_context;
 
 // Pipes for IPC
 extern int pipe_f10_to_f11[2];
@@ -68,6 +70,8 @@ const char MSG_EMERGENCY_EASTBOUND = 'E';
 const char MSG_EMERGENCY_WESTBOUND = 'W';
 const char MSG_EMERGENCY_CLEAR = 'C';
 const char MSG_SHUTDOWN = 'S';
+const char MSG_TRANSIT_PRIORITY = 'T';
+const char MSG_PLAN_DECISION = 'P';
 
 struct VehicleThreadData {
     int vehicle_id;
@@ -87,6 +91,9 @@ struct ControllerData {
 const string VEHICLE_TYPES[] = {"Car", "Bike", "Bus", "Tractor", "Ambulance", "Firetruck"};
 const int NUM_VEHICLE_TYPES = 6;
 
+const string INTERSECTION_IDS[] = {"F10", "F11"};
+const int NUM_INTERSECTIONS = 2;
+
 const string SPAWN_SIDES[] = {"NORTH", "SOUTH", "EAST", "WEST"};
 const int NUM_SIDES = 4;
 
@@ -143,24 +150,29 @@ inline int getRandomDelay(int min_delay, int max_delay) {
     return min_delay + (rand() % (max_delay - min_delay + 1));
 }
 
-inline void safePrint(const string& message) {
-    pthread_mutex_lock(&console_mutex);
-    cout << message << endl;
-    pthread_mutex_unlock(&console_mutex);
+inline long long monotonicNowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
 }
 
-inline string getTimestamp() {
-    time_t now = time(NULL);
-    struct tm* timeinfo = localtime(&now);
-    char buffer[9];
-    strftime(buffer, sizeof(buffer), "%H:%M:%S", timeinfo);
-    return string(buffer);
+inline bool semTimedWaitMs(sem_t* sem, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long)timeout_ms * 1000000;
+    while (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return sem_timedwait(sem, &deadline) == 0;
 }
 
-inline void safePrintWithTime(const string& message) {
-    pthread_mutex_lock(&console_mutex);
-    cout << "[" << getTimestamp() << "] " << message << endl;
-    pthread_mutex_unlock(&console_mutex);
+// Waits on a semaphore but gives up once shutdown is raised
+inline bool semWaitUnlessShutdown(sem_t* sem) {
+    while (!shuttingDown(sim_context)) {
+        if (semTimedWaitMs(sem, 100)) return true;
+    }
+    return false;
 }
 
 #endif // SIMULATION_H
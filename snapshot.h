@@ -0,0 +1,76 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+// Fixed-size copy of the state an observer cares about. Each part is taken
+// under its own lock for O(1) work (sizes and flags only, never a walk over
+// vehicles), so a snapshot costs the same at 10 vehicles or 100k and nothing
+// downstream of it ever touches a simulation lock. The dashboard fills the
+// intersection parts from the published views in epochviews.h instead.
+
+#include <string>
+#include <cstdint>
+#include <pthread.h>
+#include <semaphore.h>
+#include "simulation.h"
+#include "intersection.h"
+#include "parkinglot.h"
+#include "lifecycle.h"
+#include "links.h"
+#include "signalplan.h"
+
+using namespace std;
+
+struct IntersectionSnapshot {
+    uint8_t lights[NUM_SIDES];      // LIGHT_RED, LIGHT_GREEN or LIGHT_YELLOW
+    uint32_t queued[NUM_SIDES];
+    uint8_t emergency_mode;
+};
+
+struct ParkingSnapshot {
+    uint32_t parked;
+    uint32_t waiting;
+};
+
+struct StateSnapshot {
+    long long taken_ns;             // CLOCK_MONOTONIC
+    IntersectionSnapshot intersections[NUM_INTERSECTIONS];
+    ParkingSnapshot parking[NUM_INTERSECTIONS];
+    uint32_t link_occupancy[NUM_INTERSECTIONS];     // indexed by upstream intersection
+    uint32_t link_capacity[NUM_INTERSECTIONS];
+    uint8_t emergency;              // EMERGENCY_NONE, _EASTBOUND or _WESTBOUND
+    uint32_t spawned;
+    uint32_t in_flight;
+    uint32_t completed;
+    uint32_t aborted;
+};
+
+// Caller holds the intersection's mutex
+inline void snapshotIntersectionLocked(Intersection& intersection, IntersectionSnapshot& out) {
+    for (int side = 0; side < NUM_SIDES; side++) {
+        out.lights[side] = approachLight(intersection, side);
+        out.queued[side] = (uint32_t)getController(intersection, side).queue.size();
+    }
+    out.emergency_mode = intersection.emergency_mode;
+}
+
+// The semaphores already count both, so no lock is needed
+inline void snapshotParkingLot(ParkingLot& lot, ParkingSnapshot& out) {
+    out.parked = (uint32_t)(MAX_PARKING_SPOTS - getAvailableSpots(lot));
+    out.waiting = (uint32_t)(MAX_WAITING_QUEUE - getAvailableWaitSlots(lot));
+}
+
+inline void snapshotLatch(CompletionLatch& latch, StateSnapshot& out) {
+    pthread_mutex_lock(&latch.lock);
+    out.in_flight = (uint32_t)latch.outstanding;
+    out.completed = (uint32_t)latch.completed;
+    out.aborted = (uint32_t)latch.aborted;
+    pthread_mutex_unlock(&latch.lock);
+    out.spawned = out.in_flight + out.completed + out.aborted;
+}
+
+inline void snapshotLink(const InterLink& link, StateSnapshot& out) {
+    out.link_occupancy[link.from] = linkOccupancy(link);
+    out.link_capacity[link.from] = link.capacity;
+}
+
+#endif // SNAPSHOT_H
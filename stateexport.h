@@ -0,0 +1,125 @@
+#ifndef STATEEXPORT_H
+#define STATEEXPORT_H
+
+// Read-only state export for out-of-process monitors. The simulator maps a
+// file (normally under /dev/shm) holding a header and one StateSnapshot, and
+// rewrites only the section that changed whenever state changes. Writers are
+// serialized by a process-local lock and bracket every update with a
+// sequence counter (odd while writing); readers copy the snapshot and retry
+// if the counter moved, so they never block the simulator.
+
+#include <string>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "simulation.h"
+#include "snapshot.h"
+
+using namespace std;
+
+const uint32_t STATE_EXPORT_MAGIC = 0x4d495354;     // "TSIM"
+const uint32_t STATE_EXPORT_LAYOUT = 1;
+const int STATE_READ_RETRIES = 1000;
+
+struct SharedStateRegion {
+    uint32_t magic;
+    uint32_t layout;
+    uint32_t snapshot_bytes;
+    int32_t writer_pid;
+    long long start_ns;             // CLOCK_MONOTONIC when the run started
+    atomic<uint32_t> finished;
+    atomic<uint32_t> seq;           // odd while an update is in progress
+    StateSnapshot snapshot;
+};
+
+struct StateExport {
+    SharedStateRegion* region;      // NULL when exporting is off
+    pthread_mutex_t writer_lock;
+};
+
+inline bool stateExportEnabled(const StateExport& exp) {
+    return exp.region != NULL;
+}
+
+inline bool openStateExport(StateExport& exp, const string& path, long long start_ns) {
+    exp.region = NULL;
+    pthread_mutex_init(&exp.writer_lock, NULL);
+
+    // A fresh file, so a monitor still attached to the previous run keeps a
+    // valid mapping (marked finished) instead of seeing it truncated
+    unlink(path.c_str());
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, sizeof(SharedStateRegion)) != 0) {
+        close(fd);
+        return false;
+    }
+    void* base = mmap(NULL, sizeof(SharedStateRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return false;
+
+    SharedStateRegion* region = (SharedStateRegion*)base;
+    memset(&region->snapshot, 0, sizeof(region->snapshot));
+    region->magic = STATE_EXPORT_MAGIC;
+    region->layout = STATE_EXPORT_LAYOUT;
+    region->snapshot_bytes = sizeof(StateSnapshot);
+    region->writer_pid = (int32_t)getpid();
+    region->start_ns = start_ns;
+    region->finished.store(0);
+    region->seq.store(0, memory_order_release);
+    exp.region = region;
+    return true;
+}
+
+// Tells monitors the run is over; the file stays behind for post-mortem reads
+inline void markStateExportFinished(StateExport& exp) {
+    if (exp.region != NULL) exp.region->finished.store(1, memory_order_release);
+}
+
+inline void closeStateExport(StateExport& exp) {
+    markStateExportFinished(exp);
+    if (exp.region != NULL) {
+        munmap(exp.region, sizeof(SharedStateRegion));
+        exp.region = NULL;
+    }
+    pthread_mutex_destroy(&exp.writer_lock);
+}
+
+// Returns the live snapshot to update in place; pair with endStateUpdate
+inline StateSnapshot& beginStateUpdate(StateExport& exp) {
+    pthread_mutex_lock(&exp.writer_lock);
+    uint32_t seq = exp.region->seq.load(memory_order_relaxed);
+    exp.region->seq.store(seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return exp.region->snapshot;
+}
+
+inline void endStateUpdate(StateExport& exp) {
+    exp.region->snapshot.taken_ns = monotonicNowNs();
+    uint32_t seq = exp.region->seq.load(memory_order_relaxed);
+    exp.region->seq.store(seq + 1, memory_order_release);
+    pthread_mutex_unlock(&exp.writer_lock);
+}
+
+// Reader side; false if no consistent copy could be taken. version is the
+// number of completed updates.
+inline bool readStateSnapshot(const SharedStateRegion* region, StateSnapshot& out, uint32_t& version) {
+    for (int attempt = 0; attempt < STATE_READ_RETRIES; attempt++) {
+        uint32_t before = region->seq.load(memory_order_acquire);
+        if (before & 1) continue;
+        memcpy(&out, (const void*)&region->snapshot, sizeof(out));
+        atomic_thread_fence(memory_order_acquire);
+        if (region->seq.load(memory_order_relaxed) == before) {
+            version = before / 2;
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // STATEEXPORT_H
@@ -0,0 +1,164 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+// Hierarchical timing wheel: TIMER_WHEEL_LEVELS rings of TIMER_WHEEL_SLOTS
+// slots, level L slot covering SLOTS^L ticks. An entry sits at the lowest
+// level whose current rotation contains its due tick; every time a level's
+// ring wraps, the next level's current slot cascades down one level. Adding
+// is O(1), each tick touches one level-0 slot, and entries live in one pooled
+// vector linked by index, so a pending timer costs one small struct.
+// Not thread-safe: the owner locks around every call.
+
+#include <vector>
+#include <climits>
+#include "simulation.h"
+
+using namespace std;
+
+const int TIMER_WHEEL_LEVELS = 4;
+const int TIMER_WHEEL_SLOT_BITS = 6;
+const int TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_SLOT_BITS;
+const long long TIMER_WHEEL_TICK_NS = 10000000LL;     // 10 ms; four levels span about 46 hours
+
+typedef void (*TimerFireFn)(void* ctx);
+
+struct TimerWheelEntry {
+    long long due_ns;
+    TimerFireFn fire;
+    void* ctx;
+    int next;               // next entry in the slot (or free list), -1 at the end
+};
+
+struct TimerWheel {
+    long long start_ns;     // tick 0
+    long long tick;         // last tick processed
+    int slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    vector<TimerWheelEntry> entries;
+    int free_head;
+    long pending;
+    long peak_pending;
+};
+
+inline void initTimerWheel(TimerWheel& w, long long start_ns) {
+    w.start_ns = start_ns;
+    w.tick = 0;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int s = 0; s < TIMER_WHEEL_SLOTS; s++) w.slots[level][s] = -1;
+    }
+    w.entries.clear();
+    w.free_head = -1;
+    w.pending = 0;
+    w.peak_pending = 0;
+}
+
+inline long long timerTickNs(const TimerWheel& w, long long tick) {
+    return w.start_ns + tick * TIMER_WHEEL_TICK_NS;
+}
+
+// Links an entry into its slot; it fires no earlier than earliest_tick
+inline void placeTimerEntry(TimerWheel& w, int index, long long earliest_tick) {
+    long long due = (w.entries[index].due_ns - w.start_ns + TIMER_WHEEL_TICK_NS - 1) / TIMER_WHEEL_TICK_NS;
+    if (due < earliest_tick) due = earliest_tick;
+
+    // Beyond the top level's current rotation: park at its last tick, re-placed from there
+    int top_bits = TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS;
+    if ((due >> top_bits) != (w.tick >> top_bits)) due = (((w.tick >> top_bits) + 1) << top_bits) - 1;
+
+    int level = 0;
+    while ((due >> (TIMER_WHEEL_SLOT_BITS * (level + 1))) != (w.tick >> (TIMER_WHEEL_SLOT_BITS * (level + 1)))) level++;
+    int slot = (int)((due >> (TIMER_WHEEL_SLOT_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+    w.entries[index].next = w.slots[level][slot];
+    w.slots[level][slot] = index;
+}
+
+inline void addTimer(TimerWheel& w, long long due_ns, TimerFireFn fire, void* ctx) {
+    int index;
+    if (w.free_head >= 0) {
+        index = w.free_head;
+        w.free_head = w.entries[index].next;
+    } else {
+        index = (int)w.entries.size();
+        w.entries.push_back(TimerWheelEntry());
+    }
+    TimerWheelEntry& e = w.entries[index];
+    e.due_ns = due_ns;
+    e.fire = fire;
+    e.ctx = ctx;
+    placeTimerEntry(w, index, w.tick + 1);
+    w.pending++;
+    if (w.pending > w.peak_pending) w.peak_pending = w.pending;
+}
+
+inline void takeTimerEntry(TimerWheel& w, int index, vector<TimerWheelEntry>& expired) {
+    expired.push_back(w.entries[index]);
+    w.entries[index].next = w.free_head;
+    w.free_head = index;
+    w.pending--;
+}
+
+inline void cascadeTimerSlot(TimerWheel& w, int level, int slot) {
+    int index = w.slots[level][slot];
+    w.slots[level][slot] = -1;
+    while (index >= 0) {
+        int next = w.entries[index].next;
+        placeTimerEntry(w, index, w.tick);
+        index = next;
+    }
+}
+
+// Processes every tick up to now_ns, appending the entries that fell due
+inline void advanceTimerWheel(TimerWheel& w, long long now_ns, vector<TimerWheelEntry>& expired) {
+    long long target = (now_ns - w.start_ns) / TIMER_WHEEL_TICK_NS;
+    while (w.tick < target) {
+        if (w.pending == 0) {
+            w.tick = target;    // nothing to cascade; skip the idle stretch
+            break;
+        }
+        w.tick++;
+        for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((w.tick & ((1LL << (TIMER_WHEEL_SLOT_BITS * level)) - 1)) == 0) {
+                cascadeTimerSlot(w, level, (int)((w.tick >> (TIMER_WHEEL_SLOT_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)));
+            }
+        }
+
+        int slot = (int)(w.tick & (TIMER_WHEEL_SLOTS - 1));
+        int index = w.slots[0][slot];
+        w.slots[0][slot] = -1;
+        while (index >= 0) {
+            int next = w.entries[index].next;
+            if (w.entries[index].due_ns > timerTickNs(w, w.tick)) placeTimerEntry(w, index, w.tick + 1);
+            else takeTimerEntry(w, index, expired);
+            index = next;
+        }
+    }
+}
+
+// Everything still pending, due or not (shutdown)
+inline void drainTimerWheel(TimerWheel& w, vector<TimerWheelEntry>& expired) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int s = 0; s < TIMER_WHEEL_SLOTS; s++) {
+            int index = w.slots[level][s];
+            w.slots[level][s] = -1;
+            while (index >= 0) {
+                int next = w.entries[index].next;
+                takeTimerEntry(w, index, expired);
+                index = next;
+            }
+        }
+    }
+}
+
+// When advanceTimerWheel next has work: the next occupied level-0 slot, or
+// the next wrap if an upper level may cascade something down
+inline long long nextTimerWheelWakeNs(const TimerWheel& w) {
+    if (w.pending == 0) return LLONG_MAX;
+    for (long long t = w.tick + 1;; t++) {
+        if ((t & (TIMER_WHEEL_SLOTS - 1)) == 0 || w.slots[0][t & (TIMER_WHEEL_SLOTS - 1)] >= 0) return timerTickNs(w, t);
+    }
+}
+
+inline size_t timerWheelBytes(const TimerWheel& w) {
+    return sizeof(w.slots) + w.entries.capacity() * sizeof(TimerWheelEntry);
+}
+
+#endif // TIMERWHEEL_H
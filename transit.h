@@ -0,0 +1,181 @@
+#ifndef TRANSIT_H
+#define TRANSIT_H
+
+// --bench transit: transit signal priority at one intersection in virtual
+// time. The same seeded arrivals run against the default plan twice, once
+// fixed-time and once with bus requests handled by the controller's own
+// grantTransitPriority/repayTransitPriority. A bus checks in one link travel
+// time before it reaches the stop line, as on the F10-F11 link, and asks
+// again if it arrives on red. Crossings are not capacity-limited, matching
+// the vehicle engines, so a vehicle's delay is its wait for green.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "simulation.h"
+#include "signalplan.h"
+
+using namespace std;
+
+struct TransitArrival {
+    long long arrive_ns;
+    int approach;
+    bool bus;
+};
+
+struct TransitRequest {
+    long long at_ns;
+    long long arrive_ns;
+    int approach;
+    bool on_arrival;        // only sent if the approach is not green
+};
+
+struct LightSegment {
+    long long start_ns;
+    long long end_ns;
+    uint8_t lights;
+};
+
+struct TransitDelays {
+    double bus_mean_s;
+    double other_mean_s;
+    double bus_total_s;
+    double other_total_s;
+};
+
+inline bool requestBefore(const TransitRequest& a, const TransitRequest& b) {
+    return a.at_ns < b.at_ns;
+}
+
+// The controller's step sequence from time 0 to horizon_ns, handling each
+// request at the moment it falls due
+inline vector<LightSegment> runTransitTimeline(const CompiledSignalPlan& plan, const vector<TransitRequest>& requests,
+                                               long long horizon_ns, TransitPriorityState& tsp) {
+    vector<LightSegment> timeline;
+    size_t step = 0;
+    long long start_ns = 0;
+    long long end_ns = (long long)plan.steps[0].duration_us * 1000;
+    size_t next = 0;
+
+    while (start_ns < horizon_ns) {
+        while (next < requests.size() && requests[next].at_ns < end_ns) {
+            const TransitRequest& r = requests[next++];
+            if (r.on_arrival && lightOf(plan.steps[step].lights, r.approach) == LIGHT_GREEN) continue;
+            end_ns = grantTransitPriority(plan, step, start_ns, end_ns, r.at_ns, r.approach, r.arrive_ns, tsp);
+        }
+        LightSegment segment = {start_ns, end_ns, plan.steps[step].lights};
+        timeline.push_back(segment);
+
+        step = (step + 1 == plan.steps.size()) ? 0 : step + 1;
+        if (step == 0) tsp.grants_this_cycle = 0;
+        start_ns = end_ns;
+        end_ns = repayTransitPriority(plan, step, start_ns, start_ns + (long long)plan.steps[step].duration_us * 1000,
+                                      tsp);
+    }
+    return timeline;
+}
+
+// Arrivals are in time order, so one forward scan of the timeline serves all
+inline TransitDelays measureTransitDelays(const vector<TransitArrival>& arrivals, const vector<LightSegment>& timeline) {
+    TransitDelays d = {0.0, 0.0, 0.0, 0.0};
+    long buses = 0;
+    size_t first = 0;
+
+    for (size_t i = 0; i < arrivals.size(); i++) {
+        const TransitArrival& a = arrivals[i];
+        while (first < timeline.size() && timeline[first].end_ns <= a.arrive_ns) first++;
+
+        long long go_ns = a.arrive_ns;
+        for (size_t s = first; s < timeline.size(); s++) {
+            const LightSegment& seg = timeline[s];
+            if (seg.end_ns > seg.start_ns && lightOf(seg.lights, a.approach) == LIGHT_GREEN) {
+                go_ns = max(seg.start_ns, a.arrive_ns);
+                break;
+            }
+        }
+
+        double delay_s = (go_ns - a.arrive_ns) / 1e9;
+        if (a.bus) {
+            d.bus_total_s += delay_s;
+            buses++;
+        } else {
+            d.other_total_s += delay_s;
+        }
+    }
+    long others = (long)arrivals.size() - buses;
+    d.bus_mean_s = (buses > 0) ? d.bus_total_s / buses : 0.0;
+    d.other_mean_s = (others > 0) ? d.other_total_s / others : 0.0;
+    return d;
+}
+
+inline string formatPercentChange(double before, double after) {
+    if (before <= 0.0) return "n/a";
+    char text[32];
+    snprintf(text, sizeof(text), "%+.1f%%", (after - before) * 100.0 / before);
+    return text;
+}
+
+inline void printTransitDelays(const string& label, const TransitDelays& d) {
+    cout << ("[BENCH] " + label + ": bus mean delay " + to_string(d.bus_mean_s) + " s, other traffic mean delay "
+         + to_string(d.other_mean_s) + " s\n");
+}
+
+inline int runTransitBenchmark(int vehicles, unsigned int seed) {
+    srand(seed);
+    long long checkin_ns = LINK_TRAVEL_TIME * 1000LL;
+    vector<TransitArrival> arrivals;
+    long long t = checkin_ns;
+    int buses = 0;
+    for (int i = 0; i < vehicles; i++) {
+        t += (SPAWN_MIN_DELAY + rand() % (SPAWN_MAX_DELAY - SPAWN_MIN_DELAY)) * 1000LL;
+        TransitArrival a = {t, rand() % NUM_SIDES, rand() % 100 < PROB_BUS};
+        if (a.bus) buses++;
+        arrivals.push_back(a);
+    }
+
+    vector<TransitRequest> requests;
+    for (size_t i = 0; i < arrivals.size(); i++) {
+        if (!arrivals[i].bus) continue;
+        TransitRequest checkin = {arrivals[i].arrive_ns - checkin_ns, arrivals[i].arrive_ns, arrivals[i].approach, false};
+        TransitRequest on_arrival = {arrivals[i].arrive_ns, arrivals[i].arrive_ns, arrivals[i].approach, true};
+        requests.push_back(checkin);
+        requests.push_back(on_arrival);
+    }
+    stable_sort(requests.begin(), requests.end(), requestBefore);
+
+    CompiledSignalPlan plan;
+    if (!compileSignalPlan(defaultSignalPlan(0), plan)) return 1;
+    long long horizon_ns = t + 2LL * plan.cycle_us * 1000;
+
+    cout << ("[BENCH] Transit priority: " + to_string(vehicles) + " vehicles (" + to_string(buses) + " buses), seed "
+         + to_string(seed) + ", cycle " + to_string(plan.cycle_us / 1000) + " ms, max green "
+         + to_string(plan.phases[0].max_green_us / 1000) + " ms, check-in " + to_string(checkin_ns / 1000000)
+         + " ms ahead, " + to_string(TSP_GRANTS_PER_CYCLE) + " grant(s) per cycle\n");
+
+    TransitPriorityState fixed_tsp;
+    resetTransitPriority(fixed_tsp);
+    TransitDelays fixed = measureTransitDelays(arrivals, runTransitTimeline(plan, vector<TransitRequest>(), horizon_ns,
+                                                                            fixed_tsp));
+    printTransitDelays("fixed time", fixed);
+
+    TransitPriorityState tsp;
+    resetTransitPriority(tsp);
+    TransitDelays priority = measureTransitDelays(arrivals, runTransitTimeline(plan, requests, horizon_ns, tsp));
+    printTransitDelays("transit priority", priority);
+
+    cout << ("[BENCH] Bus delay " + formatPercentChange(fixed.bus_mean_s, priority.bus_mean_s) + " ("
+         + to_string(fixed.bus_total_s - priority.bus_total_s) + " bus-s saved), other traffic "
+         + formatPercentChange(fixed.other_mean_s, priority.other_mean_s) + " ("
+         + to_string(priority.other_total_s - fixed.other_total_s) + " vehicle-s added)\n");
+
+    string line = "[BENCH] Requests:";
+    for (int o = 0; o < NUM_TSP_OUTCOMES; o++) line += " " + TSP_OUTCOME_NAMES[o] + " " + to_string(tsp.outcomes[o]) + ",";
+    line.pop_back();
+    cout << (line + "; greens extended " + to_string(tsp.extended_ns / 1000000) + " ms, cut "
+         + to_string(tsp.cut_ns / 1000000) + " ms\n");
+    return 0;
+}
+
+#endif // TRANSIT_H
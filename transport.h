@@ -0,0 +1,403 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+// How signal controllers deliver light states (--controllers):
+//   thread  controllers are threads of the simulation process and apply each
+//           state to the intersection themselves, with no IPC at all
+//   pipe    forked controller processes write each state to a pipe that the
+//           parent's listener thread selects on
+//   shm     forked controller processes push states into per-controller rings
+//           in a shared anonymous mapping; the listener sleeps on a futex
+//           doorbell that a publisher only rings while the listener is asleep
+// Control messages (emergency, transit priority, shutdown) use the peer pipes
+// in every mode. --bench transport compares the three; syscalls are counted
+// where the transport makes them.
+
+#include <iostream>
+#include <string>
+#include <new>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include "simulation.h"
+#include "latency.h"
+
+using namespace std;
+
+enum ControllerTransport {
+    TRANSPORT_THREAD,
+    TRANSPORT_PIPE,
+    TRANSPORT_SHM,
+    NUM_TRANSPORTS
+};
+const string TRANSPORT_NAMES[] = {"thread", "pipe", "shm"};
+
+// What a controller publishes on every transition (fits in one pipe write)
+struct LightStateMessage {
+    uint8_t intersection;
+    uint8_t lights;
+    uint16_t step;
+    long long sent_ns;      // CLOCK_MONOTONIC at publish, for notification latency
+    long long due_ns;       // when the plan scheduled this step; 0 if joined mid-step or held
+};
+
+const int LIGHT_RING_SLOTS = 256;
+const int LIGHT_PUBLISH_RETRIES = 1000;    // yields while a ring is full before the state is dropped
+const int LIGHT_RECEIVE_BATCH = 16;
+
+struct TransportStats {
+    long messages;
+    long syscalls;
+    long dropped;
+};
+
+struct LightStateRing {
+    alignas(CACHE_LINE_BYTES) atomic<uint32_t> head;    // listener
+    alignas(CACHE_LINE_BYTES) atomic<uint32_t> tail;    // publisher
+    LightStateMessage slots[LIGHT_RING_SLOTS];
+};
+
+struct LightMailbox {
+    alignas(CACHE_LINE_BYTES) atomic<uint32_t> doorbell;    // futex word, bumped by every publish
+    alignas(CACHE_LINE_BYTES) atomic<uint32_t> listener_asleep;
+    LightStateRing rings[NUM_INTERSECTIONS];
+};
+
+// Shared with every process forked after it is created
+inline LightMailbox* createLightMailbox() {
+    void* p = mmap(NULL, sizeof(LightMailbox), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    LightMailbox* m = new (p) LightMailbox();
+    m->doorbell.store(0);
+    m->listener_asleep.store(0);
+    for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+        m->rings[i].head.store(0);
+        m->rings[i].tail.store(0);
+    }
+    return m;
+}
+
+inline void destroyLightMailbox(LightMailbox* m) {
+    if (m != NULL) munmap(m, sizeof(LightMailbox));
+}
+
+// Not FUTEX_PRIVATE: the word lives in a mapping shared across processes
+inline void futexWait(atomic<uint32_t>* word, uint32_t expected, int timeout_ms) {
+    struct timespec timeout = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &timeout, NULL, 0);
+}
+
+inline void futexWake(atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+inline void countSyscalls(TransportStats* stats, long n) {
+    if (stats != NULL) stats->syscalls += n;
+}
+
+typedef void (*LightStateSink)(const LightStateMessage& msg, void* ctx);
+
+// The controller's end
+struct LightChannel {
+    int transport;
+    int fd;                 // pipe: write end
+    LightMailbox* mailbox;  // shm
+    int ring;
+    LightStateSink sink;    // thread
+    void* sink_ctx;
+    TransportStats* stats;  // NULL: not counted
+};
+
+inline LightChannel directLightChannel(LightStateSink sink, void* ctx, TransportStats* stats) {
+    LightChannel ch = {TRANSPORT_THREAD, -1, NULL, 0, sink, ctx, stats};
+    return ch;
+}
+
+inline LightChannel pipeLightChannel(int write_fd, TransportStats* stats) {
+    LightChannel ch = {TRANSPORT_PIPE, write_fd, NULL, 0, NULL, NULL, stats};
+    return ch;
+}
+
+inline LightChannel shmLightChannel(LightMailbox* mailbox, int ring, TransportStats* stats) {
+    LightChannel ch = {TRANSPORT_SHM, -1, mailbox, ring, NULL, NULL, stats};
+    return ch;
+}
+
+// False once the pipe's reader is gone
+inline bool publishLightState(const LightChannel& ch, const LightStateMessage& msg) {
+    if (ch.stats != NULL) ch.stats->messages++;
+    if (ch.transport == TRANSPORT_THREAD) {
+        ch.sink(msg, ch.sink_ctx);
+        return true;
+    }
+    if (ch.transport == TRANSPORT_PIPE) {
+        countSyscalls(ch.stats, 1);
+        return write(ch.fd, &msg, sizeof(msg)) == (ssize_t)sizeof(msg);
+    }
+
+    LightMailbox& m = *ch.mailbox;
+    LightStateRing& ring = m.rings[ch.ring];
+    uint32_t tail = ring.tail.load(memory_order_relaxed);
+    for (int retries = 0; tail - ring.head.load(memory_order_acquire) == (uint32_t)LIGHT_RING_SLOTS; retries++) {
+        if (retries == LIGHT_PUBLISH_RETRIES) {
+            if (ch.stats != NULL) ch.stats->dropped++;
+            return true;
+        }
+        countSyscalls(ch.stats, 1);
+        sched_yield();
+    }
+    ring.slots[tail % LIGHT_RING_SLOTS] = msg;
+    ring.tail.store(tail + 1, memory_order_release);
+
+    // Bumped after the push and before the check: a listener that read the
+    // old doorbell either sees the state when it re-drains or is woken
+    m.doorbell.fetch_add(1);
+    if (m.listener_asleep.load()) {
+        countSyscalls(ch.stats, 1);
+        futexWake(&m.doorbell);
+    }
+    return true;
+}
+
+// The simulation's end (pipe and shm)
+struct LightListener {
+    int transport;
+    int fds[NUM_INTERSECTIONS];     // pipe: read ends by intersection, -1 if unused
+    LightMailbox* mailbox;
+    TransportStats* stats;
+};
+
+inline int drainLightRings(LightListener& l, LightStateMessage* out, int max) {
+    int n = 0;
+    for (int i = 0; i < NUM_INTERSECTIONS && n < max; i++) {
+        LightStateRing& ring = l.mailbox->rings[i];
+        uint32_t head = ring.head.load(memory_order_relaxed);
+        uint32_t tail = ring.tail.load(memory_order_acquire);
+        for (; head != tail && n < max; head++) {
+            out[n] = ring.slots[head % LIGHT_RING_SLOTS];
+            if (out[n].intersection == i) n++;
+        }
+        ring.head.store(head, memory_order_release);
+    }
+    return n;
+}
+
+// Up to max states, waiting at most timeout_ms for the first
+inline int receiveLightStates(LightListener& l, LightStateMessage* out, int max, int timeout_ms) {
+    int n = 0;
+    if (l.transport == TRANSPORT_PIPE) {
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        int max_fd = -1;
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+            if (l.fds[i] < 0) continue;
+            FD_SET(l.fds[i], &read_fds);
+            if (l.fds[i] > max_fd) max_fd = l.fds[i];
+        }
+        struct timeval timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+        countSyscalls(l.stats, 1);
+        if (select(max_fd + 1, &read_fds, NULL, NULL, &timeout) <= 0) return 0;
+
+        // States are written whole and are all one size, so one read drains every queued one
+        for (int i = 0; i < NUM_INTERSECTIONS && n < max; i++) {
+            if (l.fds[i] < 0 || !FD_ISSET(l.fds[i], &read_fds)) continue;
+            countSyscalls(l.stats, 1);
+            ssize_t got = read(l.fds[i], &out[n], (max - n) * sizeof(out[n]));
+            if (got <= 0) continue;
+            int first = n;
+            for (int k = first; k < first + (int)(got / (ssize_t)sizeof(out[n])); k++) {
+                if (out[k].intersection == i) out[n++] = out[k];
+            }
+        }
+    } else if (l.transport == TRANSPORT_SHM) {
+        n = drainLightRings(l, out, max);
+        if (n == 0) {
+            LightMailbox& m = *l.mailbox;
+            m.listener_asleep.store(1);
+            uint32_t seen = m.doorbell.load();
+            n = drainLightRings(l, out, max);
+            if (n == 0) {
+                countSyscalls(l.stats, 1);
+                futexWait(&m.doorbell, seen, timeout_ms);
+            }
+            m.listener_asleep.store(0);
+            if (n == 0) n = drainLightRings(l, out, max);
+        }
+    }
+    if (l.stats != NULL) l.stats->messages += n;
+    return n;
+}
+
+// --bench transport: one controller publishes light changes to one listener
+// over each transport, first paced (the listener sleeps between changes, as
+// in a run) and then back to back. CPU time and context switches cover both
+// ends, including a forked publisher.
+const int TRANSPORT_BENCH_CHANGES = 2000;
+const long long TRANSPORT_BENCH_PACE_NS = 1000000LL;
+
+struct TransportTrial {
+    int transport;
+    long long interval_ns;
+    LatencyHistogram latency;
+    long long cpu_ns;
+    long switches;
+    TransportStats publisher;
+    TransportStats listener;
+};
+
+struct BenchPublisher {
+    LightChannel channel;
+    int changes;
+    long long interval_ns;
+};
+
+inline void publishBenchChanges(const LightChannel& ch, int changes, long long interval_ns) {
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int k = 0; k < changes; k++) {
+        if (interval_ns > 0) {
+            next.tv_nsec += interval_ns;
+            while (next.tv_nsec >= 1000000000L) {
+                next.tv_nsec -= 1000000000L;
+                next.tv_sec++;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+        LightStateMessage msg = {0, (uint8_t)(k & 0xFF), (uint16_t)k, monotonicNowNs(), 0};
+        if (!publishLightState(ch, msg)) break;
+    }
+}
+
+inline void* benchPublisherThread(void* arg) {
+    BenchPublisher& p = *(BenchPublisher*)arg;
+    publishBenchChanges(p.channel, p.changes, p.interval_ns);
+    return NULL;
+}
+
+inline void recordBenchLightState(const LightStateMessage& msg, void* ctx) {
+    recordLatency(*(LatencyHistogram*)ctx, monotonicNowNs() - msg.sent_ns);
+}
+
+inline long long rusageCpuNs(const struct rusage& r) {
+    return (r.ru_utime.tv_sec + r.ru_stime.tv_sec) * 1000000000LL
+         + (r.ru_utime.tv_usec + r.ru_stime.tv_usec) * 1000LL;
+}
+
+inline long rusageSwitches(const struct rusage& r) {
+    return r.ru_nvcsw + r.ru_nivcsw;
+}
+
+inline bool runTransportTrial(TransportTrial& t, int changes) {
+    resetLatencyHistogram(t.latency);
+    memset(&t.listener, 0, sizeof(t.listener));
+
+    // The publisher's counters outlive a forked publisher
+    TransportStats* publisher = (TransportStats*)mmap(NULL, sizeof(TransportStats), PROT_READ | PROT_WRITE,
+                                                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (publisher == MAP_FAILED) return false;
+    memset(publisher, 0, sizeof(*publisher));
+
+    struct rusage before, after, child;
+    memset(&child, 0, sizeof(child));
+    getrusage(RUSAGE_SELF, &before);
+
+    if (t.transport == TRANSPORT_THREAD) {
+        BenchPublisher p = {directLightChannel(recordBenchLightState, &t.latency, publisher), changes, t.interval_ns};
+        pthread_t tid;
+        pthread_create(&tid, NULL, benchPublisherThread, &p);
+        pthread_join(tid, NULL);
+    } else {
+        int fds[2] = {-1, -1};
+        LightMailbox* mailbox = NULL;
+        bool ready = (t.transport == TRANSPORT_PIPE) ? pipe(fds) == 0 : (mailbox = createLightMailbox()) != NULL;
+        if (!ready) {
+            perror("transport benchmark");
+            munmap(publisher, sizeof(TransportStats));
+            return false;
+        }
+
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            if (fds[0] >= 0) close(fds[0]);
+            LightChannel ch = (t.transport == TRANSPORT_PIPE) ? pipeLightChannel(fds[1], publisher)
+                                                              : shmLightChannel(mailbox, 0, publisher);
+            publishBenchChanges(ch, changes, t.interval_ns);
+            _exit(0);
+        }
+        if (fds[1] >= 0) close(fds[1]);
+
+        LightListener listener = {t.transport, {}, mailbox, &t.listener};
+        for (int i = 0; i < NUM_INTERSECTIONS; i++) listener.fds[i] = (i == 0) ? fds[0] : -1;
+        LightStateMessage batch[LIGHT_RECEIVE_BATCH];
+        long received = 0;
+        while (pid > 0 && received < changes) {
+            int n = receiveLightStates(listener, batch, LIGHT_RECEIVE_BATCH, 100);
+            long long now = monotonicNowNs();
+            for (int k = 0; k < n; k++) recordLatency(t.latency, now - batch[k].sent_ns);
+            received += n;
+            if (n == 0 && waitpid(pid, NULL, WNOHANG) == pid) pid = 0;   // publisher gave up
+        }
+        int status;
+        if (pid > 0) wait4(pid, &status, 0, &child);
+        if (fds[0] >= 0) close(fds[0]);
+        destroyLightMailbox(mailbox);
+    }
+
+    getrusage(RUSAGE_SELF, &after);
+    t.cpu_ns = rusageCpuNs(after) - rusageCpuNs(before) + rusageCpuNs(child);
+    t.switches = rusageSwitches(after) - rusageSwitches(before) + rusageSwitches(child);
+    t.publisher = *publisher;
+    munmap(publisher, sizeof(TransportStats));
+    return true;
+}
+
+inline void printTransportTrial(const TransportTrial& t) {
+    double n = (t.latency.count > 0) ? (double)t.latency.count : 1.0;
+    char line[256];
+    snprintf(line, sizeof(line),
+             "[BENCH] %-6s %-6s latency mean %7s us, p50 <= %7s us, p99 <= %7s us | CPU %6.2f us, "
+             "syscalls %.2f (publisher %.2f, listener %.2f), context switches %.2f per change\n",
+             TRANSPORT_NAMES[t.transport].c_str(), (t.interval_ns > 0) ? "paced" : "burst",
+             formatLatencyUs(t.latency.count > 0 ? t.latency.total_ns / t.latency.count : 0).c_str(),
+             formatLatencyUs(latencyPercentileNs(t.latency, 0.50)).c_str(),
+             formatLatencyUs(latencyPercentileNs(t.latency, 0.99)).c_str(), t.cpu_ns / 1000.0 / n,
+             (t.publisher.syscalls + t.listener.syscalls) / n, t.publisher.syscalls / n, t.listener.syscalls / n,
+             t.switches / n);
+    cout << line;
+    if (t.latency.count < t.publisher.messages || t.publisher.dropped > 0) {
+        cout << ("[BENCH]   only " + to_string(t.latency.count) + " of " + to_string(t.publisher.messages)
+                 + " changes delivered (" + to_string(t.publisher.dropped) + " dropped)\n");
+    }
+}
+
+inline int runTransportBenchmark() {
+    cout << ("[BENCH] Controller transport: " + to_string(TRANSPORT_BENCH_CHANGES) + " light changes per trial, paced "
+             + to_string(TRANSPORT_BENCH_PACE_NS / 1000) + " us apart, then back to back; latency is publish to "
+             + "delivery, costs are per change for both ends\n");
+    long long intervals[] = {TRANSPORT_BENCH_PACE_NS, 0};
+    for (int pattern = 0; pattern < 2; pattern++) {
+        for (int transport = 0; transport < NUM_TRANSPORTS; transport++) {
+            TransportTrial t;
+            t.transport = transport;
+            t.interval_ns = intervals[pattern];
+            if (!runTransportTrial(t, TRANSPORT_BENCH_CHANGES)) return 1;
+            printTransportTrial(t);
+        }
+    }
+    return 0;
+}
+
+#endif // TRANSPORT_H
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <string>
 #include <time.h>
+#include "simulation.h"
 
 using namespace std;
 
@@ -17,8 +18,10 @@ struct Vehicle {
     string current_side;
     string priority;
     time_t arrival_time;
+    int park_time;
     bool wants_parking;
     bool has_exited;
+    bool parked;            // released its thread in a lot; resumes there on departure
     
     Vehicle(int vid, string vtype, string spawn_int, string side, string dir) {
         id = vid;
@@ -29,8 +32,10 @@ struct Vehicle {
         current_intersection = spawn_int;
         current_side = side;
         arrival_time = time(NULL);
+        park_time = PARKING_MIN_TIME;
         wants_parking = false;
         has_exited = false;
+        parked = false;
         
         if (type == "Ambulance" || type == "Firetruck") {
             priority = "HIGH";
@@ -46,7 +51,7 @@ struct Vehicle {
     
     Vehicle() : id(0), type("Car"), spawn_intersection("F10"), spawn_side("NORTH"),
                 direction("STRAIGHT"), current_intersection("F10"), current_side("NORTH"),
-                priority("LOW"), arrival_time(0), wants_parking(false), has_exited(false) {}
+                priority("LOW"), arrival_time(0), park_time(PARKING_MIN_TIME), wants_parking(false), has_exited(false), parked(false) {}
 };
 
 inline bool isEmergencyVehicle(string type) {
@@ -0,0 +1,162 @@
+#ifndef VEHICLEPOOL_H
+#define VEHICLEPOOL_H
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <semaphore.h>
+#include <limits.h>
+#include "simulation.h"
+#include "vehicle.h"
+
+using namespace std;
+
+// Fixed set of preallocated Vehicle records. The pool capacity doubles as the
+// in-flight limit: acquireVehicle blocks while every slot is taken.
+struct VehiclePool {
+    Vehicle* slots;
+    int* free_stack;
+    int free_top;
+    int capacity;
+    int in_use;
+    int peak_in_use;
+    long total_acquired;
+    pthread_mutex_t lock;
+    pthread_cond_t drained;
+    sem_t available;
+};
+
+inline void initVehiclePool(VehiclePool& pool, int capacity) {
+    pool.slots = new Vehicle[capacity];
+    pool.free_stack = new int[capacity];
+    for (int i = 0; i < capacity; i++) {
+        pool.free_stack[i] = capacity - 1 - i;
+    }
+    pool.free_top = capacity;
+    pool.capacity = capacity;
+    pool.in_use = 0;
+    pool.peak_in_use = 0;
+    pool.total_acquired = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.drained, NULL);
+    sem_init(&pool.available, 0, capacity);
+}
+
+inline void destroyVehiclePool(VehiclePool& pool) {
+    sem_destroy(&pool.available);
+    pthread_cond_destroy(&pool.drained);
+    pthread_mutex_destroy(&pool.lock);
+    delete[] pool.slots;
+    delete[] pool.free_stack;
+    pool.slots = NULL;
+    pool.free_stack = NULL;
+}
+
+// Returns NULL only if shutdown was requested while waiting for a free slot
+inline Vehicle* acquireVehicle(VehiclePool& pool) {
+    if (!semWaitUnlessShutdown(&pool.available)) return NULL;
+
+    pthread_mutex_lock(&pool.lock);
+    int index = pool.free_stack[--pool.free_top];
+    pool.in_use++;
+    pool.total_acquired++;
+    if (pool.in_use > pool.peak_in_use) pool.peak_in_use = pool.in_use;
+    pthread_mutex_unlock(&pool.lock);
+
+    Vehicle* v = &pool.slots[index];
+    *v = Vehicle();
+    return v;
+}
+
+inline void releaseVehicle(VehiclePool& pool, Vehicle* v) {
+    int index = (int)(v - pool.slots);
+
+    pthread_mutex_lock(&pool.lock);
+    pool.free_stack[pool.free_top++] = index;
+    pthread_mutex_unlock(&pool.lock);
+
+    sem_post(&pool.available);
+
+    // Counted last so a drained pool really has no thread left inside it
+    pthread_mutex_lock(&pool.lock);
+    pool.in_use--;
+    if (pool.in_use == 0) pthread_cond_broadcast(&pool.drained);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+inline bool waitForVehiclesDrained(VehiclePool& pool, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.in_use > 0) {
+        if (pthread_cond_timedwait(&pool.drained, &pool.lock, &deadline) != 0) break;
+    }
+    bool drained = (pool.in_use == 0);
+    pthread_mutex_unlock(&pool.lock);
+    return drained;
+}
+
+// Detached threads with a small, fixed stack; nothing is kept to join later
+inline void initVehicleThreadAttr(pthread_attr_t& attr, int stack_kb) {
+    size_t stack_size = (size_t)stack_kb * 1024;
+    if (stack_size < (size_t)PTHREAD_STACK_MIN) stack_size = PTHREAD_STACK_MIN;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, stack_size);
+}
+
+inline long readProcStatusKb(const char* field) {
+    FILE* f = fopen("/proc/self/status", "r");
+    if (f == NULL) return -1;
+
+    char line[256];
+    long value = -1;
+    size_t len = strlen(field);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strncmp(line, field, len) == 0) {
+            value = atol(line + len + 1);
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+inline size_t vehicleThreadStackBytes(const pthread_attr_t& attr) {
+    size_t stack_size = 0;
+    pthread_attr_getstacksize(&attr, &stack_size);
+    return stack_size;
+}
+
+// context_bytes is what each vehicle's execution context reserves on top of
+// its pool record: a thread stack, or a coroutine frame
+inline void printVehicleMemoryReport(VehiclePool& pool, const string& context_label, size_t context_bytes) {
+    size_t record_bytes = sizeof(Vehicle);
+    size_t pool_bytes = (size_t)pool.capacity * (record_bytes + sizeof(int));
+    long peak_rss_kb = readProcStatusKb("VmHWM:");
+    int peak = (pool.peak_in_use > 0) ? pool.peak_in_use : 1;
+
+    cout << ("Vehicle Memory Report:\n");
+    cout << ("  Pool: " + to_string(pool.capacity) + " slots x " + to_string(record_bytes)
+         + " B = " + to_string(pool_bytes / 1024) + " KB (preallocated)\n");
+    cout << ("  Vehicles: " + to_string(pool.total_acquired) + " total, "
+         + to_string(pool.peak_in_use) + " peak concurrent\n");
+    cout << ("  " + context_label + ": " + to_string(context_bytes) + " B\n");
+    cout << ("  Budget per vehicle: " + to_string(record_bytes + context_bytes) + " B\n");
+    if (peak_rss_kb >= 0) {
+        cout << ("  Peak RSS: " + to_string(peak_rss_kb) + " KB (" + to_string(peak_rss_kb / peak)
+             + " KB per peak vehicle, upper bound)\n");
+    }
+}
+
+#endif // VEHICLEPOOL_H
@@ -0,0 +1,252 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <time.h>
+#include "simulation.h"
+#include "vehicle.h"
+
+using namespace std;
+
+// Arrival file layout: WorkloadHeader, ArrivalRecord * N, end marker record, WorkloadOutcome
+const char WORKLOAD_MAGIC[4] = {'T', 'S', 'W', 'L'};
+const uint16_t WORKLOAD_VERSION = 1;
+const uint8_t ARRIVAL_END_MARKER = 0xFF;
+
+struct WorkloadHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t seed;
+    uint32_t record_count;   // 0 if the recording was interrupted
+};
+
+// One spawn decision, 16 bytes on disk
+struct ArrivalRecord {
+    uint32_t time_ms;        // offset from spawner start
+    uint32_t park_time_ms;   // dwell if the vehicle gets a spot
+    uint8_t type;            // index into VEHICLE_TYPES
+    uint8_t intersection;    // index into INTERSECTION_IDS
+    uint8_t side;            // index into SPAWN_SIDES
+    uint8_t direction;       // index into DIRECTIONS
+    uint8_t wants_parking;
+    uint8_t reserved[3];
+};
+
+struct WorkloadOutcome {
+    uint32_t spawned;
+    uint32_t completed;
+    uint64_t arrival_digest;   // FNV-1a over the arrival records, in spawn order
+    uint64_t route_digest;     // order-independent sum of per-vehicle exit hashes
+};
+
+struct WorkloadRecorder {
+    FILE* file;
+    WorkloadHeader header;
+};
+
+struct WorkloadReplay {
+    FILE* file;
+    WorkloadHeader header;
+    bool finished;
+    bool corrupt;            // a record failed validation; nothing after it is trusted
+    uint32_t records_read;
+    bool has_outcome;
+    WorkloadOutcome outcome;
+};
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+inline uint64_t fnv1a(uint64_t hash, const void* data, size_t len) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+inline int lookupIndex(const string table[], int count, const string& value) {
+    for (int i = 0; i < count; i++) {
+        if (table[i] == value) return i;
+    }
+    return 0;
+}
+
+inline int vehicleTypeIndex(const string& type) {
+    return lookupIndex(VEHICLE_TYPES, NUM_VEHICLE_TYPES, type);
+}
+
+inline int sideIndex(const string& side) {
+    return lookupIndex(SPAWN_SIDES, NUM_SIDES, side);
+}
+
+inline int directionIndex(const string& direction) {
+    return lookupIndex(DIRECTIONS, NUM_DIRECTIONS, direction);
+}
+
+inline int intersectionIndex(const string& id) {
+    return lookupIndex(INTERSECTION_IDS, NUM_INTERSECTIONS, id);
+}
+
+inline bool isValidArrival(const ArrivalRecord& rec) {
+    return rec.type < NUM_VEHICLE_TYPES && rec.intersection < NUM_INTERSECTIONS
+        && rec.side < NUM_SIDES && rec.direction < NUM_DIRECTIONS;
+}
+
+inline void applyArrival(Vehicle& v, const ArrivalRecord& rec) {
+    v.type = VEHICLE_TYPES[rec.type];
+    v.spawn_intersection = INTERSECTION_IDS[rec.intersection];
+    v.spawn_side = SPAWN_SIDES[rec.side];
+    v.direction = DIRECTIONS[rec.direction];
+    v.wants_parking = rec.wants_parking != 0;
+    v.park_time = (int)rec.park_time_ms * 1000;
+
+    if (isEmergencyVehicle(v.type)) v.priority = "HIGH";
+    else if (v.type == "Bus") v.priority = "MEDIUM";
+    else v.priority = "LOW";
+
+    v.current_intersection = v.spawn_intersection;
+    v.current_side = v.spawn_side;
+    v.has_exited = false;
+}
+
+inline uint64_t updateArrivalDigest(uint64_t digest, const ArrivalRecord& rec) {
+    return fnv1a(digest, &rec, sizeof(rec));
+}
+
+inline uint64_t vehicleRouteHash(int vehicle_id, const string& exit_intersection, const string& exit_side) {
+    unsigned char route[6];
+    memcpy(route, &vehicle_id, 4);
+    route[4] = (unsigned char)intersectionIndex(exit_intersection);
+    route[5] = (unsigned char)sideIndex(exit_side);
+    return fnv1a(FNV_OFFSET_BASIS, route, sizeof(route));
+}
+
+inline unsigned int elapsedMs(const struct timespec& start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned int)((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000);
+}
+
+inline void sleepUntilOffset(const struct timespec& start, unsigned int offset_ms) {
+    unsigned int now_ms = elapsedMs(start);
+    if (offset_ms > now_ms) {
+        usleep((offset_ms - now_ms) * 1000);
+    }
+}
+
+inline bool openWorkloadRecorder(WorkloadRecorder& rec, const string& path, unsigned int seed) {
+    rec.file = fopen(path.c_str(), "wb");
+    if (rec.file == NULL) {
+        perror(("Failed to open arrival file " + path).c_str());
+        return false;
+    }
+
+    memcpy(rec.header.magic, WORKLOAD_MAGIC, 4);
+    rec.header.version = WORKLOAD_VERSION;
+    rec.header.record_size = sizeof(ArrivalRecord);
+    rec.header.seed = seed;
+    rec.header.record_count = 0;
+
+    fwrite(&rec.header, sizeof(rec.header), 1, rec.file);
+    // The controllers are forked after this; an unflushed header would be
+    // written again by each of them on exit
+    fflush(rec.file);
+    return true;
+}
+
+inline void recordArrival(WorkloadRecorder& rec, const ArrivalRecord& arrival) {
+    if (rec.file == NULL) return;
+    fwrite(&arrival, sizeof(arrival), 1, rec.file);
+    rec.header.record_count++;
+}
+
+inline void closeWorkloadRecorder(WorkloadRecorder& rec, const WorkloadOutcome& outcome) {
+    if (rec.file == NULL) return;
+
+    ArrivalRecord end_marker;
+    memset(&end_marker, 0, sizeof(end_marker));
+    end_marker.type = ARRIVAL_END_MARKER;
+    fwrite(&end_marker, sizeof(end_marker), 1, rec.file);
+    fwrite(&outcome, sizeof(outcome), 1, rec.file);
+
+    fseek(rec.file, 0, SEEK_SET);
+    fwrite(&rec.header, sizeof(rec.header), 1, rec.file);
+    fclose(rec.file);
+    rec.file = NULL;
+}
+
+inline bool openWorkloadReplay(WorkloadReplay& replay, const string& path) {
+    replay.finished = false;
+    replay.corrupt = false;
+    replay.records_read = 0;
+    replay.has_outcome = false;
+    replay.file = fopen(path.c_str(), "rb");
+    if (replay.file == NULL) {
+        perror(("Failed to open arrival file " + path).c_str());
+        return false;
+    }
+
+    if (fread(&replay.header, sizeof(replay.header), 1, replay.file) != 1
+        || memcmp(replay.header.magic, WORKLOAD_MAGIC, 4) != 0
+        || replay.header.version != WORKLOAD_VERSION
+        || replay.header.record_size != sizeof(ArrivalRecord)) {
+        cerr << ("Invalid or incompatible arrival file: " + path + "\n");
+        fclose(replay.file);
+        replay.file = NULL;
+        return false;
+    }
+    return true;
+}
+
+inline bool readArrival(WorkloadReplay& replay, ArrivalRecord& arrival) {
+    if (replay.file == NULL || replay.finished) return false;
+
+    if (fread(&arrival, sizeof(arrival), 1, replay.file) == 1) {
+        if (arrival.type == ARRIVAL_END_MARKER) {
+            replay.has_outcome = (fread(&replay.outcome, sizeof(replay.outcome), 1, replay.file) == 1);
+        } else if (isValidArrival(arrival)) {
+            replay.records_read++;
+            return true;
+        } else {
+            replay.corrupt = true;
+        }
+    }
+
+    replay.finished = true;
+    return false;
+}
+
+inline bool readWorkloadOutcome(WorkloadReplay& replay) {
+    ArrivalRecord skipped;
+    while (readArrival(replay, skipped)) {
+    }
+    return replay.has_outcome;
+}
+
+inline void closeWorkloadReplay(WorkloadReplay& replay) {
+    if (replay.file != NULL) {
+        fclose(replay.file);
+        replay.file = NULL;
+    }
+}
+
+inline bool verifyWorkloadOutcome(const WorkloadOutcome& expected, const WorkloadOutcome& actual) {
+    bool arrivals_match = expected.spawned == actual.spawned && expected.arrival_digest == actual.arrival_digest;
+    bool routes_match = expected.completed == actual.completed && expected.route_digest == actual.route_digest;
+
+    cout << ("[REPLAY] Arrivals:  " + string(arrivals_match ? "MATCH" : "MISMATCH") + " ("
+         + to_string(actual.spawned) + "/" + to_string(expected.spawned) + " spawned)\n");
+    cout << ("[REPLAY] Outcome:   " + string(routes_match ? "MATCH" : "MISMATCH") + " ("
+         + to_string(actual.completed) + "/" + to_string(expected.completed) + " completed)\n");
+
+    return arrivals_match && routes_match;
+}
+
+#endif // WORKLOAD_H